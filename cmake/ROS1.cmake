@@ -22,7 +22,10 @@ find_package(catkin REQUIRED COMPONENTS
   roscpp
   nodelet
   dynamic_reconfigure
+  diagnostic_msgs
   event_camera_msgs
+  sensor_msgs
+  std_msgs
   std_srvs)
 
 # MetavisionSDK is now found otherwise
@@ -39,15 +42,42 @@ include_directories(
   include
   ${catkin_INCLUDE_DIRS})
 
-catkin_package(CATKIN_DEPENDS dynamic_reconfigure)
+catkin_package(
+  INCLUDE_DIRS include
+  LIBRARIES metavision_driver_shm metavision_driver_codec
+  CATKIN_DEPENDS dynamic_reconfigure)
 
 #
 # --------- driver -------------
 
+# optional compression of the event packets
+find_package(PkgConfig REQUIRED)
+pkg_check_modules(LZ4 liblz4)
+pkg_check_modules(ZSTD libzstd)
+add_library(metavision_driver_codec src/packet_codec.cpp)
+if(LZ4_FOUND)
+  message(STATUS "lz4 found, enabling evt3_lz4 encoding")
+  target_compile_definitions(metavision_driver_codec PRIVATE USING_LZ4)
+  target_include_directories(metavision_driver_codec PRIVATE ${LZ4_INCLUDE_DIRS})
+  target_link_libraries(metavision_driver_codec ${LZ4_LIBRARIES})
+endif()
+if(ZSTD_FOUND)
+  message(STATUS "zstd found, enabling evt3_zstd encoding")
+  target_compile_definitions(metavision_driver_codec PRIVATE USING_ZSTD)
+  target_include_directories(metavision_driver_codec PRIVATE ${ZSTD_INCLUDE_DIRS})
+  target_link_libraries(metavision_driver_codec ${ZSTD_LIBRARIES})
+endif()
+
+# shared memory ring (writer and reader library)
+add_library(metavision_driver_shm src/shm_ring.cpp)
+target_link_libraries(metavision_driver_shm rt)
+
 # code common to nodelet and node
 add_library(driver_common
-  src/driver_ros1.cpp src/bias_parameter.cpp src/metavision_wrapper.cpp)
-target_link_libraries(driver_common MetavisionSDK::driver ${catkin_LIBRARIES})
+  src/driver_ros1.cpp src/bias_parameter.cpp src/metavision_wrapper.cpp src/raw_recorder.cpp
+  src/file_player.cpp src/worker_pool.cpp src/evt3_filter.cpp src/activity_monitor.cpp)
+target_link_libraries(driver_common metavision_driver_shm metavision_driver_codec
+  MetavisionSDK::driver ${catkin_LIBRARIES})
 # to ensure messages get built before executable
 add_dependencies(driver_common ${metavision_driver_EXPORTED_TARGETS})
 
@@ -63,14 +93,38 @@ target_link_libraries(driver_node driver_common MetavisionSDK::driver ${catkin_L
 # to ensure messages get built before executable
 add_dependencies(driver_node ${metavision_driver_EXPORTED_TARGETS})
 
+# throughput benchmark
+add_executable(metavision_driver_bench src/bench.cpp)
+target_link_libraries(metavision_driver_bench driver_common MetavisionSDK::driver ${catkin_LIBRARIES})
+add_dependencies(metavision_driver_bench ${metavision_driver_EXPORTED_TARGETS})
+
+# example consumer of the shared memory ring
+add_executable(metavision_driver_shm_reader src/shm_reader.cpp)
+target_link_libraries(metavision_driver_shm_reader metavision_driver_shm)
+
+# streaming analyzer for recorded event packets, only this one needs rosbag
+find_package(rosbag REQUIRED)
+add_executable(metavision_driver_bag_analyzer src/bag_analyzer.cpp src/packet_stream_analyzer.cpp)
+target_include_directories(metavision_driver_bag_analyzer PRIVATE ${rosbag_INCLUDE_DIRS})
+target_link_libraries(metavision_driver_bag_analyzer metavision_driver_codec ${rosbag_LIBRARIES}
+  ${catkin_LIBRARIES})
+
 
 #############
 ## Install ##
 #############
 
-install(TARGETS driver_node
+install(TARGETS driver_node metavision_driver_bench metavision_driver_shm_reader
+  metavision_driver_bag_analyzer
   RUNTIME DESTINATION ${CATKIN_PACKAGE_BIN_DESTINATION})
 
+install(TARGETS metavision_driver_shm metavision_driver_codec
+  ARCHIVE DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION}
+  LIBRARY DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION})
+
+install(DIRECTORY include/${PROJECT_NAME}/
+  DESTINATION ${CATKIN_PACKAGE_INCLUDE_DESTINATION})
+
 install(TARGETS driver_nodelet
   ARCHIVE DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION}
   LIBRARY DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION}
@@ -98,4 +152,6 @@ endif()
 ## Testing ##
 #############
 
-# To be done...
+if(CATKIN_ENABLE_TESTING)
+  catkin_add_gtest(${PROJECT_NAME}_evt3_filter_test test/evt3_filter_test.cpp src/evt3_filter.cpp)
+endif()
@@ -45,7 +45,10 @@ find_package(ament_cmake_ros REQUIRED)
 set(ROS2_DEPENDENCIES
   "rclcpp"
   "rclcpp_components"
+  "diagnostic_msgs"
   "event_camera_msgs"
+  "sensor_msgs"
+  "std_msgs"
   "std_srvs"
 )
 
@@ -55,16 +58,57 @@ endforeach()
 
 ament_auto_find_build_dependencies(REQUIRED ${ROS2_DEPENDENCIES})
 
+#
+# --------- optional compression of the event packets -------------
+
+find_package(PkgConfig REQUIRED)
+pkg_check_modules(LZ4 liblz4)
+pkg_check_modules(ZSTD libzstd)
+
+ament_auto_add_library(metavision_driver_codec SHARED
+  src/packet_codec.cpp)
+target_include_directories(metavision_driver_codec PUBLIC
+  $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+  $<INSTALL_INTERFACE:include>)
+if(LZ4_FOUND)
+  message(STATUS "lz4 found, enabling evt3_lz4 encoding")
+  target_compile_definitions(metavision_driver_codec PRIVATE USING_LZ4)
+  target_include_directories(metavision_driver_codec PRIVATE ${LZ4_INCLUDE_DIRS})
+  target_link_libraries(metavision_driver_codec ${LZ4_LIBRARIES})
+endif()
+if(ZSTD_FOUND)
+  message(STATUS "zstd found, enabling evt3_zstd encoding")
+  target_compile_definitions(metavision_driver_codec PRIVATE USING_ZSTD)
+  target_include_directories(metavision_driver_codec PRIVATE ${ZSTD_INCLUDE_DIRS})
+  target_link_libraries(metavision_driver_codec ${ZSTD_LIBRARIES})
+endif()
+
+#
+# --------- shared memory ring (writer and reader library) -------------
+
+ament_auto_add_library(metavision_driver_shm SHARED
+  src/shm_ring.cpp)
+target_include_directories(metavision_driver_shm PUBLIC
+  $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+  $<INSTALL_INTERFACE:include>)
+target_link_libraries(metavision_driver_shm rt)
+
 #
 # --------- driver (composable component) -------------
 
 ament_auto_add_library(driver_ros2 SHARED
   src/metavision_wrapper.cpp
+  src/evt3_filter.cpp
+  src/activity_monitor.cpp
+  src/raw_recorder.cpp
+  src/file_player.cpp
+  src/worker_pool.cpp
   src/bias_parameter.cpp
   src/driver_ros2.cpp)
 
 target_include_directories(driver_ros2 PRIVATE include)
-target_link_libraries(driver_ros2 MetavisionSDK::driver)
+target_link_libraries(driver_ros2 metavision_driver_shm metavision_driver_codec
+  MetavisionSDK::driver)
 
 rclcpp_components_register_nodes(driver_ros2 "metavision_driver::DriverROS2")
 
@@ -73,11 +117,31 @@ rclcpp_components_register_nodes(driver_ros2 "metavision_driver::DriverROS2")
 ament_auto_add_executable(driver_node
   src/driver_node_ros2.cpp)
 
+# --------- throughput benchmark -------------
+
+ament_auto_add_executable(metavision_driver_bench
+  src/bench.cpp)
+
+# --------- example consumer of the shared memory ring -------------
+
+ament_auto_add_executable(metavision_driver_shm_reader
+  src/shm_reader.cpp)
+target_link_libraries(metavision_driver_shm_reader metavision_driver_shm)
+
+# --------- streaming analyzer for recorded event packets -------------
+
+ament_auto_add_executable(metavision_driver_bag_analyzer
+  src/bag_analyzer.cpp
+  src/packet_stream_analyzer.cpp)
+target_link_libraries(metavision_driver_bag_analyzer metavision_driver_codec)
 
 # the node must go into the project specific lib directory or else
 # the launch file will not find it
 install(TARGETS
   driver_node
+  metavision_driver_bench
+  metavision_driver_shm_reader
+  metavision_driver_bag_analyzer
   DESTINATION lib/${PROJECT_NAME}/)
 
 # the shared library goes into the global lib dir so it can
@@ -85,8 +149,16 @@ install(TARGETS
 
 install(TARGETS
   driver_ros2
+  metavision_driver_shm
+  metavision_driver_codec
   DESTINATION lib)
 
+# so other packages can read the shared memory ring
+install(DIRECTORY include/
+  DESTINATION include)
+ament_export_include_directories(include)
+ament_export_libraries(metavision_driver_shm metavision_driver_codec)
+
 install(DIRECTORY
   launch
   DESTINATION share/${PROJECT_NAME}/
@@ -123,6 +195,12 @@ if(BUILD_TESTING)
   # ament_pep257() # (does not work on galactic/foxy)
   ament_xmllint()
   ament_clang_format(CONFIG_FILE .clang-format)
+
+  find_package(ament_cmake_gtest REQUIRED)
+  ament_add_gtest(${PROJECT_NAME}_evt3_filter_test
+    test/evt3_filter_test.cpp
+    src/evt3_filter.cpp)
+  target_include_directories(${PROJECT_NAME}_evt3_filter_test PRIVATE include)
 endif()
 
 ament_package()
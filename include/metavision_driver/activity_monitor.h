@@ -0,0 +1,101 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__ACTIVITY_MONITOR_H_
+#define METAVISION_DRIVER__ACTIVITY_MONITOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Counts the CD events per tile of the sensor and per polarity from
+// the raw EVT3 stream, and hands out the counts once per interval.
+// The data path only copies the raw data, a background thread decodes
+// just enough of it (rows, columns, polarity, popcount of the vector
+// words) to count. Nothing is done while the enabled function returns
+// false, which is checked once per interval.
+//
+class ActivityMonitor
+{
+public:
+  struct Snapshot
+  {
+    uint32_t width{0};  // number of tiles
+    uint32_t height{0};
+    uint32_t tileSize{0};        // in pixels
+    std::vector<float> counts;   // events per tile, row major
+    uint64_t numEvents[2]{0, 0};  // OFF and ON events
+    double duration{0};           // seconds covered by the counts
+    uint64_t time{0};             // end of the interval (nanoseconds since epoch)
+  };
+  using PublishFunc = std::function<void(const Snapshot &)>;
+  using EnabledFunc = std::function<bool()>;
+
+  // maxBacklog: bytes that may wait for the decoder before data is skipped
+  ActivityMonitor(
+    int width, int height, int tileSize, double interval, size_t maxBacklog,
+    const PublishFunc & publish, const EnabledFunc & enabled);
+  ~ActivityMonitor();
+  ActivityMonitor(const ActivityMonitor &) = delete;
+  ActivityMonitor & operator=(const ActivityMonitor &) = delete;
+
+  inline bool isEnabled() const { return (enabled_.load(std::memory_order_relaxed)); }
+  // called from the data path with the raw EVT3 data, in stream order
+  void process(const uint8_t * data, size_t numBytes);
+  size_t getNumBytesSkipped() const { return (bytesSkipped_.load(std::memory_order_relaxed)); }
+
+private:
+  void worker();
+  void decode(const uint8_t * data, size_t numBytes);
+  inline void countVector(uint32_t mask);
+  void resetCounts();
+  // ------------ variables
+  uint32_t width_{0};
+  uint32_t height_{0};
+  uint32_t tileSize_{16};
+  uint32_t tilesX_{0};
+  uint32_t tilesY_{0};
+  std::chrono::nanoseconds interval_;
+  size_t maxBacklog_{0};
+  PublishFunc publish_;
+  EnabledFunc isSubscribed_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<size_t> bytesSkipped_{0};
+  // shared between data path and background thread
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<uint8_t> pending_;
+  bool gap_{false};  // data was skipped, decoder state is lost
+  bool keepRunning_{true};
+  std::thread thread_;
+  // only used by the background thread
+  std::vector<uint32_t> counts_;
+  uint64_t numEvents_[2]{0, 0};
+  std::chrono::system_clock::time_point intervalStart_;
+  uint32_t y_{0};
+  uint32_t baseX_{0};
+  uint32_t polarity_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__ACTIVITY_MONITOR_H_
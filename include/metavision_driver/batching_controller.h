@@ -0,0 +1,93 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__BATCHING_CONTROLLER_H_
+#define METAVISION_DRIVER__BATCHING_CONTROLLER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace metavision_driver
+{
+//
+// Adapts the message size threshold to the measured input rate such
+// that no more than maxMessageRate messages per second are sent. At
+// low event rates this means every packet goes out right away (low
+// latency), at high rates the messages grow, bounding the per-message
+// overhead. The time threshold is held at the latency target, and the
+// size never exceeds maxMessageSize. When the publisher falls behind
+// (backlog, or publish() takes up most of the time) the message rate
+// is cut in half, and then recovers slowly.
+//
+class BatchingController
+{
+public:
+  // latency target in nsec, message rate in Hz, size in bytes
+  BatchingController(uint64_t latencyTarget, double maxMessageRate, size_t maxMessageSize)
+  : latencyTarget_(std::max(latencyTarget, uint64_t(1))),
+    maxMessageRate_(std::max(maxMessageRate, 1e9 / latencyTarget_)),
+    maxMessageSize_(maxMessageSize),
+    messageRate_(maxMessageRate_)
+  {
+  }
+
+  // Call after each message has been cut. dt is the time since the
+  // previous cut, publishTime the duration of publish() (both nsec).
+  void update(uint64_t dt, size_t numBytes, uint64_t publishTime, bool backlog)
+  {
+    if (dt == 0) {
+      return;
+    }
+    const double rate = numBytes * 1e9 / dt;  // bytes/sec
+    byteRate_ = (byteRate_ == 0) ? rate : byteRate_ + RATE_ALPHA * (rate - byteRate_);
+    const double minMessageRate = 1e9 / latencyTarget_;  // can't go lower anyway
+    if (backlog || publishTime > MAX_BUSY_FRACTION * dt) {
+      messageRate_ = std::max(messageRate_ * 0.5, minMessageRate);
+    } else {
+      messageRate_ = std::min(messageRate_ + RECOVERY_RATE * maxMessageRate_, maxMessageRate_);
+    }
+    sizeThreshold_ = std::min(static_cast<size_t>(byteRate_ / messageRate_), maxMessageSize_);
+  }
+
+  // Drops the measured input rate, e.g. when the sensor starts to
+  // deliver its data at a different cadence. The next message sets
+  // the thresholds from scratch rather than decaying towards them.
+  void reset()
+  {
+    byteRate_ = 0;
+    messageRate_ = maxMessageRate_;
+    sizeThreshold_ = 0;
+  }
+
+  uint64_t getTimeThreshold() const { return (latencyTarget_); }
+  size_t getSizeThreshold() const { return (sizeThreshold_); }
+  double getMessageRate() const { return (messageRate_); }
+  double getByteRate() const { return (byteRate_); }
+
+private:
+  static constexpr double RATE_ALPHA = 0.1;         // smoothing of the input rate
+  static constexpr double MAX_BUSY_FRACTION = 0.5;  // publish time before backing off
+  static constexpr double RECOVERY_RATE = 0.01;     // fraction of max rate per message
+  // ------------ variables
+  uint64_t latencyTarget_;
+  double maxMessageRate_;
+  size_t maxMessageSize_;
+  double messageRate_;  // current target message rate
+  double byteRate_{0};  // smoothed input rate [bytes/sec]
+  size_t sizeThreshold_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__BATCHING_CONTROLLER_H_
@@ -0,0 +1,181 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__BUFFER_POOL_H_
+#define METAVISION_DRIVER__BUFFER_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/memory_utils.h"
+#include "metavision_driver/spsc_ring.h"
+
+namespace metavision_driver
+{
+//
+// Fixed-capacity pool of equally sized packet buffers carved out of a
+// single arena. Buffers are acquired by the SDK callback thread and
+// released by the processing thread. When the pool is exhausted, or
+// a packet does not fit into a block, the buffer is taken from the heap
+// instead and the miss is counted. The arena is mapped according to
+// the memory configuration (huge pages, pre-faulted, locked).
+//
+// In lock-free mode (for the SPSC ring queue) the free blocks are held
+// by the producer, and the consumer hands released blocks back through
+// a second SPSC ring, so the SDK thread never waits for the consumer.
+// Blocks the producer gives up itself go back with releaseByProducer().
+// Otherwise a mutex protects the free list, and any thread may release.
+//
+class BufferPool
+{
+public:
+  struct Handle
+  {
+    uint8_t * data{nullptr};
+    int32_t index{-1};  // -1 means block was allocated from the heap
+  };
+
+  BufferPool() {}
+  BufferPool(const BufferPool &) = delete;
+  BufferPool & operator=(const BufferPool &) = delete;
+
+  // allocates numBlocks of blockSize bytes each. Must be called
+  // before the first acquire() and only once. Sets the error message
+  // if the memory could not be set up as configured, or could not be
+  // allocated at all, in which case all buffers come from the heap.
+  void initialize(
+    size_t numBlocks, size_t blockSize, const MemoryConfig & config, bool lockFree,
+    std::string * error)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    initialized_ = true;
+    lockFree_ = lockFree;
+    blockSize_ = blockSize;
+    if (!memory_.allocate(numBlocks * blockSize_, config, error)) {
+      return;
+    }
+    numBlocks_ = numBlocks;
+    arena_ = memory_.data();
+    freeList_.reserve(numBlocks_);
+    for (size_t i = 0; i < numBlocks_; i++) {
+      freeList_.push_back(static_cast<int32_t>(numBlocks_ - 1 - i));
+    }
+    if (lockFree_) {
+      // large enough to hold all blocks, so the consumer never fails to push
+      returned_.reset(new SPSCRing<int32_t>(numBlocks_));
+    }
+  }
+
+  bool isInitialized() const { return (initialized_); }
+
+  Handle acquire(size_t size)
+  {
+    Handle h;
+    if (lockFree_) {
+      if (size <= blockSize_ && (!freeList_.empty() || collectReturned())) {
+        takeBlock(&h, returned_->size());
+        return (h);
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (size <= blockSize_ && !freeList_.empty()) {
+        takeBlock(&h, 0);
+        return (h);
+      }
+    }
+    numExhausted_.fetch_add(1, std::memory_order_relaxed);
+    h.data = static_cast<uint8_t *>(malloc(size));
+    return (h);
+  }
+
+  // called by the consumer, or by any thread when not in lock-free mode
+  void release(const Handle & h)
+  {
+    if (h.index < 0) {
+      free(h.data);
+      return;
+    }
+    if (lockFree_) {
+      returned_->push(h.index);
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    freeList_.push_back(h.index);
+  }
+
+  // called by the thread that acquires, for blocks it did not hand on
+  void releaseByProducer(const Handle & h)
+  {
+    if (h.index >= 0 && lockFree_) {
+      freeList_.push_back(h.index);
+      return;
+    }
+    release(h);
+  }
+
+  // returns the statistics since the last call and resets them
+  void getAndResetStatistics(size_t * numExhausted, size_t * highWaterMark)
+  {
+    *numExhausted = numExhausted_.exchange(0, std::memory_order_relaxed);
+    *highWaterMark = highWaterMark_.exchange(0, std::memory_order_relaxed);
+  }
+
+  size_t getBlockSize() const { return (blockSize_); }
+  size_t getNumBlocks() const { return (numBlocks_); }
+
+private:
+  // moves the blocks released by the consumer to the free list
+  bool collectReturned()
+  {
+    int32_t index;
+    while (returned_ && returned_->pop(&index)) {
+      freeList_.push_back(index);
+    }
+    return (!freeList_.empty());
+  }
+
+  void takeBlock(Handle * h, size_t numReturned)
+  {
+    h->index = freeList_.back();
+    freeList_.pop_back();
+    h->data = arena_ + static_cast<size_t>(h->index) * blockSize_;
+    const size_t numFree = freeList_.size() + numReturned;
+    const size_t inUse = numFree < numBlocks_ ? numBlocks_ - numFree : 0;
+    size_t hwm = highWaterMark_.load(std::memory_order_relaxed);
+    while (inUse > hwm &&
+           !highWaterMark_.compare_exchange_weak(hwm, inUse, std::memory_order_relaxed)) {
+    }
+  }
+  // ------------ variables
+  std::mutex mutex_;  // only used when not in lock-free mode
+  bool initialized_{false};
+  bool lockFree_{false};
+  MappedMemory memory_;
+  uint8_t * arena_{nullptr};
+  size_t blockSize_{0};
+  size_t numBlocks_{0};
+  std::vector<int32_t> freeList_;                // owned by the producer in lock-free mode
+  std::unique_ptr<SPSCRing<int32_t>> returned_;  // consumer -> producer
+  std::atomic<size_t> numExhausted_{0};          // acquire() calls that went to the heap
+  std::atomic<size_t> highWaterMark_{0};         // max number of blocks in use
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__BUFFER_POOL_H_
@@ -18,6 +18,9 @@
 
 #include <metavision/sdk/driver/camera.h>
 
+#include "metavision_driver/evt3_trigger_scanner.h"
+#include "metavision_driver/statistics.h"
+
 namespace metavision_driver
 {
 class CallbackHandler
@@ -28,6 +31,28 @@ public:
   virtual void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) = 0;
   virtual void eventCDCallback(
     uint64_t t, const Metavision::EventCD * start, const Metavision::EventCD * end) = 0;
+  // ------ interface for direct aggregation (multithreaded mode without queue).
+  // Called by the SDK thread: returns a pointer to n writable bytes at the
+  // end of the message currently being filled, or nullptr if the data is not needed.
+  virtual uint8_t * getWritableBuffer(uint64_t t, size_t n) = 0;
+  // Called by the SDK thread after the bytes have been written. Returns
+  // true if a message has been completed and is ready for publishing.
+  virtual bool commitBuffer(uint64_t t) = 0;
+  // Called by the processing thread to publish completed messages.
+  virtual void publishReadyBuffers() = 0;
+  // Called by the SDK thread with the external triggers found in the
+  // raw data (if enabled), before the data goes into any message.
+  // t is the host time when the packet arrived.
+  virtual void triggerCallback(
+    uint64_t t, const EVT3TriggerScanner::Trigger * start,
+    const EVT3TriggerScanner::Trigger * end) = 0;
+  // Called by the statistics thread once per statistics interval.
+  virtual void statisticsCallback(const Statistics & stats) = 0;
+  // Called in the context of rawDataCallback() (or getWritableBuffer()
+  // with direct aggregation) before the first data after a restart of
+  // the stream. The sensor time starts over, so any state kept about it
+  // must be dropped.
+  virtual void resetStream() = 0;
 };
 }  // namespace metavision_driver
 #endif  // METAVISION_DRIVER__CALLBACK_HANDLER_H_
@@ -0,0 +1,180 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__COMPRESSION_POOL_H_
+#define METAVISION_DRIVER__COMPRESSION_POOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/packet_codec.h"
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+//
+// Compresses the payload of event packet messages on a set of worker
+// threads and publishes them in the order they were submitted. When
+// the workers fall behind, submit() blocks, which pushes the backlog
+// into the driver's queue where the overload policy deals with it.
+//
+template <class MsgPtrT>
+class CompressionPool
+{
+public:
+  using PublishFunc = std::function<void(MsgPtrT)>;
+
+  CompressionPool(
+    PacketCodec::Type type, int level, size_t numThreads, size_t maxPending,
+    const PublishFunc & publish)
+  : maxPending_(std::max(maxPending, size_t(1))), publish_(publish)
+  {
+    for (size_t i = 0; i < std::max(numThreads, size_t(1)); i++) {
+      threads_.emplace_back(&CompressionPool::worker, this, type, level);
+    }
+  }
+
+  ~CompressionPool()
+  {
+    {
+      // workers finish what is queued before they exit
+      std::unique_lock<std::mutex> lock(mutex_);
+      keepRunning_ = false;
+      cv_.notify_all();
+    }
+    for (auto & th : threads_) {
+      th.join();
+    }
+  }
+
+  CompressionPool(const CompressionPool &) = delete;
+  CompressionPool & operator=(const CompressionPool &) = delete;
+
+  void submit(MsgPtrT msg)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [this] { return (jobs_.size() < maxPending_); });
+    jobs_.push_back(Job(std::move(msg)));
+    cv_.notify_one();
+  }
+
+  // payload bytes before and after compression, since the last call
+  void getAndResetStatistics(size_t * bytesIn, size_t * bytesOut)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    *bytesIn = bytesIn_;
+    *bytesOut = bytesOut_;
+    bytesIn_ = bytesOut_ = 0;
+  }
+
+private:
+  struct Job
+  {
+    explicit Job(MsgPtrT m) : msg(std::move(m)) {}
+    MsgPtrT msg;
+    bool started{false};
+    bool done{false};
+  };
+
+  void worker(PacketCodec::Type type, int level)
+  {
+    PacketCodec codec(type, level);
+    const char * encoding = PacketCodec::getEncoding(type);
+    std::vector<uint8_t> buffer;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      Job * job = nullptr;
+      cv_.wait(lock, [this, &job] {
+        job = findUnstartedJob();
+        return (job || !keepRunning_);
+      });
+      if (!job) {
+        break;  // nothing left and asked to stop
+      }
+      job->started = true;
+      auto & events = job->msg->events;
+      lock.unlock();
+      // references into the deque stay valid while other jobs are added or removed
+      const size_t sizeIn = events.size();
+      if (codec.compress(events.data(), events.size(), &buffer)) {
+        // copy so the message keeps its (large) buffer for reuse
+        resize_hack(events, buffer.size());
+        memcpy(events.data(), buffer.data(), buffer.size());
+        job->msg->encoding = encoding;
+      }
+      const size_t sizeOut = events.size();
+      lock.lock();
+      job->done = true;
+      bytesIn_ += sizeIn;
+      bytesOut_ += sizeOut;
+      lock.unlock();
+      publishCompleted();
+      lock.lock();
+    }
+  }
+
+  Job * findUnstartedJob()
+  {
+    for (auto & j : jobs_) {
+      if (!j.started) {
+        return (&j);
+      }
+    }
+    return (nullptr);
+  }
+
+  void publishCompleted()
+  {
+    // Only one thread at a time takes completed jobs off the front, and
+    // publishes them before letting the next one in, so the order holds.
+    std::unique_lock<std::mutex> publishLock(publishMutex_);
+    std::vector<MsgPtrT> ready;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!jobs_.empty() && jobs_.front().done) {
+        ready.push_back(std::move(jobs_.front().msg));
+        jobs_.pop_front();
+      }
+      if (!ready.empty()) {
+        doneCv_.notify_all();
+      }
+    }
+    for (auto & msg : ready) {
+      publish_(std::move(msg));
+    }
+  }
+
+  // ------------ variables
+  std::mutex mutex_;  // guards jobs_, keepRunning_ and the statistics
+  std::condition_variable cv_;      // new jobs for the workers
+  std::condition_variable doneCv_;  // room for new jobs
+  std::deque<Job> jobs_;            // in submission order
+  size_t maxPending_;
+  bool keepRunning_{true};
+  std::mutex publishMutex_;
+  PublishFunc publish_;
+  std::vector<std::thread> threads_;
+  size_t bytesIn_{0};
+  size_t bytesOut_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__COMPRESSION_POOL_H_
@@ -16,46 +16,70 @@
 #ifndef METAVISION_DRIVER__DRIVER_ROS1_H_
 #define METAVISION_DRIVER__DRIVER_ROS1_H_
 
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <dynamic_reconfigure/server.h>
 #include <event_camera_msgs/EventPacket.h>
 #include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/TimeReference.h>
+#include <std_msgs/Float64MultiArray.h>
 #include <std_srvs/Trigger.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "metavision_driver/MetaVisionDynConfig.h"
+#include "metavision_driver/activity_monitor.h"
 #include "metavision_driver/bias_parameter.h"
-#include "metavision_driver/callback_handler.h"
-#include "metavision_driver/resize_hack.h"
+#include "metavision_driver/compression_pool.h"
+#include "metavision_driver/message_aggregator.h"
+#include "metavision_driver/sync_group.h"
+#include "metavision_driver/thread_utils.h"
 
 namespace metavision_driver
 {
-class MetavisionWrapper;  // forward decl
-
-class DriverROS1 : public CallbackHandler
+class DriverROS1
+: public MessageAggregator<
+    DriverROS1, event_camera_msgs::EventPacket, event_camera_msgs::EventPacket::Ptr>
 {
   using Config = MetaVisionDynConfig;
   using EventPacketMsg = event_camera_msgs::EventPacket;
+  using Aggregator = MessageAggregator<DriverROS1, EventPacketMsg, EventPacketMsg::Ptr>;
   using Trigger = std_srvs::Trigger;
+  friend Aggregator;
 
 public:
   explicit DriverROS1(ros::NodeHandle & nh);
   ~DriverROS1();
 
   // ---------------- inherited from CallbackHandler -----------
-  void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) override;
+  // (the data path is implemented by the MessageAggregator)
   void eventCDCallback(
     uint64_t t, const Metavision::EventCD * begin, const Metavision::EventCD * end) override;
+  void triggerCallback(
+    uint64_t t, const EVT3TriggerScanner::Trigger * start,
+    const EVT3TriggerScanner::Trigger * end) override;
+  void statisticsCallback(const Statistics & stats) override;
   // ---------------- end of inherited  -----------
 
 private:
   // service call to dump biases
   bool saveBiases(Trigger::Request & req, Trigger::Response & res);
+  // service call to restart streaming without reopening the camera
+  bool restartStreaming(Trigger::Request & req, Trigger::Response & res);
 
   // related to dynanmic config (runtime parameter update)
-  void setBias(int * field, const std::string & name);
+  // clamps the bias and adds it to the values to be set
+  void requestBias(std::map<std::string, int> * values, int field, const std::string & name) const;
+  // copies the bias that took hold back into the config field
+  void updateBias(
+    const std::map<std::string, int> & values, int * field, const std::string & name) const;
   int getBias(const std::string & name) const;
+  // applies the roi, erc and mipi settings that changed (level bits)
+  void configureCamera(Config & config, int level);
 
   void configure(Config & config, int level);
 
@@ -66,29 +90,42 @@ private:
   void start();
   bool stop();
   void configureWrapper(const std::string & name);
+  ThreadConfig getThreadConfig(const std::string & thread);
+  // huge pages, pre-faulting and locking of the queue and message buffers
+  void configureMemory();
+  void openShmRing();
+  void openActivityMonitor();
+  void openTriggerPublisher();
+  // called by the activity monitor thread
+  void publishActivity(const ActivityMonitor::Snapshot & s);
   void initializeBiasParameters(const std::string & sensorVersion);
+  // ---------------- hooks for the MessageAggregator -----------
+  inline bool hasSubscribers() const { return (eventPub_.getNumSubscribers() != 0); }
+  EventPacketMsg::Ptr newMessage(size_t reserveSize);
+  // publishes right away, or after compression if enabled
+  void submitMessage(EventPacketMsg::Ptr msg);
+  void setHeader(EventPacketMsg & msg, uint64_t seq, uint64_t stamp);
   // ------------------------  variables ------------------------------
   ros::NodeHandle nh_;
-  std::shared_ptr<MetavisionWrapper> wrapper_;
-  int width_;   // image width
-  int height_;  // image height
   bool isBigEndian_;
-  std::string frameId_;  // ROS frame id
-  std::string encoding_;
-  uint64_t seq_{0};        // sequence number
-  size_t reserveSize_{0};  // recommended reserve size
-  uint64_t lastMessageTime_{0};
-  uint64_t messageThresholdTime_{0};  // threshold time for sending message
-  size_t messageThresholdSize_{0};    // threshold size for sending message
-  EventPacketMsg::Ptr msg_;
   ros::Publisher eventPub_;
+  ros::Publisher diagnosticsPub_;
+  bool publishStatistics_{false};
+  ros::Publisher activityPub_;
+  ros::Publisher eventRatePub_;
+  ros::Publisher triggerPub_;
+  std::shared_ptr<ActivityMonitor> activityMonitor_;  // publishes, so after the publishers
+  // compresses and publishes messages, declared after the publisher so it goes first
+  std::unique_ptr<CompressionPool<EventPacketMsg::Ptr>> compressor_;
 
   // ------ related to sync
   ros::ServiceServer secondaryReadyServer_;
+  std::shared_ptr<SyncGroup> syncGroup_;  // in-process handshake if set
   // ------ related to dynamic config and services
   Config config_;
   std::shared_ptr<dynamic_reconfigure::Server<Config>> configServer_;
   ros::ServiceServer saveBiasService_;
+  ros::ServiceServer restartService_;
   using ParameterMap = std::map<std::string, BiasParameter>;
   ParameterMap biasParameters_;
 };
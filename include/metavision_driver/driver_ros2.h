@@ -16,36 +16,54 @@
 #ifndef METAVISION_DRIVER__DRIVER_ROS2_H_
 #define METAVISION_DRIVER__DRIVER_ROS2_H_
 
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include <event_camera_msgs/msg/event_packet.hpp>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/time_reference.hpp>
+#include <std_msgs/msg/float64_multi_array.hpp>
 #include <std_msgs/msg/header.hpp>
 #include <std_msgs/msg/int16.hpp>
 #include <std_srvs/srv/trigger.hpp>
 #include <string>
+#include <type_traits>
 
+#include "metavision_driver/activity_monitor.h"
 #include "metavision_driver/bias_parameter.h"
-#include "metavision_driver/callback_handler.h"
-#include "metavision_driver/resize_hack.h"
+#include "metavision_driver/compression_pool.h"
+#include "metavision_driver/message_aggregator.h"
+#include "metavision_driver/sync_group.h"
+#include "metavision_driver/thread_utils.h"
 
 namespace metavision_driver
 {
-class MetavisionWrapper;  // forward decl
-
-class DriverROS2 : public rclcpp::Node, public CallbackHandler
+class DriverROS2 : public rclcpp::Node,
+                   public MessageAggregator<
+                     DriverROS2, event_camera_msgs::msg::EventPacket,
+                     event_camera_msgs::msg::EventPacket::UniquePtr>
 {
   using EventPacketMsg = event_camera_msgs::msg::EventPacket;
+  using LoanedMsg = rclcpp::LoanedMessage<EventPacketMsg>;
+  using Aggregator = MessageAggregator<DriverROS2, EventPacketMsg, EventPacketMsg::UniquePtr>;
   using Trigger = std_srvs::srv::Trigger;
+  friend Aggregator;
 
 public:
   explicit DriverROS2(const rclcpp::NodeOptions & options);
   ~DriverROS2();
 
   // ---------------- inherited from CallbackHandler -----------
-  void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) override;
+  // (the data path is implemented by the MessageAggregator)
   void eventCDCallback(
     uint64_t t, const Metavision::EventCD * begin, const Metavision::EventCD * end) override;
+  void triggerCallback(
+    uint64_t t, const EVT3TriggerScanner::Trigger * start,
+    const EVT3TriggerScanner::Trigger * end) override;
+  void statisticsCallback(const Statistics & stats) override;
   // ---------------- end of inherited  -----------
 
 private:
@@ -53,6 +71,10 @@ private:
   void saveBiases(
     const std::shared_ptr<Trigger::Request> request,
     const std::shared_ptr<Trigger::Response> response);
+  // service call to restart streaming without reopening the camera
+  void restartStreaming(
+    const std::shared_ptr<Trigger::Request> request,
+    const std::shared_ptr<Trigger::Response> response);
 
   // related to dynanmic config (runtime parameter update)
   rcl_interfaces::msg::SetParametersResult parameterChanged(
@@ -61,26 +83,50 @@ private:
   void addBiasParameter(const std::string & n, const BiasParameter & bp);
   void initializeBiasParameters(const std::string & sensorVersion);
   void declareBiasParameters(const std::string & sensorVersion);
+  // roi, erc and mipi frame period, which can be changed while streaming
+  void declareCameraParameters();
+  void applyCameraParameters(const std::map<std::string, rclcpp::Parameter> & params);
 
   // misc helper functions
   void start();
   bool stop();
   void configureWrapper(const std::string & name);
+  ThreadConfig getThreadConfig(const std::string & thread);
+  // huge pages, pre-faulting and locking of the queue and message buffers
+  void configureMemory();
+  void openShmRing();
+  void openActivityMonitor();
+  void openTriggerPublisher();
+  // called by the activity monitor thread
+  void publishActivity(const ActivityMonitor::Snapshot & s);
+  void publishUniqueMessage(EventPacketMsg::UniquePtr msg);
+  // ---------------- hooks for the MessageAggregator -----------
+  inline bool hasSubscribers() const { return (eventPub_->get_subscription_count() > 0); }
+  EventPacketMsg::UniquePtr newMessage(size_t reserveSize);
+  // publishes right away, or after compression if enabled
+  void submitMessage(EventPacketMsg::UniquePtr msg);
+  void setHeader(EventPacketMsg & msg, uint64_t seq, uint64_t stamp);
+  // fills the message in place in middleware-owned memory if enabled
+  EventPacketMsg * borrowMessage();
+  void publishBorrowedMessage();
+  void releaseBorrowedMessage();
+  inline LoanedMsg & loanedMsg() { return (*reinterpret_cast<LoanedMsg *>(&loanedMsgStorage_)); }
+  void endLoan();
 
   // ------------------------  variables ------------------------------
-  std::shared_ptr<MetavisionWrapper> wrapper_;
-  int width_;   // image width
-  int height_;  // image height
   bool isBigEndian_;
-  std::string frameId_;
-  std::string encoding_;
-  uint64_t seq_{0};        // sequence number
-  size_t reserveSize_{0};  // recommended reserve size
-  uint64_t lastMessageTime_{0};
-  uint64_t messageThresholdTime_{0};  // threshold time for sending message
-  size_t messageThresholdSize_{0};    // threshold size for sending message
-  EventPacketMsg::UniquePtr msg_;
   rclcpp::Publisher<EventPacketMsg>::SharedPtr eventPub_;
+  bool useLoanedMessages_{false};
+  // the loan is constructed in place, so borrowing does not allocate
+  std::aligned_storage<sizeof(LoanedMsg), alignof(LoanedMsg)>::type loanedMsgStorage_;
+  bool hasLoan_{false};
+  // compresses and publishes messages, declared after the publisher so it goes first
+  std::unique_ptr<CompressionPool<EventPacketMsg::UniquePtr>> compressor_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnosticsPub_;
+  rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr activityPub_;
+  rclcpp::Publisher<std_msgs::msg::Float64MultiArray>::SharedPtr eventRatePub_;
+  rclcpp::Publisher<sensor_msgs::msg::TimeReference>::SharedPtr triggerPub_;
+  std::shared_ptr<ActivityMonitor> activityMonitor_;  // publishes, so after the publishers
   // ------ related to sync
   void readyCallback(const std_msgs::msg::Int16::SharedPtr msg);
   // void checkSecondaryNodeService();
@@ -88,6 +134,7 @@ private:
   //   rclcpp::Client<std_srvs::srv::Trigger>::SharedFuture future, int node_id);
   // rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr secondaryReadyServer_;
   int secondaryNodeNr_;
+  std::shared_ptr<SyncGroup> syncGroup_;  // in-process handshake if set
   int numSecondaryNodes_;
   std::unordered_set<int> acknowledgedNodes_;
   // rclcpp::Client<std_srvs::srv::Trigger>::SharedPtr serviceClient_;
@@ -100,6 +147,7 @@ private:
     parameterSubscription_;
   ParameterMap biasParameters_;
   rclcpp::Service<Trigger>::SharedPtr saveBiasesService_;
+  rclcpp::Service<Trigger>::SharedPtr restartService_;
 };
 }  // namespace metavision_driver
 #endif  // METAVISION_DRIVER__DRIVER_ROS2_H_
@@ -0,0 +1,93 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT3_FILTER_H_
+#define METAVISION_DRIVER__EVT3_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Removes CD events of masked pixels from a raw EVT3 stream without
+// decoding it into events. Single events (ADDR_X) of masked pixels are
+// dropped, vector words (VECT_12, VECT_8) get the bits of masked pixels
+// cleared, and are dropped when no bit is left. ADDR_Y and VECT_BASE_X
+// words are only written once an event that needs them survives, so
+// rows without surviving events cost nothing downstream. All other
+// words (time, triggers, ...) pass unchanged.
+//
+// Runs of words from rows that are entirely enabled or entirely masked
+// are located with SIMD (SSE2, AVX2, NEON) and copied or compacted in
+// bulk, only rows that are partially masked are processed word by word.
+//
+// The filter keeps the decoder state across calls, so it must see the
+// packets of a stream in order. Events before the first ADDR_Y word of
+// a stream (or after reset()) have no known row and are dropped.
+//
+class EVT3Filter
+{
+public:
+  EVT3Filter(int width, int height);
+
+  // Masks all pixels outside the given ROIs. The ROI vector has the same
+  // layout as the driver's roi parameter: x, y, width, height, x, y, ...
+  bool setROI(const std::vector<int> & roi, std::string * error);
+  // Masks the pixels listed in the file, one "x y" (or "x, y") per line.
+  // Empty lines and lines starting with '#' are ignored.
+  bool loadPixelMask(const std::string & fileName, std::string * error);
+  // true if at least one pixel is masked
+  bool isActive() const { return (numMasked_ != 0); }
+  size_t getNumMaskedPixels() const { return (numMasked_); }
+
+  // Filters numBytes of EVT3 data from in to out, returns the number of
+  // bytes written. out may be the same as in (filtering in place).
+  size_t filter(const uint8_t * in, size_t numBytes, uint8_t * out);
+  // forget the decoder state, e.g. when the stream restarts
+  void reset();
+
+private:
+  enum RowMode : uint8_t { ROW_ENABLED, ROW_MASKED, ROW_PARTIAL };
+  void maskPixel(int x, int y);
+  void updateRowModes();
+  // numBits of the keep mask of row y, starting at column x
+  inline uint32_t getKeepBits(uint32_t x, uint32_t numBits) const;
+  // copies a run of words from an enabled row
+  void copyRun(const uint8_t * in, size_t numWords, uint8_t * out);
+  // copies the non-CD words of a run from a masked row
+  size_t compactRun(const uint8_t * in, size_t numWords, uint8_t * out);
+  inline void writeWord(uint8_t * out, size_t * k, uint16_t w);
+  inline void writePending(uint8_t * out, size_t * k);
+  // ------------ variables
+  uint32_t width_{0};
+  uint32_t height_{0};
+  size_t wordsPerRow_{0};        // 64 bit words per row, padded by one
+  std::vector<uint64_t> keep_;   // one bit per pixel, 1 = pass the event
+  std::vector<uint8_t> rowMode_;
+  size_t numMasked_{0};
+  // decoder state
+  uint8_t mode_{ROW_MASKED};  // mode of the current row, unknown rows are masked
+  uint32_t y_{0};
+  uint16_t yWord_{0};  // last ADDR_Y word
+  uint32_t baseX_{0};
+  uint16_t polarity_{0};  // polarity bit of the last VECT_BASE_X word
+  bool yPending_{false};     // ADDR_Y must be written before the next event
+  bool basePending_{false};  // VECT_BASE_X must be written before the next vector
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT3_FILTER_H_
@@ -0,0 +1,156 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT3_SCANNER_H_
+#define METAVISION_DRIVER__EVT3_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace metavision_driver
+{
+namespace evt3
+{
+// EVT3 word types (upper 4 bits of each 16 bit word)
+enum Type : uint8_t {
+  ADDR_Y = 0x0,
+  ADDR_X = 0x2,
+  VECT_BASE_X = 0x3,
+  VECT_12 = 0x4,
+  VECT_8 = 0x5,
+  TIME_LOW = 0x6,
+  CONTINUED_4 = 0x7,
+  TIME_HIGH = 0x8,
+  EXT_TRIGGER = 0xA,
+  OTHERS = 0xE,
+  CONTINUED_12 = 0xF
+};
+
+inline uint8_t type(uint16_t w) { return (static_cast<uint8_t>(w >> 12)); }
+inline uint16_t payload(uint16_t w) { return (w & 0x0FFF); }
+}  // namespace evt3
+
+//
+// Tracks the sensor time of an EVT3 stream by looking only at the
+// TIME_HIGH and TIME_LOW words. CD events are not decoded. The 24 bit
+// EVT3 time (in microseconds) is extended to 64 bits by counting wraps.
+// Applying the same time word twice does not change the state, so a
+// buffer can be rescanned from a previously returned split offset.
+//
+class EVT3Scanner
+{
+public:
+  // true once a TIME_HIGH word has been seen
+  bool hasValidTime() const { return (hasTimeHigh_); }
+  // current sensor time in microseconds
+  uint64_t getTime() const { return (epoch_ + (timeHigh_ << 12) + timeLow_); }
+
+  // updates the time from all time words in the buffer
+  void scan(const uint8_t * data, size_t numBytes)
+  {
+    const size_t numWords = numBytes / 2;
+    for (size_t i = 0; i < numWords; i++) {
+      processWord(getWord(data, i));
+    }
+  }
+
+  // Scans until the sensor time reaches tEnd (microseconds). Returns the
+  // byte offset of the time word where this happens, or numBytes if tEnd
+  // was not reached. The time word at the returned offset has been applied.
+  size_t scanUntil(const uint8_t * data, size_t numBytes, uint64_t tEnd)
+  {
+    const size_t numWords = numBytes / 2;
+    for (size_t i = 0; i < numWords; i++) {
+      if (processWord(getWord(data, i)) && hasTimeHigh_ && getTime() >= tEnd) {
+        return (i * 2);
+      }
+    }
+    return (numBytes);
+  }
+
+  // Like scanUntil(), but only stops at a TIME_HIGH word. Such a
+  // location is a good place to start decoding.
+  size_t scanUntilTimeHigh(const uint8_t * data, size_t numBytes, uint64_t tEnd)
+  {
+    const size_t numWords = numBytes / 2;
+    for (size_t i = 0; i < numWords; i++) {
+      const uint16_t w = getWord(data, i);
+      processWord(w);
+      if (evt3::type(w) == evt3::TIME_HIGH && getTime() >= tEnd) {
+        return (i * 2);
+      }
+    }
+    return (numBytes);
+  }
+
+  // returns byte offset of first TIME_HIGH word, or numBytes if there is none
+  static size_t findTimeHigh(const uint8_t * data, size_t numBytes)
+  {
+    const size_t numWords = numBytes / 2;
+    for (size_t i = 0; i < numWords; i++) {
+      if (evt3::type(getWord(data, i)) == evt3::TIME_HIGH) {
+        return (i * 2);
+      }
+    }
+    return (numBytes);
+  }
+
+  void reset()
+  {
+    hasTimeHigh_ = false;
+    epoch_ = 0;
+    timeHigh_ = 0;
+    timeLow_ = 0;
+  }
+
+private:
+  static inline uint16_t getWord(const uint8_t * data, size_t i)
+  {
+    uint16_t w;
+    memcpy(&w, data + 2 * i, sizeof(w));  // EVT3 is little endian
+    return (w);
+  }
+
+  // returns true if the word is a time word
+  inline bool processWord(uint16_t w)
+  {
+    const uint8_t t = evt3::type(w);
+    if (t == evt3::TIME_HIGH) {
+      const uint64_t th = evt3::payload(w);
+      if (th != timeHigh_ || !hasTimeHigh_) {
+        if (hasTimeHigh_ && th + 2048 < timeHigh_) {
+          epoch_ += (1ULL << 24);  // 24 bit time has wrapped around
+        }
+        timeHigh_ = th;
+        timeLow_ = 0;
+        hasTimeHigh_ = true;
+      }
+      return (true);
+    }
+    if (t == evt3::TIME_LOW) {
+      timeLow_ = evt3::payload(w);
+      return (true);
+    }
+    return (false);
+  }
+  // ------------ variables
+  bool hasTimeHigh_{false};
+  uint64_t epoch_{0};  // accumulated wrap arounds
+  uint64_t timeHigh_{0};
+  uint64_t timeLow_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT3_SCANNER_H_
@@ -0,0 +1,112 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT3_TIME_CHECK_H_
+#define METAVISION_DRIVER__EVT3_TIME_CHECK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "metavision_driver/evt3_scanner.h"
+
+namespace metavision_driver
+{
+namespace evt3
+{
+//
+// Until a secondary camera receives the sync clock from the primary,
+// all its time words are zero. These functions find the first TIME_HIGH
+// or TIME_LOW word with non-zero payload directly in the raw data, 8
+// (SSE2, NEON) or 16 (AVX2) words at a time, without decoding events.
+//
+inline bool isNonZeroTime(uint16_t w)
+{
+  return ((type(w) == TIME_HIGH || type(w) == TIME_LOW) && payload(w) != 0);
+}
+
+// returns byte offset of the first non-zero time word, or numBytes if there is none
+inline size_t findNonZeroTime(const uint8_t * data, size_t numBytes)
+{
+  const size_t numWords = numBytes / 2;
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i typeMask = _mm256_set1_epi16(static_cast<int16_t>(0xF000));
+  const __m256i payloadMask = _mm256_set1_epi16(0x0FFF);
+  const __m256i timeHigh = _mm256_set1_epi16(static_cast<int16_t>(TIME_HIGH << 12));
+  const __m256i timeLow = _mm256_set1_epi16(static_cast<int16_t>(TIME_LOW << 12));
+  const __m256i zero = _mm256_setzero_si256();
+  for (; i + 16 <= numWords; i += 16) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 2 * i));
+    const __m256i t = _mm256_and_si256(v, typeMask);
+    const __m256i isTime =
+      _mm256_or_si256(_mm256_cmpeq_epi16(t, timeHigh), _mm256_cmpeq_epi16(t, timeLow));
+    const __m256i isZero = _mm256_cmpeq_epi16(_mm256_and_si256(v, payloadMask), zero);
+    const __m256i found = _mm256_andnot_si256(isZero, isTime);
+    const uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(found));
+    if (m != 0) {
+      return (2 * i + __builtin_ctz(m));  // lowest bit is low byte of the word
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i typeMask = _mm_set1_epi16(static_cast<int16_t>(0xF000));
+  const __m128i payloadMask = _mm_set1_epi16(0x0FFF);
+  const __m128i timeHigh = _mm_set1_epi16(static_cast<int16_t>(TIME_HIGH << 12));
+  const __m128i timeLow = _mm_set1_epi16(static_cast<int16_t>(TIME_LOW << 12));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= numWords; i += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 2 * i));
+    const __m128i t = _mm_and_si128(v, typeMask);
+    const __m128i isTime = _mm_or_si128(_mm_cmpeq_epi16(t, timeHigh), _mm_cmpeq_epi16(t, timeLow));
+    const __m128i isZero = _mm_cmpeq_epi16(_mm_and_si128(v, payloadMask), zero);
+    const uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_andnot_si128(isZero, isTime)));
+    if (m != 0) {
+      return (2 * i + __builtin_ctz(m));
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint16x8_t typeMask = vdupq_n_u16(0xF000);
+  const uint16x8_t payloadMask = vdupq_n_u16(0x0FFF);
+  const uint16x8_t timeHigh = vdupq_n_u16(TIME_HIGH << 12);
+  const uint16x8_t timeLow = vdupq_n_u16(TIME_LOW << 12);
+  for (; i + 8 <= numWords; i += 8) {
+    uint16_t w[8];
+    memcpy(w, data + 2 * i, sizeof(w));
+    const uint16x8_t v = vld1q_u16(w);
+    const uint16x8_t t = vandq_u16(v, typeMask);
+    const uint16x8_t isTime = vorrq_u16(vceqq_u16(t, timeHigh), vceqq_u16(t, timeLow));
+    if (vmaxvq_u16(vandq_u16(isTime, vtstq_u16(v, payloadMask))) != 0) {
+      break;  // the scalar loop below finds the exact word
+    }
+  }
+#endif
+  for (; i < numWords; i++) {
+    uint16_t w;
+    memcpy(&w, data + 2 * i, sizeof(w));
+    if (isNonZeroTime(w)) {
+      return (2 * i);
+    }
+  }
+  return (numBytes);
+}
+}  // namespace evt3
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT3_TIME_CHECK_H_
@@ -0,0 +1,155 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT3_TRIGGER_SCANNER_H_
+#define METAVISION_DRIVER__EVT3_TRIGGER_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "metavision_driver/evt3_scanner.h"
+
+namespace metavision_driver
+{
+//
+// Extracts the external trigger events (EXT_TRIGGER words) with their
+// sensor time from a raw EVT3 stream. Only the TIME_HIGH and
+// EXT_TRIGGER words are located, 8 (SSE2, NEON) or 16 (AVX2) words at a
+// time. The TIME_LOW word that completes the time of a trigger is
+// searched backwards from the trigger, so the cost stays well below
+// that of scanning all time words. The time state is the same as that
+// of an EVT3Scanner that has seen all words, so the scanner must see
+// the packets of a stream in order.
+//
+class EVT3TriggerScanner
+{
+public:
+  struct Trigger
+  {
+    uint64_t time{0};      // sensor time in microseconds
+    uint8_t id{0};         // trigger channel
+    uint8_t polarity{0};   // 1 = rising edge
+  };
+
+  // Appends the triggers found in the data. Triggers that come before
+  // the first TIME_HIGH word of the stream have no time and are skipped.
+  void scan(const uint8_t * data, size_t numBytes, std::vector<Trigger> * triggers)
+  {
+    const size_t numWords = numBytes / 2;
+    size_t lowStart = 0;  // TIME_LOW words before this have been applied or are obsolete
+    for (size_t i = findTimeHighOrTrigger(data, 0, numWords); i < numWords;
+         i = findTimeHighOrTrigger(data, i + 1, numWords)) {
+      const uint16_t w = getWord(data, i);
+      applyLastTimeLow(data, lowStart, i);
+      lowStart = i + 1;
+      if (evt3::type(w) == evt3::TIME_HIGH) {
+        scanner_.scan(data + 2 * i, 2);
+      } else if (scanner_.hasValidTime()) {
+        Trigger t;
+        t.time = scanner_.getTime();
+        t.id = static_cast<uint8_t>((w >> 8) & 0x0F);
+        t.polarity = static_cast<uint8_t>(w & 0x01);
+        triggers->push_back(t);
+      }
+    }
+    applyLastTimeLow(data, lowStart, numWords);  // for triggers in the next packet
+  }
+
+  bool hasValidTime() const { return (scanner_.hasValidTime()); }
+  uint64_t getTime() const { return (scanner_.getTime()); }
+  void reset() { scanner_.reset(); }
+
+private:
+  static inline uint16_t getWord(const uint8_t * data, size_t i)
+  {
+    uint16_t w;
+    memcpy(&w, data + 2 * i, sizeof(w));  // EVT3 is little endian
+    return (w);
+  }
+
+  // TIME_HIGH (0x8) and EXT_TRIGGER (0xA) are the only types that
+  // match 0x8 once bit 13 is masked off
+  static inline bool isTimeHighOrTrigger(uint16_t w) { return ((w & 0xD000) == 0x8000); }
+
+  // returns the word index of the next TIME_HIGH or EXT_TRIGGER word at
+  // or after word i, or numWords if there is none
+  static size_t findTimeHighOrTrigger(const uint8_t * data, size_t i, size_t numWords)
+  {
+#if defined(__AVX2__)
+    const __m256i typeMask = _mm256_set1_epi16(static_cast<int16_t>(0xD000));
+    const __m256i match = _mm256_set1_epi16(static_cast<int16_t>(0x8000));
+    for (; i + 16 <= numWords; i += 16) {
+      const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 2 * i));
+      const __m256i found = _mm256_cmpeq_epi16(_mm256_and_si256(v, typeMask), match);
+      const uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(found));
+      if (m != 0) {
+        return (i + __builtin_ctz(m) / 2);
+      }
+    }
+#elif defined(__SSE2__)
+    const __m128i typeMask = _mm_set1_epi16(static_cast<int16_t>(0xD000));
+    const __m128i match = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+    for (; i + 8 <= numWords; i += 8) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 2 * i));
+      const __m128i found = _mm_cmpeq_epi16(_mm_and_si128(v, typeMask), match);
+      const uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(found));
+      if (m != 0) {
+        return (i + __builtin_ctz(m) / 2);
+      }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint16x8_t typeMask = vdupq_n_u16(0xD000);
+    const uint16x8_t match = vdupq_n_u16(0x8000);
+    for (; i + 8 <= numWords; i += 8) {
+      uint16_t w[8];
+      memcpy(w, data + 2 * i, sizeof(w));
+      const uint16x8_t v = vld1q_u16(w);
+      if (vmaxvq_u16(vceqq_u16(vandq_u16(v, typeMask), match)) != 0) {
+        break;  // the scalar loop below finds the exact word
+      }
+    }
+#endif
+    for (; i < numWords; i++) {
+      if (isTimeHighOrTrigger(getWord(data, i))) {
+        return (i);
+      }
+    }
+    return (numWords);
+  }
+
+  // applies the last TIME_LOW word in the words [begin, end), the
+  // ones before it are overwritten by it anyway
+  void applyLastTimeLow(const uint8_t * data, size_t begin, size_t end)
+  {
+    for (size_t k = end; k > begin; k--) {
+      if (evt3::type(getWord(data, k - 1)) == evt3::TIME_LOW) {
+        scanner_.scan(data + 2 * (k - 1), 2);
+        return;
+      }
+    }
+  }
+  // ------------ variables
+  EVT3Scanner scanner_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT3_TRIGGER_SCANNER_H_
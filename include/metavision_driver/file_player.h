@@ -0,0 +1,86 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__FILE_PLAYER_H_
+#define METAVISION_DRIVER__FILE_PLAYER_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace metavision_driver
+{
+//
+// Plays back an EVT3 raw file without the SDK. The file is memory
+// mapped and handed out in chunks straight from the mapping, so no
+// decoding or extra copy happens. The sensor time (from the EVT3 time
+// words) paces the playback at playbackRate times real time, or as
+// fast as possible when the rate is 0.
+//
+class FilePlayer
+{
+public:
+  using Callback = std::function<void(const uint8_t *, size_t)>;
+
+  FilePlayer() {}
+  ~FilePlayer();
+  FilePlayer(const FilePlayer &) = delete;
+  FilePlayer & operator=(const FilePlayer &) = delete;
+
+  // maps the file and parses the header. Returns false on error.
+  bool open(const std::string & fileName);
+  void setPlaybackRate(double rate) { playbackRate_ = rate; }
+  void setPacketSize(size_t n) { packetSize_ = std::max(n & ~size_t(1), size_t(2)); }
+  // Callbacks are invoked from the playback thread.
+  // onEnd is called once the end of the file has been reached.
+  void start(const Callback & callback, const std::function<void()> & onEnd);
+  void stop();
+  bool isRunning() const { return (thread_ != nullptr); }
+
+  int getWidth() const { return (width_); }
+  int getHeight() const { return (height_); }
+  const std::string & getSerialNumber() const { return (serialNumber_); }
+  const std::string & getError() const { return (error_); }
+  size_t getDataSize() const { return (size_ - dataOffset_); }
+
+private:
+  bool parseHeader();
+  void playbackThread();
+
+  // ------------ variables
+  std::string error_;
+  uint8_t * data_{nullptr};  // start of mapping
+  size_t size_{0};           // size of mapping
+  size_t dataOffset_{0};     // start of EVT3 data after text header
+  int width_{0};
+  int height_{0};
+  std::string serialNumber_;
+  double playbackRate_{1.0};
+  size_t packetSize_{64 * 1024};
+  Callback callback_;
+  std::function<void()> onEnd_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool keepRunning_{false};
+  std::shared_ptr<std::thread> thread_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__FILE_PLAYER_H_
@@ -0,0 +1,121 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__LATENCY_HISTOGRAM_H_
+#define METAVISION_DRIVER__LATENCY_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace metavision_driver
+{
+//
+// Log-linear (HDR style) histogram of durations. Each power of two
+// is split into 16 linear sub-buckets, giving about 6% resolution over
+// the full 64 bit range. Recording is a single relaxed increment, so it
+// can be done on the data path while another thread reads the histogram.
+//
+class LatencyHistogram
+{
+public:
+  struct Summary
+  {
+    uint64_t count{0};
+    uint64_t p50{0};
+    uint64_t p99{0};
+    uint64_t p999{0};
+    uint64_t max{0};
+  };
+
+  LatencyHistogram()
+  {
+    for (auto & b : buckets_) {
+      b.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  inline void record(uint64_t v)
+  {
+    buckets_[bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t old = max_.load(std::memory_order_relaxed);
+    while (v > old && !max_.compare_exchange_weak(old, v, std::memory_order_relaxed)) {
+    }
+  }
+
+  // computes the percentiles and resets the histogram
+  Summary getAndReset()
+  {
+    std::array<uint32_t, NUM_BUCKETS> counts;
+    Summary s;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+      counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+      s.count += counts[i];
+    }
+    s.max = max_.exchange(0, std::memory_order_relaxed);
+    if (s.count == 0) {
+      return (s);
+    }
+    const uint64_t n50 = (s.count * 500 + 999) / 1000;
+    const uint64_t n99 = (s.count * 990 + 999) / 1000;
+    const uint64_t n999 = (s.count * 999 + 999) / 1000;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+      if (counts[i] == 0) {
+        continue;
+      }
+      const uint64_t prevSum = sum;
+      sum += counts[i];
+      const uint64_t v = bucketValue(i);
+      s.p50 = (prevSum < n50 && sum >= n50) ? v : s.p50;
+      s.p99 = (prevSum < n99 && sum >= n99) ? v : s.p99;
+      s.p999 = (prevSum < n999 && sum >= n999) ? v : s.p999;
+    }
+    return (s);
+  }
+
+private:
+  static constexpr int SUB_BITS = 4;
+  static constexpr uint64_t NUM_SUB = 1ULL << SUB_BITS;
+  static constexpr size_t NUM_BUCKETS = (64 - SUB_BITS + 1) * NUM_SUB;
+
+  static inline size_t bucketIndex(uint64_t v)
+  {
+    if (v < NUM_SUB) {
+      return (static_cast<size_t>(v));
+    }
+    const int msb = 63 - __builtin_clzll(v);
+    const int shift = msb - SUB_BITS;
+    const uint64_t sub = (v >> shift) & (NUM_SUB - 1);
+    return (static_cast<size_t>((shift + 1) * NUM_SUB + sub));
+  }
+
+  // center of the bucket
+  static inline uint64_t bucketValue(size_t idx)
+  {
+    if (idx < NUM_SUB) {
+      return (idx);
+    }
+    const int shift = static_cast<int>(idx / NUM_SUB) - 1;
+    const uint64_t sub = idx % NUM_SUB;
+    return (((NUM_SUB + sub) << shift) + ((1ULL << shift) >> 1));
+  }
+  // ------------ variables
+  std::array<std::atomic<uint32_t>, NUM_BUCKETS> buckets_;
+  std::atomic<uint64_t> max_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__LATENCY_HISTOGRAM_H_
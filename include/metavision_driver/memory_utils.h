@@ -0,0 +1,228 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__MEMORY_UTILS_H_
+#define METAVISION_DRIVER__MEMORY_UTILS_H_
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace metavision_driver
+{
+//
+// How the large buffers of the data path (queue pool, pooled message
+// buffers) are backed. The first touch of a page costs a page fault,
+// which for megabyte sized buffers adds up to latency spikes on the SDK
+// thread. The buffers can therefore be backed by huge pages, be faulted
+// in when they are allocated, and be locked into memory.
+//
+struct MemoryConfig
+{
+  std::string hugePages{"none"};  // none, transparent, explicit
+  bool prefault{false};           // touch all pages when allocating
+  bool lock{false};               // mlock the buffers, needs RLIMIT_MEMLOCK
+
+  bool isDefault() const { return (hugePages == "none" && !prefault && !lock); }
+};
+
+// default huge page size on x86-64 and aarch64 (4k base pages)
+static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// writes to every page so it is backed by memory, keeps the contents
+inline void prefaultMemory(void * p, size_t size)
+{
+  const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  volatile uint8_t * q = static_cast<volatile uint8_t *>(p);
+  for (size_t i = 0; i < size; i += pageSize) {
+    q[i] = q[i];
+  }
+  if (size != 0) {
+    q[size - 1] = q[size - 1];
+  }
+}
+
+// Applies the configuration to memory that has already been allocated,
+// e.g. the buffer of a vector. Huge pages can only be advised for the
+// whole huge pages within the buffer. Returns false and sets the error
+// message if any part of it failed.
+inline bool prepareMemory(void * p, size_t size, const MemoryConfig & c, std::string * error)
+{
+  bool ok = true;
+  error->clear();
+  if (size == 0) {
+    return (true);
+  }
+  if (c.hugePages != "none") {
+    const uintptr_t mask = ~static_cast<uintptr_t>(HUGE_PAGE_SIZE - 1);
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + HUGE_PAGE_SIZE - 1) & mask;
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(p) + size) & mask;
+    if (end > begin && madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE) != 0) {
+      *error += std::string("cannot advise huge pages: ") + strerror(errno) + " ";
+      ok = false;
+    }
+  }
+  if (c.prefault) {
+    prefaultMemory(p, size);
+  }
+  if (c.lock && mlock(p, size) != 0) {
+    *error += std::string("cannot lock memory: ") + strerror(errno) + " ";
+    ok = false;
+  }
+  return (ok);
+}
+
+//
+// Anonymous memory mapping that is set up according to a MemoryConfig.
+// For transparent huge pages, the mapping is aligned to the huge page
+// size so the kernel can back all of it with huge pages.
+//
+class MappedMemory
+{
+public:
+  MappedMemory() {}
+  ~MappedMemory() { release(); }
+  MappedMemory(const MappedMemory &) = delete;
+  MappedMemory & operator=(const MappedMemory &) = delete;
+
+  // Returns false if no memory could be mapped. If the memory could
+  // not be set up as configured (e.g. no explicit huge pages are
+  // available) it is still mapped, but the error message is set.
+  bool allocate(size_t size, const MemoryConfig & c, std::string * error)
+  {
+    release();
+    error->clear();
+    std::string e;
+    const int prot = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+    if (c.hugePages == "explicit") {
+      mapSize_ = roundUp(size, HUGE_PAGE_SIZE);
+      base_ = mmap(nullptr, mapSize_, prot, flags | MAP_HUGETLB, -1, 0);
+      if (base_ == MAP_FAILED) {
+        // the pool of explicit huge pages is set with vm.nr_hugepages
+        e += std::string("no explicit huge pages: ") + strerror(errno) + " ";
+      } else {
+        data_ = static_cast<uint8_t *>(base_);
+      }
+    }
+#endif
+    if (!data_) {
+      const bool align = c.hugePages != "none";
+      mapSize_ = align ? roundUp(size, HUGE_PAGE_SIZE) + HUGE_PAGE_SIZE : size;
+      base_ = mmap(nullptr, mapSize_, prot, flags, -1, 0);
+      if (base_ == MAP_FAILED) {
+        *error = std::string("cannot map memory: ") + strerror(errno);
+        base_ = nullptr;
+        mapSize_ = 0;
+        return (false);
+      }
+      data_ = static_cast<uint8_t *>(base_);
+      if (align) {
+        const uintptr_t b = reinterpret_cast<uintptr_t>(base_);
+        data_ += roundUp(b, HUGE_PAGE_SIZE) - b;
+      }
+    }
+    size_ = size;
+    MemoryConfig rest(c);
+    if (c.hugePages == "explicit" && e.empty()) {
+      rest.hugePages = "none";  // already backed by huge pages
+    }
+    if (!prepareMemory(data_, size_, rest, error) || !e.empty()) {
+      *error = e + *error;
+    }
+    return (true);
+  }
+
+  void release()
+  {
+    if (base_) {
+      munmap(base_, mapSize_);  // also unlocks
+    }
+    base_ = nullptr;
+    data_ = nullptr;
+    mapSize_ = 0;
+    size_ = 0;
+  }
+
+  uint8_t * data() const { return (data_); }
+  size_t size() const { return (size_); }
+
+private:
+  static size_t roundUp(size_t n, size_t m) { return (((n + m - 1) / m) * m); }
+  // ------------ variables
+  void * base_{nullptr};
+  size_t mapSize_{0};
+  uint8_t * data_{nullptr};
+  size_t size_{0};
+};
+
+struct PageFaults
+{
+  size_t minor{0};  // served without I/O, e.g. first touch of a page
+  size_t major{0};  // needed I/O
+};
+
+// page faults of this process since it started
+inline PageFaults getProcessPageFaults()
+{
+  PageFaults pf;
+  rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+    pf.minor = static_cast<size_t>(ru.ru_minflt);
+    pf.major = static_cast<size_t>(ru.ru_majflt);
+  }
+  return (pf);
+}
+
+// kernel id of the calling thread, as used in /proc
+inline pid_t getThreadId() { return (static_cast<pid_t>(syscall(SYS_gettid))); }
+
+// Page faults of a thread of this process since it started. Unlike
+// getrusage(RUSAGE_THREAD) this works for any thread of the process.
+// Returns false if the thread does not exist (anymore).
+inline bool getThreadPageFaults(pid_t tid, PageFaults * pf)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%d/stat", static_cast<int>(tid));
+  FILE * f = fopen(path, "r");
+  if (!f) {
+    return (false);
+  }
+  char buf[1024];
+  const size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[n] = 0;
+  // the thread name in parentheses may contain spaces, skip past it
+  const char * p = strrchr(buf, ')');
+  uint64_t minflt, majflt;
+  const char * fmt = " %*c %*d %*d %*d %*d %*d %*u %" SCNu64 " %*u %" SCNu64;
+  if (!p || sscanf(p + 1, fmt, &minflt, &majflt) != 2) {
+    return (false);
+  }
+  pf->minor = minflt;
+  pf->major = majflt;
+  return (true);
+}
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__MEMORY_UTILS_H_
@@ -0,0 +1,377 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__MESSAGE_AGGREGATOR_H_
+#define METAVISION_DRIVER__MESSAGE_AGGREGATOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "metavision_driver/batching_controller.h"
+#include "metavision_driver/callback_handler.h"
+#include "metavision_driver/evt3_scanner.h"
+#include "metavision_driver/message_pool.h"
+#include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/resize_hack.h"
+#include "metavision_driver/ros_time_keeper.h"
+#include "metavision_driver/shm_ring.h"
+
+namespace metavision_driver
+{
+//
+// Packs the raw data coming from the wrapper into event packet
+// messages: time and size thresholds (adapted by the batching
+// controller if set), cuts on sensor time, sensor time stamps, direct
+// aggregation and the message statistics. The ROS1 and ROS2 drivers
+// derive from it (CRTP) and only provide the ROS specific pieces:
+//
+//   bool hasSubscribers();
+//   MsgPtrT newMessage(size_t reserveSize);  // from the pool if there is one
+//   void submitMessage(MsgPtrT msg);         // publishes, or compresses and publishes
+//   void setHeader(MsgT & msg, uint64_t seq, uint64_t stamp);  // stamp in nsec
+//
+// and, to fill messages in middleware-owned memory, optionally:
+//
+//   MsgT * borrowMessage();  // nullptr if no message can be borrowed
+//   void publishBorrowedMessage();
+//   void releaseBorrowedMessage();
+//
+// The hooks are resolved at compile time, so the wrapper's virtual
+// call is the only indirection on the path of a packet.
+//
+template <class Derived, class MsgT, class MsgPtrT>
+class MessageAggregator : public CallbackHandler
+{
+public:
+  // ---------------- inherited from CallbackHandler -----------
+  void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) final
+  {
+    if (shmRing_) {
+      shmRing_->write(t, start, end - start);
+    }
+    if (!derived().hasSubscribers()) {
+      if (subscribed_) {
+        // only when the last subscriber leaves, the idle path must stay cheap
+        subscribed_ = false;
+        dropMessage();
+        // sensor time may wrap unnoticed while nobody listens
+        resetSensorTime();
+      }
+      return;
+    }
+    subscribed_ = true;
+    if (cutOnSensorTime_) {
+      rawDataCallbackSensorTime(t, start, end);
+      return;
+    }
+    const uint64_t tSensor = scanner_.hasValidTime() ? scanner_.getTime() : 0;
+    if (stampOnSensorTime_) {
+      scanner_.scan(start, end - start);
+    }
+    MsgT & msg = currentMessage(t, tSensor);
+    appendToMessage(msg, start, end - start);
+    const size_t numBytes = msg.events.size();
+    if (t - lastMessageTime_ > messageThresholdTime_ || numBytes > messageThresholdSize_) {
+      sendMessage(t, numBytes);
+    }
+  }
+
+  uint8_t * getWritableBuffer(uint64_t t, size_t n) final
+  {
+    if (!derived().hasSubscribers()) {
+      msg_.reset();
+      return (nullptr);
+    }
+    if (!msg_) {
+      {
+        std::unique_lock<std::mutex> lock(directMutex_);
+        msg_ = std::move(spareMsg_);
+      }
+      if (!msg_) {  // processing thread has not provided a spare yet
+        msg_ = derived().newMessage(reserveSize_);
+      }
+      initializeMessage(*msg_, t);
+      msg_->time_base = 0;  // not used here
+      messageStartTime_ = t;
+    }
+    auto & events = msg_->events;
+    const size_t oldSize = events.size();
+    resize_hack(events, oldSize + n);
+    return (events.data() + oldSize);
+  }
+
+  bool commitBuffer(uint64_t t) final
+  {
+    const size_t n = msg_->events.size();
+    if (t - lastMessageTime_ > messageThresholdTime_ || n > messageThresholdSize_) {
+      std::unique_lock<std::mutex> lock(directMutex_);
+      // if the previous message has not been published yet, keep filling
+      // the current one rather than waiting for the processing thread
+      if (!readyMsg_) {
+        if (batching_) {
+          updateBatching(t, n, 0, batchingBacklog_);
+          batchingBacklog_ = false;
+        }
+        reserveSize_ = std::max(reserveSize_, n);
+        readyMsg_ = std::move(msg_);
+        readyMsgStartTime_ = messageStartTime_;
+        readyMsgCloseTime_ =
+          wrapper_->latencyStatisticsEnabled() ? MetavisionWrapper::getTimeNs() : 0;
+        lastMessageTime_ = t;
+        return (true);
+      }
+      batchingBacklog_ = true;
+    }
+    return (false);
+  }
+
+  void publishReadyBuffers() final
+  {
+    MsgPtrT msg;
+    size_t reserveSize;
+    bool needSpare;
+    uint64_t tFirst, tClose;
+    {
+      std::unique_lock<std::mutex> lock(directMutex_);
+      msg = std::move(readyMsg_);
+      reserveSize = reserveSize_;
+      needSpare = !spareMsg_;
+      tFirst = readyMsgStartTime_;
+      tClose = readyMsgCloseTime_;
+    }
+    if (msg) {
+      const size_t numBytes = msg->events.size();
+      derived().submitMessage(std::move(msg));
+      if (wrapper_->latencyStatisticsEnabled()) {
+        wrapper_->recordMessageLatency(tFirst, tClose, MetavisionWrapper::getTimeNs());
+      }
+      wrapper_->updateBytesSent(numBytes);
+      wrapper_->updateMsgsSent(1);
+    }
+    if (needSpare) {
+      // allocate the next message here rather than on the SDK thread
+      MsgPtrT spare = derived().newMessage(reserveSize);
+      std::unique_lock<std::mutex> lock(directMutex_);
+      spareMsg_ = std::move(spare);
+    }
+  }
+
+  void resetStream() final
+  {
+    // the sensor time starts over
+    resetSensorTime();
+  }
+  // ---------------- end of inherited  -----------
+
+protected:
+  MessageAggregator() {}
+
+  // default hooks for drivers that cannot borrow messages
+  MsgT * borrowMessage() { return (nullptr); }
+  void publishBorrowedMessage() {}
+  void releaseBorrowedMessage() {}
+
+  void updateMessagePoolStatistics()
+  {
+    if (messagePool_) {
+      size_t inUse, numFree;
+      messagePool_->getOccupancy(&inUse, &numFree);
+      wrapper_->updateMessagePool(inUse, numFree);
+    }
+  }
+
+  // ------------------------  variables ------------------------------
+  std::shared_ptr<MetavisionWrapper> wrapper_;
+  int width_{0};   // image width
+  int height_{0};  // image height
+  std::string frameId_;
+  std::string encoding_;
+  uint64_t seq_{0};        // sequence number
+  size_t reserveSize_{0};  // recommended reserve size
+  uint64_t lastMessageTime_{0};
+  uint64_t messageStartTime_{0};  // arrival time of first packet in message
+  uint64_t messageThresholdTime_{0};  // threshold time for sending message
+  size_t messageThresholdSize_{0};    // threshold size for sending message
+  std::unique_ptr<BatchingController> batching_;  // adapts the thresholds if set
+  std::atomic<bool> resetBatching_{false};        // set when the mipi frame period changes
+  bool batchingBacklog_{false};  // ready message was still pending at a cut
+  bool cutOnSensorTime_{false};  // cut messages on sensor time boundaries
+  EVT3Scanner scanner_;
+  uint64_t nextCutTime_{0};  // sensor time (usec) of next message cut
+  bool stampOnSensorTime_{false};  // derive header stamp from sensor time
+  std::unique_ptr<ROSTimeKeeper> timeKeeper_;
+  std::unique_ptr<ShmRingWriter> shmRing_;  // local consumers that bypass the ROS transport
+  std::shared_ptr<MessagePool<MsgT>> messagePool_;
+
+private:
+  inline Derived & derived() { return (static_cast<Derived &>(*this)); }
+
+  void initializeMessage(MsgT & msg, uint64_t stamp)
+  {
+    msg.header.frame_id = frameId_;
+    msg.encoding = encoding_;
+    msg.seq = seq_++;
+    msg.width = width_;
+    msg.height = height_;
+    derived().setHeader(msg, msg.seq, stamp);
+  }
+
+  MsgT & startMessage(uint64_t t, uint64_t tSensor)
+  {
+    current_ = derived().borrowMessage();
+    borrowed_ = (current_ != nullptr);
+    if (!borrowed_) {
+      msg_ = derived().newMessage(reserveSize_);
+      current_ = msg_.get();
+    }
+    const uint64_t stamp = (stampOnSensorTime_ && tSensor != 0) ? sensorToROSTime(tSensor, t) : t;
+    initializeMessage(*current_, stamp);
+    current_->time_base = tSensor * 1000;  // sensor time in nsec, or 0 if unknown
+    current_->events.reserve(reserveSize_);
+    messageStartTime_ = t;
+    return (*current_);
+  }
+
+  inline MsgT & currentMessage(uint64_t t, uint64_t tSensor)
+  {
+    return (current_ ? *current_ : startMessage(t, tSensor));
+  }
+
+  static inline void appendToMessage(MsgT & msg, const uint8_t * start, size_t n)
+  {
+    auto & events = msg.events;
+    const size_t oldSize = events.size();
+    resize_hack(events, oldSize + n);
+    memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
+  }
+
+  void publishMessage()
+  {
+    if (borrowed_) {
+      derived().publishBorrowedMessage();
+    } else {
+      derived().submitMessage(std::move(msg_));
+    }
+    current_ = nullptr;
+    borrowed_ = false;
+  }
+
+  void dropMessage()
+  {
+    if (borrowed_) {
+      derived().releaseBorrowedMessage();  // returns the loan
+    }
+    msg_.reset();
+    current_ = nullptr;
+    borrowed_ = false;
+  }
+
+  void sendMessage(uint64_t t, size_t numBytes)
+  {
+    reserveSize_ = std::max(reserveSize_, numBytes);
+    const bool measureLatency = wrapper_->latencyStatisticsEnabled();
+    const bool needTime = measureLatency || batching_;
+    const uint64_t tClose = needTime ? MetavisionWrapper::getTimeNs() : 0;
+    publishMessage();
+    const uint64_t tPub = needTime ? MetavisionWrapper::getTimeNs() : 0;
+    if (measureLatency) {
+      wrapper_->recordMessageLatency(messageStartTime_, tClose, tPub);
+    }
+    if (batching_) {
+      updateBatching(t, numBytes, tPub - tClose, false);
+    }
+    lastMessageTime_ = t;
+    wrapper_->updateBytesSent(numBytes);
+    wrapper_->updateMsgsSent(1);
+  }
+
+  void updateBatching(uint64_t t, size_t numBytes, uint64_t publishTime, bool backlog)
+  {
+    if (resetBatching_.load(std::memory_order_relaxed) && resetBatching_.exchange(false)) {
+      batching_->reset();
+    }
+    if (lastMessageTime_ != 0) {
+      batching_->update(t - lastMessageTime_, numBytes, publishTime, backlog);
+      messageThresholdSize_ = batching_->getSizeThreshold();
+    }
+  }
+
+  void rawDataCallbackSensorTime(uint64_t t, const uint8_t * start, const uint8_t * end)
+  {
+    // Cut messages where the sensor time crosses a multiple of the
+    // time threshold. The cut is made in front of the time word so
+    // the byte stream across messages is unchanged.
+    const uint64_t dt = std::max(messageThresholdTime_ / 1000, uint64_t(1));  // usec
+    const uint8_t * p = start;
+    while (p < end) {
+      const size_t n = end - p;
+      const uint64_t tSensor = scanner_.hasValidTime() ? scanner_.getTime() : 0;
+      size_t k = n;
+      if (nextCutTime_ != 0) {
+        k = scanner_.scanUntil(p, n, nextCutTime_);
+      } else {
+        scanner_.scan(p, n);
+      }
+      if (k != 0) {
+        appendToMessage(currentMessage(t, tSensor), p, k);
+      }
+      p += k;
+      const bool timeReached = k < n;
+      if (scanner_.hasValidTime() && (timeReached || nextCutTime_ == 0)) {
+        nextCutTime_ = (scanner_.getTime() / dt + 1) * dt;
+      }
+      if (current_) {
+        const size_t numBytes = current_->events.size();
+        if (timeReached || numBytes > messageThresholdSize_) {
+          sendMessage(t, numBytes);
+        }
+      }
+    }
+  }
+
+  uint64_t sensorToROSTime(uint64_t tSensor, uint64_t t)
+  {
+    // compensates clock skew and buffering delay between sensor and host
+    const double dtSensor = static_cast<double>(tSensor * 1000);
+    const uint64_t stamp = timeKeeper_->updateROSTimeOffset(dtSensor, t) + tSensor * 1000;
+    timeKeeper_->setLastROSTime(stamp);
+    return (stamp);
+  }
+
+  void resetSensorTime()
+  {
+    scanner_.reset();
+    nextCutTime_ = 0;
+    timeKeeper_->reset();
+  }
+
+  // ------------------------  variables ------------------------------
+  bool subscribed_{false};   // had subscribers at the previous packet
+  MsgPtrT msg_;              // message being filled, unless it is borrowed
+  MsgT * current_{nullptr};  // message being filled, or nullptr if none
+  bool borrowed_{false};     // current message is in middleware-owned memory
+  // ------ related to direct aggregation
+  MsgPtrT spareMsg_;  // preallocated message to be filled next
+  MsgPtrT readyMsg_;  // completed message waiting to be published
+  std::mutex directMutex_;
+  uint64_t readyMsgStartTime_{0};
+  uint64_t readyMsgCloseTime_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__MESSAGE_AGGREGATOR_H_
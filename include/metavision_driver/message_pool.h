@@ -0,0 +1,106 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__MESSAGE_POOL_H_
+#define METAVISION_DRIVER__MESSAGE_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/memory_utils.h"
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+//
+// Keeps event packet messages (and with them the memory of their
+// event buffers) around for reuse once the last subscriber has
+// released them. Messages may be returned from any thread.
+//
+template <class MsgT>
+class MessagePool
+{
+public:
+  explicit MessagePool(size_t maxFree) : maxFree_(maxFree) { free_.reserve(maxFree); }
+
+  // hands out a recycled message if available, or a new one.
+  // The event buffer is empty, but has at least reserveSize capacity.
+  std::unique_ptr<MsgT> get(size_t reserveSize)
+  {
+    std::unique_ptr<MsgT> msg;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      numInUse_++;
+      if (!free_.empty()) {
+        msg = std::move(free_.back());
+        free_.pop_back();
+      }
+    }
+    if (!msg) {
+      msg.reset(new MsgT());
+    }
+    msg->events.clear();  // keeps capacity
+    msg->events.reserve(reserveSize);
+    return (msg);
+  }
+
+  // Fills the pool with messages whose event buffers have reserveSize
+  // capacity and are set up according to the memory configuration, such
+  // that the data path takes no page faults on them. Sets the error
+  // message if the memory could not be set up as configured.
+  void prefill(size_t reserveSize, const MemoryConfig & config, std::string * error)
+  {
+    error->clear();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (free_.size() < maxFree_) {
+      std::unique_ptr<MsgT> msg(new MsgT());
+      resize_hack(msg->events, reserveSize);
+      std::string e;
+      if (!prepareMemory(msg->events.data(), reserveSize, config, &e) && error->empty()) {
+        *error = e;
+      }
+      msg->events.clear();  // keeps capacity
+      free_.push_back(std::move(msg));
+    }
+  }
+
+  // returns a message to the pool. Frees it if the pool is full.
+  void put(std::unique_ptr<MsgT> msg)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    numInUse_--;
+    if (free_.size() < maxFree_) {
+      free_.push_back(std::move(msg));
+    }
+  }
+
+  void getOccupancy(size_t * numInUse, size_t * numFree)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    *numInUse = numInUse_;
+    *numFree = free_.size();
+  }
+
+private:
+  // ------------ variables
+  std::mutex mutex_;
+  size_t maxFree_{0};
+  size_t numInUse_{0};
+  std::vector<std::unique_ptr<MsgT>> free_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__MESSAGE_POOL_H_
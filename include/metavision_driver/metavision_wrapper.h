@@ -18,6 +18,7 @@
 
 #include <metavision/sdk/driver/camera.h>
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
@@ -28,7 +29,19 @@
 #include <thread>
 #include <utility>
 
+#include "metavision_driver/activity_monitor.h"
+#include "metavision_driver/buffer_pool.h"
 #include "metavision_driver/callback_handler.h"
+#include "metavision_driver/evt3_filter.h"
+#include "metavision_driver/evt3_trigger_scanner.h"
+#include "metavision_driver/file_player.h"
+#include "metavision_driver/latency_histogram.h"
+#include "metavision_driver/memory_utils.h"
+#include "metavision_driver/raw_recorder.h"
+#include "metavision_driver/statistics.h"
+#include "metavision_driver/spsc_ring.h"
+#include "metavision_driver/thread_utils.h"
+#include "metavision_driver/worker_pool.h"
 
 namespace ph = std::placeholders;
 
@@ -44,11 +57,15 @@ public:
   struct QueueElement
   {
     QueueElement() {}
-    QueueElement(const void * s, size_t n, uint64_t t) : start(s), numBytes(n), timeStamp(t) {}
+    QueueElement(const BufferPool::Handle & b, size_t n, uint64_t t, bool r = false)
+    : buffer(b), numBytes(n), timeStamp(t), restarted(r)
+    {
+    }
     // ----- variables
-    const void * start{0};
+    BufferPool::Handle buffer;
     size_t numBytes{0};
     uint64_t timeStamp{0};
+    bool restarted{false};  // first packet after the stream was restarted
   };
 
   struct Stats
@@ -58,6 +75,36 @@ public:
     size_t bytesSent{0};
     size_t bytesRecv{0};
     size_t maxQueueSize{0};
+    size_t msgsDropped{0};
+    size_t bytesDropped{0};
+    size_t overloads{0};
+    size_t msgPoolInUse{0};
+    size_t msgPoolFree{0};
+  };
+
+  // The counters are only ever incremented on the data path. The statistics
+  // thread computes rates from the difference between snapshots, so no
+  // lock is needed, and each side only writes to its own cache lines.
+  // Padded like the SPSCRing, since the wrapper lives on the heap.
+  struct Counters
+  {
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t GROUP_SIZE = 5 * sizeof(std::atomic<size_t>);
+    char pad0_[CACHE_LINE_SIZE];
+    // written by the SDK thread
+    std::atomic<size_t> msgsRecv{0};
+    std::atomic<size_t> bytesRecv{0};
+    std::atomic<size_t> msgsDropped{0};
+    std::atomic<size_t> bytesDropped{0};
+    std::atomic<size_t> overloads{0};  // packets that found the queue over budget
+    char pad1_[CACHE_LINE_SIZE - GROUP_SIZE];
+    // written by the thread that publishes
+    std::atomic<size_t> msgsSent{0};
+    std::atomic<size_t> bytesSent{0};
+    std::atomic<size_t> maxQueueSize{0};  // reset by statistics thread
+    std::atomic<size_t> msgPoolInUse{0};
+    std::atomic<size_t> msgPoolFree{0};
+    char pad2_[CACHE_LINE_SIZE - GROUP_SIZE];
   };
 
   typedef std::map<std::string, std::map<std::string, int>> HardwarePinConfig;
@@ -65,22 +112,43 @@ public:
   explicit MetavisionWrapper(const std::string & loggerName);
   ~MetavisionWrapper();
 
+  // The bias getters are served from a table that is only read from
+  // the camera again after biases have been written.
   int getBias(const std::string & name);
   bool hasBias(const std::string & name);
+  std::map<std::string, int> getBiases();
   int setBias(const std::string & name, int val);
+  // Applies a set of biases in one pass, with a single read back.
+  // Returns the values that actually took hold.
+  std::map<std::string, int> setBiases(const std::map<std::string, int> & values);
   bool initialize(bool useMultithreading, const std::string & biasFile, bool saveRawFile = false);
   bool saveBiases();
-  inline void updateMsgsSent(int inc)
+  inline void updateMsgsSent(int inc) { increment(&counters_.msgsSent, inc); }
+  inline void updateBytesSent(int inc) { increment(&counters_.bytesSent, inc); }
+  inline void updateMessagePool(size_t inUse, size_t free)
+  {
+    counters_.msgPoolInUse.store(inUse, std::memory_order_relaxed);
+    counters_.msgPoolFree.store(free, std::memory_order_relaxed);
+  }
+  inline bool latencyStatisticsEnabled() const { return (latencyStatistics_); }
+  inline void recordLatency(LatencyStage stage, uint64_t dt) { latency_[stage].record(dt); }
+  // tFirst: arrival of first packet, tClose: message close-out, tPub: publish() returned
+  inline void recordMessageLatency(uint64_t tFirst, uint64_t tClose, uint64_t tPub)
   {
-    std::unique_lock<std::mutex> lock(statsMutex_);
-    stats_.msgsSent += inc;
+    latency_[MESSAGE_LATENCY].record(tClose - tFirst);
+    latency_[PUBLISH_LATENCY].record(tPub - tClose);
+    latency_[TOTAL_LATENCY].record(tPub - tFirst);
   }
-  inline void updateBytesSent(int inc)
+  static inline uint64_t getTimeNs()
   {
-    std::unique_lock<std::mutex> lock(statsMutex_);
-    stats_.bytesSent += inc;
+    return (std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::system_clock::now().time_since_epoch())
+              .count());
   }
   bool stop();
+  // Stops and starts streaming again, keeping the opened device, its
+  // configuration and all registered callbacks.
+  bool restartStreaming();
   int getWidth() const { return (width_); }
   int getHeight() const { return (height_); }
   const std::string & getSerialNumber() const { return (serialNumber_); }
@@ -97,11 +165,71 @@ public:
   bool startCamera(CallbackHandler * h);
   void setLoggerName(const std::string & s) { loggerName_ = s; }
   void setStatisticsInterval(double sec) { statsInterval_ = sec; }
+  void setLatencyStatistics(bool enabled) { latencyStatistics_ = enabled; }
+  void setLogStatistics(bool enabled) { logStatistics_ = enabled; }
+  // in multithreaded mode, let the SDK thread write directly into the message
+  void setDirectAggregation(bool d) { useDirectAggregation_ = d; }
+  // recorderType is "sdk" (SDK writes the file) or "driver" (RawRecorder)
+  void setRecorder(const std::string & recorderType, const std::string & directory)
+  {
+    recorderType_ = recorderType;
+    recordingDirectory_ = directory;
+  }
+  void setRecorderRotation(size_t maxBytes, double maxSeconds)
+  {
+    recordingRotateBytes_ = maxBytes;
+    recordingRotateTime_ = maxSeconds;
+  }
+  // playback rate 0 means as fast as possible
+  void setPlayback(double rate, bool useMmap, size_t packetSize)
+  {
+    playbackRate_ = rate;
+    useMmapPlayback_ = useMmap;
+    playbackPacketSize_ = packetSize;
+  }
+  void setRecorderIndexInterval(uint64_t usec) { recordingIndexInterval_ = usec; }
+  void setRecorderBuffers(size_t bufferSize, size_t numBuffers, bool useDirectIO)
+  {
+    recordingBufferSize_ = bufferSize;
+    recordingNumBuffers_ = numBuffers;
+    recordingDirectIO_ = useDirectIO;
+  }
+  // "deque" (mutex protected) or "ring" (lock free), with ring capacity
+  void setQueueType(const std::string & type, size_t ringSize)
+  {
+    queueType_ = type;
+    ringSize_ = ringSize;
+  }
+  // number of preallocated queue blocks (0 = no pool) and their size (0 = auto)
+  void setQueuePool(size_t numBlocks, size_t blockSize)
+  {
+    poolNumBlocks_ = numBlocks;
+    poolBlockSize_ = blockSize;
+  }
+  // huge pages, pre-faulting and locking of the queue pool
+  void setMemoryConfig(const MemoryConfig & c) { memoryConfig_ = c; }
+  // Bounds the bytes held by the queue in multithreaded mode (0 = no bound).
+  // What happens to a packet that does not fit is decided by the policy:
+  // "drop_newest", "drop_oldest" (deque only), or "erc" (drop newest and
+  // lower the sensor's event rate controller until the queue keeps up).
+  void setOverloadPolicy(const std::string & policy, size_t queueByteBudget)
+  {
+    overloadPolicy_ = policy;
+    queueByteBudget_ = queueByteBudget;
+  }
 
   // ROI is a double vector with length multiple of 4:
   // (x_top_1, y_top_1, width_1, height_1,
   //  x_top_2, y_top_2, width_2, height_2, .....)
   void setROI(const std::vector<int> & roi) { roi_ = roi; }
+  // Removes the events outside of the ROIs (same layout as for setROI)
+  // and those of the pixels listed in the mask file from the raw data,
+  // in software. Either one may be empty.
+  void setSoftwareFilter(const std::vector<int> & roi, const std::string & pixelMaskFile)
+  {
+    filterROI_ = roi;
+    pixelMaskFile_ = pixelMaskFile;
+  }
   void setExternalTriggerInMode(const std::string & mode) { triggerInMode_ = mode; }
   void setExternalTriggerOutMode(
     const std::string & mode, const int period, const double duty_cycle);
@@ -112,6 +240,14 @@ public:
     ercRate_ = rate;
   }
   void setMIPIFramePeriod(int usec) { mipiFramePeriod_ = usec; }
+  // ------ reconfiguration while the camera streams. These return
+  // false if the setting could not be applied to the camera.
+  // An empty ROI vector turns the ROI off.
+  bool updateROI(const std::vector<int> & roi);
+  bool updateEventRateController(const std::string & mode, int rate);
+  // returns the frame period read back from the sensor, or -1 on error
+  int updateMIPIFramePeriod(int usec);
+  std::vector<int> getROI();
 
   bool triggerActive() const
   {
@@ -119,28 +255,128 @@ public:
   }
   bool triggerInActive() const { return (triggerInMode_ != "disabled"); }
   void setDecodingEvents(bool decodeEvents);
+  // hands the external triggers in the raw data to the callback handler
+  void setExtractTriggers(bool e) { extractTriggers_ = e; }
+  // feeds the raw data (after the software filter) to the activity monitor
+  void setActivityMonitor(const std::shared_ptr<ActivityMonitor> & m) { activityMonitor_ = m; }
+  // Serve processing and statistics from a (shared) worker pool
+  // instead of starting a processing and a statistics thread.
+  void setWorkerPool(const std::shared_ptr<WorkerPool> & pool) { workerPool_ = pool; }
+  // called by the worker pool: returns true if any packets were processed
+  bool processPending();
+  // called by the worker pool: computes, logs and hands out statistics
+  void statisticsStep();
+  double getStatisticsInterval() const { return (statsInterval_); }
+  // CPU affinity and scheduling of the driver threads: "sdk" (thread
+  // delivering the raw data), "processing", "statistics", "recorder".
+  // Must be set before the camera is started.
+  void setThreadConfig(const std::string & thread, const ThreadConfig & c)
+  {
+    threadConfig_[thread] = c;
+  }
 
 private:
   bool initializeCamera();
+  // cached biases, must be called with biasMutex_ held
+  const std::map<std::string, int> & biasTable();
   void runtimeErrorCallback(const Metavision::CameraException & e);
   void statusChangeCallback(const Metavision::CameraStatus & s);
 
   void rawDataCallback(const uint8_t * data, size_t size);
   void rawDataCallbackMultithreaded(const uint8_t * data, size_t size);
+  void rawDataCallbackDirect(const uint8_t * data, size_t size);
+  // returns false if the packet must be dropped because the secondary
+  // has no sync clock yet, otherwise trims data to the first good time word
+  bool skipUntilSynced(const uint8_t ** data, size_t * size);
+  // called by the SDK thread when the queue is over budget. Returns
+  // true if room was made for a packet of the given size.
+  bool makeRoomInQueue(size_t size);
+  // called by the statistics thread: lowers or restores the ERC rate
+  void updateErcThrottle(Statistics * stats);
+  // called by the statistics thread: page faults since the last call
+  void updatePageFaults(Statistics * stats);
+  // allocates the queue pool, according to the memory configuration
+  void initializeQueuePool(size_t blockSize);
+  // applies the named thread configuration (if any) to a thread
+  void configureThread(const std::string & name, pthread_t thread);
+  inline void configureSdkThread()
+  {
+    // the SDK creates its thread internally, so catch it on its first callback
+    if (!sdkThreadConfigured_) {
+      configureThread("sdk", pthread_self());
+      sdkThreadId_.store(getThreadId(), std::memory_order_relaxed);  // for its page faults
+      sdkThreadConfigured_ = true;
+    }
+  }
+  // called by the SDK thread with each packet: true if the stream was restarted
+  inline bool takeRestart()
+  {
+    return (
+      restartPending_.load(std::memory_order_relaxed) && restartPending_.exchange(false));
+  }
+  // drops the decoder state of everything downstream, in the data context
+  void resetStreamState();
+  // called by the SDK thread with each packet
+  inline void extractTriggers(const uint8_t * data, size_t size, uint64_t t)
+  {
+    if (extractTriggers_) {
+      triggers_.clear();
+      triggerScanner_.scan(data, size, &triggers_);
+      if (!triggers_.empty()) {
+        callbackHandler_->triggerCallback(t, triggers_.data(), triggers_.data() + triggers_.size());
+      }
+    }
+  }
+  inline void monitorActivity(const uint8_t * data, size_t size)
+  {
+    if (activityMonitor_ && activityMonitor_->isEnabled()) {
+      activityMonitor_->process(data, size);
+    }
+  }
   void cdCallback(const Metavision::EventCD * start, const Metavision::EventCD * end);
   void extTriggerCallback(
     const Metavision::EventExtTrigger * start, const Metavision::EventExtTrigger * end);
 
   void processingThread();
+  void processingThreadRing();
+  void processingThreadDirect();
+  void processQueueElement(const QueueElement & qe, size_t queueSize);
   void statsThread();
-  void applyROI(const std::vector<int> & roi);
+  bool applyROI(const std::vector<int> & roi);
+  void initializeFilter();
   void applySyncMode(const std::string & mode);
   void configureExternalTriggers(
     const std::string & mode_in, const std::string & mode_out, const int period,
     const double duty_cycle);
-  void configureEventRateController(const std::string & mode, const int rate);
-  void configureMIPIFramePeriod(int usec, const std::string & sensorName);
-  void printStatistics();
+  bool configureEventRateController(const std::string & mode, const int rate);
+  int configureMIPIFramePeriod(int usec, const std::string & sensorName);
+  using RawCallback = void (MetavisionWrapper::*)(const uint8_t *, size_t);
+  RawCallback getRawDataCallback() const;
+  bool initializeFilePlayer();
+  void createRecordingPath();
+  bool startRecorder();
+  Statistics computeStatistics();
+  void printStatistics(const Statistics & stats);
+  Stats getCounterIncrements();
+  inline void notifyConsumer()
+  {
+    if (worker_) {
+      worker_->notify();
+    } else {
+      cv_.notify_all();
+    }
+  }
+  static inline void increment(std::atomic<size_t> * c, size_t inc)
+  {
+    c->fetch_add(inc, std::memory_order_relaxed);
+  }
+  static inline void updateMax(std::atomic<size_t> * c, size_t v)
+  {
+    // a plain store could overwrite the reset by the statistics thread
+    size_t old = c->load(std::memory_order_relaxed);
+    while (v > old && !c->compare_exchange_weak(old, v, std::memory_order_relaxed)) {
+    }
+  }
   // ------------ variables
   CallbackHandler * callbackHandler_{0};
   Metavision::Camera cam_;
@@ -157,40 +393,98 @@ private:
   int width_{0};   // image width
   int height_{0};  // image height
   std::string biasFile_;
+  std::mutex biasMutex_;  // biases are read and written from ROS callbacks
+  std::map<std::string, int> biasCache_;
+  bool biasCacheValid_{false};
   std::string serialNumber_;
   std::string fromFile_;
   std::string softwareInfo_;
   std::string syncMode_;
+  bool waitingForSync_{false};  // only accessed from the SDK callback thread
   std::string triggerInMode_;   // disabled, enabled, loopback
   std::string triggerOutMode_;  // disabled, enabled
   int triggerOutPeriod_;        // period (in microseconds) of trigger out
   double triggerOutDutyCycle_;  // duty cycle (fractional) of trigger out
   HardwarePinConfig hardwarePinConfig_;
+  // guards the settings below that can be changed while streaming
+  std::mutex configMutex_;
   std::string ercMode_;
   int ercRate_;
   int mipiFramePeriod_{-1};
+  std::string sensorName_;
   std::string loggerName_{"driver"};
   std::vector<int> roi_;
+  std::vector<int> filterROI_;
+  std::string pixelMaskFile_;
+  std::unique_ptr<EVT3Filter> filter_;
+  std::vector<uint8_t> filterBuffer_;  // filter output when not filtering in place
+  std::shared_ptr<ActivityMonitor> activityMonitor_;
+  bool extractTriggers_{false};
+  // only accessed from the SDK callback thread
+  EVT3TriggerScanner triggerScanner_;
+  std::vector<EVT3TriggerScanner::Trigger> triggers_;
   std::string encodingFormat_{"unknown"};
   std::string sensorVersion_{"0.0"};
   // --  related to statistics
   double statsInterval_{2.0};  // time between printouts
   std::chrono::time_point<std::chrono::system_clock> lastPrintTime_;
-  Stats stats_;
-  std::mutex statsMutex_;
+  Counters counters_;
+  Stats lastStats_;  // snapshot of counters at last printout
+  PageFaults lastFaults_;     // of the process at last printout
+  PageFaults lastSdkFaults_;  // of the SDK thread at last printout
+  pid_t lastSdkThreadId_{0};
+  std::atomic<pid_t> sdkThreadId_{0};
+  bool latencyStatistics_{false};
+  bool logStatistics_{true};
+  LatencyHistogram latency_[NUM_LATENCY_STAGES];
   std::shared_ptr<std::thread> statsThread_;
 
   // -----------
   // related to multi threading
   bool useMultithreading_{false};
+  bool useDirectAggregation_{false};
+  bool messageReady_{false};  // direct aggregation: message waiting to be published
   std::mutex mutex_;
   std::condition_variable cv_;
   std::deque<QueueElement> queue_;
+  std::string queueType_{"deque"};
+  size_t ringSize_{1024};
+  std::unique_ptr<SPSCRing<QueueElement>> ring_;
+  std::atomic<bool> consumerParked_{false};
+  BufferPool pool_;
+  size_t poolNumBlocks_{0};
+  size_t poolBlockSize_{0};
+  MemoryConfig memoryConfig_;
+  std::string overloadPolicy_{"drop_newest"};
+  size_t queueByteBudget_{0};
+  std::atomic<size_t> queueBytes_{0};  // bytes waiting in the queue
+  int ercThrottledRate_{0};    // ERC rate set by overload policy, 0 = not throttled
+  int ercThrottleCeiling_{0};  // rate at which throttling ends
   std::shared_ptr<std::thread> processingThread_;
+  std::shared_ptr<WorkerPool> workerPool_;
+  WorkerPool::Worker * worker_{nullptr};  // worker serving this camera
   bool keepRunning_{true};
+  std::map<std::string, ThreadConfig> threadConfig_;
+  bool sdkThreadConfigured_{false};  // only accessed from the SDK callback thread
+  std::mutex restartMutex_;
+  std::atomic<bool> restartPending_{false};
 
   bool saveRawFile_;
   std::string recordingPath_;
+  std::string recorderType_{"sdk"};
+  std::string recordingDirectory_{"/tmp/recordings"};
+  size_t recordingRotateBytes_{0};
+  double recordingRotateTime_{0};
+  size_t recordingBufferSize_{4 * 1024 * 1024};
+  size_t recordingNumBuffers_{16};
+  bool recordingDirectIO_{true};
+  uint64_t recordingIndexInterval_{0};  // usec
+  std::unique_ptr<RawRecorder> recorder_;
+  // ------ related to playback from file
+  double playbackRate_{1.0};
+  bool useMmapPlayback_{false};
+  size_t playbackPacketSize_{64 * 1024};
+  std::unique_ptr<FilePlayer> player_;
 };
 }  // namespace metavision_driver
 #endif  // METAVISION_DRIVER__METAVISION_WRAPPER_H_
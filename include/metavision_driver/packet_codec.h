@@ -0,0 +1,74 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__PACKET_CODEC_H_
+#define METAVISION_DRIVER__PACKET_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Compresses the EVT3 payload of an event packet message, and expands
+// it again on the receiving end. The compressed payload starts with
+// the uncompressed size (8 bytes, little endian), followed by a single
+// LZ4 block or zstd frame. The message encoding tells which one:
+// "evt3_lz4" or "evt3_zstd". A codec object is not thread safe, use
+// one per thread.
+//
+class PacketCodec
+{
+public:
+  enum Type { NONE, LZ4, ZSTD };
+  static constexpr size_t HEADER_SIZE = 8;
+
+  // Parses "evt3", "evt3_lz4", or "evt3_zstd", optionally followed by
+  // ":<level>" (zstd level, or lz4 acceleration). Returns false for
+  // unknown names and for codecs this build does not support.
+  static bool parse(const std::string & spec, Type * type, int * level, std::string * error);
+  // type from the message encoding, NONE for uncompressed or unknown
+  static Type fromEncoding(const std::string & encoding);
+  // message encoding for the type
+  static const char * getEncoding(Type type);
+  static bool isAvailable(Type type);
+
+  explicit PacketCodec(Type type, int level = 0);
+  ~PacketCodec();
+  PacketCodec(const PacketCodec &) = delete;
+  PacketCodec & operator=(const PacketCodec &) = delete;
+
+  Type getType() const { return (type_); }
+  // compresses n bytes into out (resized to fit)
+  bool compress(const uint8_t * in, size_t n, std::vector<uint8_t> * out);
+  // expands a compressed payload into out (resized to fit)
+  bool decompress(const uint8_t * in, size_t n, std::vector<uint8_t> * out);
+
+private:
+  Type type_{NONE};
+  int level_{0};
+  void * compressContext_{nullptr};    // ZSTD_CCtx
+  void * decompressContext_{nullptr};  // ZSTD_DCtx
+};
+
+// Decompression hook for consumers of the message stream, for messages
+// whose encoding is a compressed one (fromEncoding() != NONE). Returns
+// false if the encoding is not supported or the payload is broken.
+bool decompressPayload(
+  const std::string & encoding, const uint8_t * in, size_t n, std::vector<uint8_t> * out);
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__PACKET_CODEC_H_
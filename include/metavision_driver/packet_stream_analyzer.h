@@ -0,0 +1,137 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__PACKET_STREAM_ANALYZER_H_
+#define METAVISION_DRIVER__PACKET_STREAM_ANALYZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/evt3_scanner.h"
+#include "metavision_driver/latency_histogram.h"
+
+namespace metavision_driver
+{
+//
+// Checks the timing of a recorded stream of event packet messages,
+// one message at a time, in recording order. The memory does not grow
+// with the length of the recording. Per message, the header stamp, seq
+// and recording time are checked for gaps and discontinuities, and the
+// EVT3 time and event words are scanned (not decoded) for the sensor
+// time and event count. The sensor emits a TIME_HIGH word at least
+// every 4.096ms, so a TIME_HIGH that skips ahead means data was lost
+// between sensor and driver (SDK or USB drop), unless messages are
+// missing from the recording as well. A report line is printed per
+// interval of recording time, and a summary at the end.
+//
+class PacketStreamAnalyzer
+{
+public:
+  struct Config
+  {
+    double interval{1.0};  // seconds of recording time per report line, 0 = none
+    double maxGap{0.1};    // larger header stamp gaps (seconds) are reported
+    bool verbose{true};    // print every gap, seq jump and drop as it is found
+  };
+  struct Message
+  {
+    uint64_t recordTime{0};  // when the recorder received it (nsec)
+    uint64_t stamp{0};       // header stamp (nsec)
+    uint64_t seq{0};
+    uint64_t timeBase{0};  // sensor time of message start (nsec), or 0
+    const std::string * encoding{nullptr};
+    const uint8_t * data{nullptr};
+    size_t size{0};
+  };
+
+  explicit PacketStreamAnalyzer(const Config & config);
+  void process(const Message & msg);
+  // prints the last report line and the summary
+  void finish();
+
+private:
+  struct Interval
+  {
+    size_t numMessages{0};
+    size_t numBytes{0};  // as recorded, i.e. compressed
+    size_t numEvents{0};
+    uint64_t maxGap{0};  // header stamp gap (nsec)
+    int64_t minDrift{0};
+    int64_t maxDrift{0};
+    bool hasDrift{false};
+    size_t numDrops{0};
+    size_t numMissing{0};  // messages
+  };
+  const uint8_t * getPayload(const Message & msg);
+  void checkHeader(const Message & msg);
+  void scanPayload(const uint8_t * data, size_t numBytes, const Message & msg);
+  inline void checkTimeHigh(uint16_t th);
+  void updateDrift(uint64_t stamp, uint64_t sensorTime);
+  void restartSensorTime();
+  void printInterval(double duration);
+  double now() const { return ((lastRecordTime_ - firstRecordTime_) * 1e-9); }
+  // ------------ variables
+  Config config_;
+  std::vector<uint8_t> decompressed_;
+  EVT3Scanner scanner_;
+  // message header state
+  bool hasMessage_{false};
+  uint64_t firstRecordTime_{0};
+  uint64_t lastRecordTime_{0};
+  uint64_t lastStamp_{0};
+  uint64_t lastSeq_{0};
+  bool messagesMissing_{false};  // preceding messages are not in the recording
+  // sensor time state
+  bool hasTimeHigh_{false};
+  uint16_t lastTimeHigh_{0};
+  bool hasDrift_{false};
+  int64_t offset0_{0};  // header stamp - sensor time of first message (nsec)
+  int64_t drift_{0};    // current offset relative to offset0_
+  uint64_t sensor0_{0};  // usec
+  uint64_t stamp0_{0};
+  size_t numFit_{0};  // running line fit of header stamp vs sensor time
+  double meanX_{0}, meanY_{0}, covXY_{0}, varX_{0};
+  // report interval
+  uint64_t intervalStart_{0};
+  Interval interval_;
+  // totals
+  size_t numMessages_{0};
+  size_t numBytes_{0};
+  size_t numPayloadBytes_{0};
+  size_t numEvents_{0};
+  size_t numTriggers_{0};
+  size_t numSeqJumps_{0};
+  size_t numSeqMissing_{0};
+  size_t numSeqBackward_{0};
+  size_t numStampBackward_{0};
+  size_t numLargeGaps_{0};
+  size_t numFutureStamps_{0};  // header stamp later than the recording time
+  size_t numTimeBaseMismatch_{0};
+  size_t numWithoutTime_{0};
+  size_t numDecompressFailed_{0};
+  size_t numDrops_{0};
+  uint64_t droppedTime_{0};  // sensor time lost in drops (usec)
+  size_t numTimeBackward_{0};
+  bool hasAnyDrift_{false};
+  int64_t minDrift_{0};
+  int64_t maxDrift_{0};
+  double maxBandwidth_{0};  // MB/s of report interval
+  LatencyHistogram stampGaps_;
+  LatencyHistogram recordDelay_;  // recording time - header stamp
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__PACKET_STREAM_ANALYZER_H_
@@ -0,0 +1,108 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__RAW_INDEX_H_
+#define METAVISION_DRIVER__RAW_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Sparse time index that is written next to a raw file (<file>.raw.idx).
+// Each entry points to a TIME_HIGH word in the raw file, so decoding can
+// start right there. Layout (little endian): 8 byte magic, uint32 version,
+// uint32 entry size, followed by the entries.
+//
+struct RawIndexEntry
+{
+  uint64_t sensorTime;  // sensor time [usec], 64 bit extended
+  uint64_t hostTime;    // host arrival time of the packet [nsec since epoch]
+  uint64_t offset;      // byte offset of the TIME_HIGH word in the raw file
+};
+
+class RawIndex
+{
+public:
+  static constexpr const char * MAGIC = "EVT3IDX1";
+  static constexpr uint32_t VERSION = 1;
+
+  static bool writeHeader(FILE * f)
+  {
+    const uint32_t hdr[2] = {VERSION, static_cast<uint32_t>(sizeof(RawIndexEntry))};
+    return (fwrite(MAGIC, 8, 1, f) == 1 && fwrite(hdr, sizeof(hdr), 1, f) == 1);
+  }
+
+  static bool writeEntries(FILE * f, const RawIndexEntry * e, size_t n)
+  {
+    return (n == 0 || fwrite(e, sizeof(RawIndexEntry), n, f) == n);
+  }
+
+  // reads the index file, returns false if it is missing or invalid
+  bool read(const std::string & fileName)
+  {
+    entries_.clear();
+    FILE * f = fopen(fileName.c_str(), "rb");
+    if (!f) {
+      return (false);
+    }
+    char magic[8];
+    uint32_t hdr[2];
+    bool ok = fread(magic, 8, 1, f) == 1 && memcmp(magic, MAGIC, 8) == 0 &&
+              fread(hdr, sizeof(hdr), 1, f) == 1 && hdr[0] == VERSION &&
+              hdr[1] == sizeof(RawIndexEntry);
+    RawIndexEntry e;
+    while (ok && fread(&e, sizeof(e), 1, f) == 1) {
+      entries_.push_back(e);
+    }
+    fclose(f);
+    return (ok);
+  }
+
+  // Returns the last entry with sensor time <= t, or the first entry if
+  // t precedes all entries. Returns nullptr for an empty index.
+  const RawIndexEntry * findSensorTime(uint64_t t) const
+  {
+    return (find(t, [](uint64_t v, const RawIndexEntry & e) { return (v < e.sensorTime); }));
+  }
+
+  // same as findSensorTime(), but for host time
+  const RawIndexEntry * findHostTime(uint64_t t) const
+  {
+    return (find(t, [](uint64_t v, const RawIndexEntry & e) { return (v < e.hostTime); }));
+  }
+
+  const std::vector<RawIndexEntry> & getEntries() const { return (entries_); }
+
+private:
+  template <class Compare>
+  const RawIndexEntry * find(uint64_t t, Compare comp) const
+  {
+    if (entries_.empty()) {
+      return (nullptr);
+    }
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), t, comp);
+    return (it == entries_.begin() ? &(*it) : &(*(it - 1)));
+  }
+  // ------------ variables
+  std::vector<RawIndexEntry> entries_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__RAW_INDEX_H_
@@ -0,0 +1,148 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__RAW_RECORDER_H_
+#define METAVISION_DRIVER__RAW_RECORDER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/evt3_scanner.h"
+#include "metavision_driver/raw_index.h"
+
+namespace metavision_driver
+{
+//
+// Writes the raw EVT3 stream to disk from a dedicated I/O thread.
+// The producer (SDK callback thread) only copies into large, page
+// aligned buffers and never blocks: when all buffers are waiting to be
+// written, incoming data is dropped and counted. Full buffers are
+// written with O_DIRECT where the file system supports it. Files are
+// rotated by size and/or time, always in front of an EVT3 TIME_HIGH
+// word so that every file can be decoded on its own. Optionally a
+// sparse time index (see RawIndex) is written next to each file.
+//
+class RawRecorder
+{
+public:
+  struct Statistics
+  {
+    size_t bytesWritten{0};
+    size_t bytesDropped{0};
+    size_t maxPending{0};      // max number of buffers waiting for I/O
+    uint64_t maxWriteTime{0};  // longest write() call [ns]
+    size_t writeErrors{0};
+  };
+
+  RawRecorder() {}
+  ~RawRecorder();
+  RawRecorder(const RawRecorder &) = delete;
+  RawRecorder & operator=(const RawRecorder &) = delete;
+
+  void setBuffers(size_t bufferSize, size_t numBuffers);
+  void setRotation(size_t maxBytes, double maxSeconds);
+  void setDirectIO(bool useDirectIO) { useDirectIO_ = useDirectIO; }
+  // interval [usec] of sensor time between index entries, 0 means no index
+  void setIndexInterval(uint64_t usec) { indexInterval_ = usec; }
+
+  // Starts the I/O thread. Files are named <directory>/<prefix>_<nnnn>.raw,
+  // each one beginning with the text header.
+  bool start(const std::string & directory, const std::string & prefix, const std::string & header);
+  // flushes all data and stops the I/O thread. Must not be called
+  // concurrently with write().
+  void stop();
+
+  // called by the producer thread, t is the host arrival time [nsec]
+  void write(const uint8_t * data, size_t n, uint64_t t);
+
+  void getAndResetStatistics(Statistics * s);
+  const std::string & getFileName() const { return (fileName_); }
+  // handle of the I/O thread, valid between start() and stop()
+  std::thread::native_handle_type getNativeHandle() { return (thread_->native_handle()); }
+
+private:
+  struct Buffer
+  {
+    uint8_t * data{nullptr};
+    size_t size{0};
+    bool newFile{false};     // open a new file before writing this buffer
+    bool lastInFile{false};  // close the file after writing this buffer
+  };
+  // ---- producer side
+  bool nextBuffer(bool newFile);
+  void submit(bool lastInFile);
+  void append(const uint8_t * data, size_t n);
+  void appendIndexed(const uint8_t * data, size_t n, uint64_t t);
+  void drop(const uint8_t * data, size_t n);
+  bool rotationDue() const;
+  // ---- I/O thread side
+  void ioThread();
+  bool openFile();
+  void closeFile();
+  void writeBuffer(const Buffer & b);
+  void writeIndexEntries();
+
+  // ------------ variables
+  size_t bufferSize_{4 * 1024 * 1024};
+  size_t numBuffers_{16};
+  size_t rotateBytes_{0};    // 0 means no rotation by size
+  double rotateSeconds_{0};  // 0 means no rotation by time
+  bool useDirectIO_{true};
+  uint64_t indexInterval_{0};
+  std::string directory_;
+  std::string prefix_;
+  std::string header_;
+  std::vector<uint8_t *> allBuffers_;
+  // ---- protected by mutex_
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<uint8_t *> freeBuffers_;
+  std::deque<Buffer> fullBuffers_;
+  bool keepRunning_{false};
+  Statistics stats_;
+  struct PendingIndexEntry
+  {
+    int fileNumber;
+    RawIndexEntry entry;
+  };
+  std::vector<PendingIndexEntry> indexEntries_;
+  // ---- owned by producer
+  Buffer current_;
+  size_t bytesInFile_{0};
+  std::chrono::steady_clock::time_point fileStartTime_;
+  bool rotatePending_{false};  // close file at next TIME_HIGH
+  bool needNewFile_{false};    // file is closed, start new one at next TIME_HIGH
+  int producerFileNumber_{-1};
+  EVT3Scanner scanner_;
+  uint64_t nextIndexTime_{0};
+  // ---- owned by I/O thread
+  int fd_{-1};
+  bool fdIsDirect_{false};
+  int fileNumber_{-1};
+  FILE * indexFile_{nullptr};
+  std::string fileName_;
+  std::shared_ptr<std::thread> thread_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__RAW_RECORDER_H_
@@ -42,6 +42,16 @@ class ROSTimeKeeper
 public:
   explicit ROSTimeKeeper(const std::string & name) : loggerName_(name) {}
   inline void setLastROSTime(uint64_t t) { lastROSTime_ = t; }
+  // forgets the offset, e.g. when the sensor time starts over
+  inline void reset()
+  {
+    rosT0_ = 0;
+    averageTimeDifference_ = 0;
+    prevSensorTime_ = 0;
+    bufferingDelay_ = 0;
+    lastROSTime_ = 0;
+    prevROSTime_ = 0;
+  }
   inline uint64_t updateROSTimeOffset(double dt_sensor, uint64_t rosT)
   {
     if (rosT0_ == 0) {  // first time here
@@ -0,0 +1,154 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__SHM_RING_H_
+#define METAVISION_DRIVER__SHM_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "metavision_driver/evt3_scanner.h"
+
+namespace metavision_driver
+{
+//
+// Shared memory ring that hands raw EVT3 packets to any number of
+// local consumers without a copy per consumer. The driver is the only
+// writer and never waits for readers. Readers map the ring read-only,
+// look at the data in place, and afterwards check if the writer has
+// lapped them in the meantime (seqlock style).
+//
+// Layout: RingHeader, followed by the data area of `capacity` bytes.
+// The data area holds back-to-back chunks of ChunkHeader + payload,
+// each padded to 8 bytes. A chunk never wraps around the end of the
+// data area, the writer skips the remaining space instead.
+//
+namespace shm
+{
+static constexpr uint32_t MAGIC = 0x33545645;  // "EVT3"
+static constexpr uint32_t VERSION = 2;
+static constexpr uint64_t PADDING = ~uint64_t(0);  // chunk size of a skip marker
+
+struct alignas(64) RingHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;  // size of data area, power of two
+  uint32_t width;
+  uint32_t height;
+  char encoding[16];
+  std::atomic<uint32_t> writerAlive;  // cleared when the writer closes the ring
+  int32_t writerPid;                  // for readers to notice a writer that crashed
+  // positions are byte offsets since start, they never wrap
+  alignas(64) std::atomic<uint64_t> reservePos;  // end of chunk being written
+  std::atomic<uint64_t> writePos;                // end of last complete chunk
+};
+
+struct ChunkHeader
+{
+  uint64_t sequence;    // running number of the chunk
+  uint64_t size;        // payload bytes, or PADDING
+  uint64_t hostTime;    // arrival time of the packet [ns since epoch]
+  uint64_t sensorTime;  // sensor time at start of packet [usec], 0 if not known yet
+};
+
+static inline uint64_t chunkSize(uint64_t payload)
+{
+  return ((sizeof(ChunkHeader) + payload + 7) & ~uint64_t(7));
+}
+}  // namespace shm
+
+class ShmRingWriter
+{
+public:
+  ShmRingWriter() {}
+  ~ShmRingWriter();
+  ShmRingWriter(const ShmRingWriter &) = delete;
+  ShmRingWriter & operator=(const ShmRingWriter &) = delete;
+
+  // Creates (or replaces) the shared memory segment "name", which must
+  // start with a '/'. The capacity is rounded up to a power of two.
+  bool open(
+    const std::string & name, size_t capacity, uint32_t width, uint32_t height,
+    const std::string & encoding);
+  void close();
+  // called by a single thread only. Packets larger than a quarter of
+  // the capacity are dropped.
+  void write(uint64_t hostTime, const uint8_t * data, size_t n);
+  const std::string & getError() const { return (error_); }
+  size_t getNumDropped() const { return (numDropped_); }
+
+private:
+  std::string name_;
+  std::string error_;
+  shm::RingHeader * header_{nullptr};
+  uint8_t * data_{nullptr};
+  size_t mapSize_{0};
+  uint64_t mask_{0};
+  uint64_t pos_{0};
+  uint64_t sequence_{0};
+  size_t numDropped_{0};
+  EVT3Scanner scanner_;
+};
+
+class ShmRingReader
+{
+public:
+  struct Chunk
+  {
+    const uint8_t * data{nullptr};  // points into the ring, do not hold on to it
+    size_t size{0};
+    uint64_t sequence{0};
+    uint64_t hostTime{0};
+    uint64_t sensorTime{0};
+    uint64_t pos{0};  // position in the ring, for isValid()
+  };
+
+  ShmRingReader() {}
+  ~ShmRingReader();
+  ShmRingReader(const ShmRingReader &) = delete;
+  ShmRingReader & operator=(const ShmRingReader &) = delete;
+
+  // Maps the ring read-only. Reading starts at the newest data.
+  bool open(const std::string & name);
+  void close();
+  // Returns false if there is no new chunk. When the writer has lapped
+  // the reader, the reader skips to the newest data and counts an overrun.
+  bool next(Chunk * c);
+  // True if the chunk's data has not been overwritten. Must be called
+  // after using the data to know it was consistent.
+  bool isValid(const Chunk & c) const;
+  // False once the writer has closed the ring, or its process is gone
+  // without closing it. Makes a system call, so check only when idle.
+  bool isWriterAlive() const;
+  size_t getNumOverruns() const { return (numOverruns_); }
+  uint32_t getWidth() const { return (header_ ? header_->width : 0); }
+  uint32_t getHeight() const { return (header_ ? header_->height : 0); }
+  std::string getEncoding() const;
+  const std::string & getError() const { return (error_); }
+
+private:
+  std::string error_;
+  const shm::RingHeader * header_{nullptr};
+  const uint8_t * data_{nullptr};
+  size_t mapSize_{0};
+  uint64_t capacity_{0};
+  uint64_t pos_{0};
+  size_t numOverruns_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__SHM_RING_H_
@@ -0,0 +1,99 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__SPSC_RING_H_
+#define METAVISION_DRIVER__SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Bounded lock-free ring buffer for exactly one producer thread
+// and exactly one consumer thread. The capacity is rounded up to
+// the next power of two.
+//
+template <typename T>
+class SPSCRing
+{
+public:
+  explicit SPSCRing(size_t capacity)
+  {
+    size_t c = 2;
+    while (c < capacity) {
+      c <<= 1;
+    }
+    mask_ = c - 1;
+    elements_.resize(c);
+  }
+
+  // producer side. Returns false if the ring is full.
+  bool push(const T & e)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tailCache_ > mask_) {
+      tailCache_ = tail_.load(std::memory_order_acquire);
+      if (head - tailCache_ > mask_) {
+        return (false);
+      }
+    }
+    elements_[head & mask_] = e;
+    head_.store(head + 1, std::memory_order_release);
+    return (true);
+  }
+
+  // consumer side. Returns false if the ring is empty.
+  bool pop(T * e)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == headCache_) {
+      headCache_ = head_.load(std::memory_order_acquire);
+      if (tail == headCache_) {
+        return (false);
+      }
+    }
+    *e = elements_[tail & mask_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return (true);
+  }
+
+  // approximate when called while the other side is active
+  size_t size() const
+  {
+    return (head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+  bool empty() const { return (size() == 0); }
+  size_t capacity() const { return (mask_ + 1); }
+
+private:
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+  // Head and tail are on separate cache lines, each together with the
+  // cached copy of the other side's index. Padding rather than alignas
+  // keeps the ring free of over-aligned types, which C++14 cannot
+  // allocate from the heap with the right alignment.
+  char pad0_[CACHE_LINE_SIZE];
+  std::atomic<size_t> head_{0};  // written by producer
+  size_t tailCache_{0};          // producer's copy of tail
+  char pad1_[CACHE_LINE_SIZE - sizeof(size_t) - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_{0};  // written by consumer
+  size_t headCache_{0};          // consumer's copy of head
+  char pad2_[CACHE_LINE_SIZE - sizeof(size_t) - sizeof(std::atomic<size_t>)];
+  size_t mask_{0};
+  std::vector<T> elements_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__SPSC_RING_H_
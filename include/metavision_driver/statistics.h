@@ -0,0 +1,118 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__STATISTICS_H_
+#define METAVISION_DRIVER__STATISTICS_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "metavision_driver/latency_histogram.h"
+
+namespace metavision_driver
+{
+// stages of the packet pipeline for which latency is measured
+enum LatencyStage {
+  QUEUE_LATENCY = 0,  // SDK callback to dequeue by processing thread
+  MESSAGE_LATENCY,    // first packet of message to message close-out
+  PUBLISH_LATENCY,    // message close-out to return from publish()
+  TOTAL_LATENCY,      // first packet of message to return from publish()
+  NUM_LATENCY_STAGES
+};
+
+// snapshot of driver statistics over one statistics interval
+struct Statistics
+{
+  double interval{0};  // length of interval in seconds
+  double bytesRecvRate{0};
+  double bytesSentRate{0};
+  double msgsRecvRate{0};
+  double msgsSentRate{0};
+  bool hasQueue{false};  // the following queue statistics are valid
+  size_t maxQueueSize{0};
+  size_t msgsDropped{0};
+  size_t bytesDropped{0};
+  size_t overloads{0};  // packets that found the queue over its byte budget
+  size_t poolHighWater{0};
+  size_t poolExhausted{0};
+  size_t msgPoolInUse{0};
+  size_t msgPoolFree{0};
+  size_t pageFaultsMinor{0};  // whole process
+  size_t pageFaultsMajor{0};
+  size_t sdkPageFaults{0};  // minor and major, on the SDK thread
+  bool hasRecorder{false};  // the following recorder statistics are valid
+  double recordedBytesRate{0};
+  size_t recordingDropped{0};         // bytes
+  size_t recordingMaxPending{0};      // buffers waiting for disk
+  uint64_t recordingMaxWriteTime{0};  // nsec
+  size_t recordingErrors{0};
+  std::string ercMode;
+  int ercRate{0};
+  bool ercThrottled{false};  // ERC rate lowered by the overload policy
+  bool hasLatency{false};  // the latency statistics are valid
+  LatencyHistogram::Summary latency[NUM_LATENCY_STAGES];
+};
+
+// flattens the statistics into key/value pairs, used for diagnostics
+inline std::vector<std::pair<std::string, std::string>> toKeyValues(const Statistics & s)
+{
+  std::vector<std::pair<std::string, std::string>> kv;
+  kv.emplace_back("interval [s]", std::to_string(s.interval));
+  kv.emplace_back("bytes in [B/s]", std::to_string(s.bytesRecvRate));
+  kv.emplace_back("bytes out [B/s]", std::to_string(s.bytesSentRate));
+  kv.emplace_back("msgs in [1/s]", std::to_string(s.msgsRecvRate));
+  kv.emplace_back("msgs out [1/s]", std::to_string(s.msgsSentRate));
+  if (s.hasQueue) {
+    kv.emplace_back("max queue size", std::to_string(s.maxQueueSize));
+    kv.emplace_back("msgs dropped", std::to_string(s.msgsDropped));
+    kv.emplace_back("bytes dropped", std::to_string(s.bytesDropped));
+    kv.emplace_back("queue overloads", std::to_string(s.overloads));
+    kv.emplace_back("pool high water mark", std::to_string(s.poolHighWater));
+    kv.emplace_back("pool exhausted", std::to_string(s.poolExhausted));
+  }
+  if (s.hasRecorder) {
+    kv.emplace_back("recorded bytes [B/s]", std::to_string(s.recordedBytesRate));
+    kv.emplace_back("recording dropped [B]", std::to_string(s.recordingDropped));
+    kv.emplace_back("recording max pending", std::to_string(s.recordingMaxPending));
+    kv.emplace_back("recording max write time [ns]", std::to_string(s.recordingMaxWriteTime));
+    kv.emplace_back("recording errors", std::to_string(s.recordingErrors));
+  }
+  kv.emplace_back("msg pool in use", std::to_string(s.msgPoolInUse));
+  kv.emplace_back("msg pool free", std::to_string(s.msgPoolFree));
+  kv.emplace_back("page faults minor", std::to_string(s.pageFaultsMinor));
+  kv.emplace_back("page faults major", std::to_string(s.pageFaultsMajor));
+  kv.emplace_back("page faults sdk thread", std::to_string(s.sdkPageFaults));
+  kv.emplace_back("erc mode", s.ercMode);
+  kv.emplace_back("erc rate [ev/s]", std::to_string(s.ercRate));
+  kv.emplace_back("erc throttled", s.ercThrottled ? "true" : "false");
+  if (s.hasLatency) {
+    const char * names[NUM_LATENCY_STAGES] = {"queue", "msg", "pub", "total"};
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++) {
+      if (i == QUEUE_LATENCY && !s.hasQueue) {
+        continue;
+      }
+      const std::string n = std::string("latency ") + names[i];
+      kv.emplace_back(n + " p50 [ns]", std::to_string(s.latency[i].p50));
+      kv.emplace_back(n + " p99 [ns]", std::to_string(s.latency[i].p99));
+      kv.emplace_back(n + " p99.9 [ns]", std::to_string(s.latency[i].p999));
+      kv.emplace_back(n + " max [ns]", std::to_string(s.latency[i].max));
+    }
+  }
+  return (kv);
+}
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__STATISTICS_H_
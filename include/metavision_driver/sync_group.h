@@ -0,0 +1,106 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__SYNC_GROUP_H_
+#define METAVISION_DRIVER__SYNC_GROUP_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace metavision_driver
+{
+//
+// In-process replacement for the "ready" handshake between primary
+// and secondary cameras when all drivers run in the same process.
+// Secondaries report in once their camera is started, and the primary
+// is started from whichever call completes the group.
+//
+class SyncGroup
+{
+public:
+  using Callback = std::function<void()>;
+
+  // returns the process-wide group of that name
+  static std::shared_ptr<SyncGroup> get(const std::string & name)
+  {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<SyncGroup>> groups;
+    std::unique_lock<std::mutex> lock(mutex);
+    std::shared_ptr<SyncGroup> g = groups[name].lock();
+    if (!g) {
+      g = std::make_shared<SyncGroup>();
+      groups[name] = g;
+    }
+    return (g);
+  }
+
+  // called by a secondary once it is up and running
+  void secondaryReady(const std::string & id)
+  {
+    Callback cb;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.insert(id);
+      cb = takeCallbackIfComplete();
+    }
+    if (cb) {
+      cb();
+    }
+  }
+
+  // Registers the primary's start function. It is called (possibly
+  // right away) once numSecondaries have reported in.
+  void onSecondariesReady(size_t numSecondaries, const Callback & startPrimary)
+  {
+    Callback cb;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      numSecondaries_ = numSecondaries;
+      startPrimary_ = startPrimary;
+      cb = takeCallbackIfComplete();
+    }
+    if (cb) {
+      cb();
+    }
+  }
+
+  // the primary must call this before going away
+  void cancel()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    startPrimary_ = nullptr;
+  }
+
+private:
+  Callback takeCallbackIfComplete()
+  {
+    Callback cb;
+    if (startPrimary_ && ready_.size() >= numSecondaries_) {
+      cb.swap(startPrimary_);
+    }
+    return (cb);
+  }
+  // ------------ variables
+  std::mutex mutex_;
+  std::set<std::string> ready_;
+  size_t numSecondaries_{0};
+  Callback startPrimary_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__SYNC_GROUP_H_
@@ -0,0 +1,86 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__THREAD_UTILS_H_
+#define METAVISION_DRIVER__THREAD_UTILS_H_
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// CPU affinity and scheduling policy of a driver thread. Buffers are
+// placed on the NUMA node of the thread that first touches them, so
+// threads are configured before they touch their buffers.
+//
+struct ThreadConfig
+{
+  std::vector<int> cpus;         // allowed CPUs, empty = no restriction
+  std::string policy{"other"};  // other, fifo, rr
+  int priority{0};               // for fifo and rr: 1 (low) to 99 (high)
+
+  bool isDefault() const { return (cpus.empty() && policy == "other"); }
+};
+
+// Applies the configuration to a thread. Returns false and sets the
+// error message if any part of it failed.
+inline bool applyThreadConfig(pthread_t thread, const ThreadConfig & c, std::string * error)
+{
+  bool ok = true;
+  error->clear();
+  if (!c.cpus.empty()) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (const int cpu : c.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpuSet);
+      }
+    }
+    const int ret = pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet);
+    if (ret != 0) {
+      *error += std::string("cannot set cpu affinity: ") + strerror(ret) + " ";
+      ok = false;
+    }
+  }
+  int policy = SCHED_OTHER;
+  if (c.policy == "fifo") {
+    policy = SCHED_FIFO;
+  } else if (c.policy == "rr") {
+    policy = SCHED_RR;
+  } else if (c.policy != "other") {
+    *error += "invalid scheduling policy: " + c.policy + " ";
+    return (false);
+  }
+  if (policy != SCHED_OTHER) {
+    sched_param param;
+    param.sched_priority = std::max(
+      sched_get_priority_min(policy), std::min(c.priority, sched_get_priority_max(policy)));
+    const int ret = pthread_setschedparam(thread, policy, &param);
+    if (ret != 0) {
+      // typically missing CAP_SYS_NICE or rtprio limit
+      *error += std::string("cannot set scheduling policy ") + c.policy + ": " + strerror(ret);
+      ok = false;
+    }
+  }
+  return (ok);
+}
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__THREAD_UTILS_H_
@@ -0,0 +1,116 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__WORKER_POOL_H_
+#define METAVISION_DRIVER__WORKER_POOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/thread_utils.h"
+
+namespace metavision_driver
+{
+class MetavisionWrapper;  // forward decl
+
+//
+// Serves the processing and statistics of several cameras from a
+// fixed set of threads, instead of two threads per camera. Each camera
+// is assigned to exactly one worker so its packets are still processed
+// in order by a single consumer. Workers can be pinned to CPUs.
+// All drivers in a process share the same pool (see getShared()).
+//
+class WorkerPool
+{
+public:
+  class Worker
+  {
+  public:
+    // called by the producer (SDK thread) when new data is available
+    inline void notify()
+    {
+      // Orders the producer's queue write before reading the flag, pairs
+      // with the worker setting the flag before its last look at the
+      // queues. Only takes the lock if the worker is about to sleep.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (parked_.load()) {
+        {
+          std::unique_lock<std::mutex> lock(waitMutex_);
+          wakeup_ = true;
+        }
+        cv_.notify_one();
+      }
+    }
+
+  private:
+    friend class WorkerPool;
+    std::mutex mutex_;  // guards cameras_
+    std::mutex waitMutex_;  // guards wakeup_
+    std::condition_variable cv_;
+    std::atomic<bool> parked_{false};
+    bool wakeup_{false};
+    std::vector<MetavisionWrapper *> cameras_;
+    std::shared_ptr<std::thread> thread_;
+    int cpu_{-1};
+  };
+
+  // cpus: list of CPUs to pin the workers to (worker i to cpus[i % size]),
+  // sched: scheduling policy and priority of the workers
+  WorkerPool(
+    size_t numWorkers, const std::vector<int> & cpus, const ThreadConfig & sched = ThreadConfig());
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool & operator=(const WorkerPool &) = delete;
+
+  // Returns the process-wide pool, creating it with the given
+  // configuration if it does not exist yet.
+  static std::shared_ptr<WorkerPool> getShared(
+    size_t numWorkers, const std::vector<int> & cpus, const ThreadConfig & sched = ThreadConfig());
+
+  // assigns the camera to the least loaded worker, returns that worker
+  Worker * add(MetavisionWrapper * cam);
+  // after return, the pool will no longer call into the camera
+  void remove(MetavisionWrapper * cam);
+  size_t getNumWorkers() const { return (workers_.size()); }
+  // errors encountered when configuring the worker threads, empty if none
+  const std::string & getThreadConfigError() const { return (threadConfigError_); }
+
+private:
+  void workerThread(Worker * w);
+  bool processAll(Worker * w);
+  void statsThread();
+  // ------------ variables
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<bool> keepRunning_{true};
+  std::mutex statsMutex_;  // guards statsCameras_
+  std::condition_variable statsCv_;
+  struct StatsEntry
+  {
+    MetavisionWrapper * cam;
+    std::chrono::steady_clock::time_point nextTime;
+  };
+  std::vector<StatsEntry> statsCameras_;
+  std::shared_ptr<std::thread> statsThread_;
+  std::string threadConfigError_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__WORKER_POOL_H_
@@ -0,0 +1,96 @@
+# -----------------------------------------------------------------------------
+# Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+
+import os
+
+from ament_index_python.packages import get_package_share_directory
+import launch
+from launch.actions import DeclareLaunchArgument as LaunchArg
+from launch.actions import OpaqueFunction
+from launch.substitutions import LaunchConfiguration as LaunchConfig
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+
+
+def launch_setup(context, *args, **kwargs):
+    """Create one driver per camera, all in the same process."""
+    serials = LaunchConfig("serials").perform(context).split(",")
+    cpus = [int(c) for c in LaunchConfig("cpus").perform(context).split(",") if c]
+    share_dir = get_package_share_directory("metavision_driver")
+    bias_config = os.path.join(share_dir, "config", "silky_ev_cam.bias")
+    nodes = []
+    for i, serial in enumerate(serials):
+        # the first camera is the primary, all others are secondaries
+        nodes.append(
+            ComposableNode(
+                package="metavision_driver",
+                plugin="metavision_driver::DriverROS2",
+                name="event_cam_" + str(i),
+                parameters=[
+                    {
+                        "use_multithreading": True,
+                        "bias_file": bias_config,
+                        "frame_id": "cam_" + str(i),
+                        "serial": serial,
+                        "sync_mode": "primary" if i == 0 else "secondary",
+                        "sync_group": "multi_camera",
+                        "num_secondary_nodes": len(serials) - 1,
+                        "use_worker_pool": True,
+                        "worker_pool_threads": int(
+                            LaunchConfig("worker_threads").perform(context)
+                        ),
+                        "worker_pool_cpus": cpus if cpus else [-1],
+                        "event_message_time_threshold": 1.0e-3,
+                    }
+                ],
+                remappings=[("~/events", "event_cam_" + str(i) + "/events")],
+                extra_arguments=[{"use_intra_process_comms": True}],
+            )
+        )
+    container = ComposableNodeContainer(
+        name="metavision_driver_container",
+        namespace="",
+        package="rclcpp_components",
+        executable="component_container",
+        composable_node_descriptions=nodes,
+        output="screen",
+    )
+    return [container]
+
+
+def generate_launch_description():
+    """Create composable nodes by calling opaque function."""
+    return launch.LaunchDescription(
+        [
+            LaunchArg(
+                "serials",
+                default_value=[""],
+                description="comma separated serial numbers, primary first",
+            ),
+            LaunchArg(
+                "worker_threads",
+                default_value=["2"],
+                description="number of threads serving all cameras",
+            ),
+            LaunchArg(
+                "cpus",
+                default_value=[""],
+                description="comma separated cpus to pin the worker threads to",
+            ),
+            OpaqueFunction(function=launch_setup),
+        ]
+    )
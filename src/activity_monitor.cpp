@@ -0,0 +1,190 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/activity_monitor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "metavision_driver/evt3_scanner.h"
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+// the background thread is woken up early when this much data is waiting
+static constexpr size_t WAKEUP_SIZE = 1 << 20;
+
+ActivityMonitor::ActivityMonitor(
+  int width, int height, int tileSize, double interval, size_t maxBacklog,
+  const PublishFunc & publish, const EnabledFunc & enabled)
+: width_(static_cast<uint32_t>(std::max(width, 0))),
+  height_(static_cast<uint32_t>(std::max(height, 0))),
+  tileSize_(static_cast<uint32_t>(std::max(tileSize, 1))),
+  interval_(static_cast<int64_t>(std::max(interval, 1e-3) * 1e9)),
+  maxBacklog_(std::max(maxBacklog, WAKEUP_SIZE)),
+  publish_(publish),
+  isSubscribed_(enabled)
+{
+  tilesX_ = (width_ + tileSize_ - 1) / tileSize_;
+  tilesY_ = (height_ + tileSize_ - 1) / tileSize_;
+  counts_.resize(tilesX_ * tilesY_, 0);
+  y_ = height_;  // ignore events until the first ADDR_Y
+  intervalStart_ = std::chrono::system_clock::now();
+  thread_ = std::thread(&ActivityMonitor::worker, this);
+}
+
+ActivityMonitor::~ActivityMonitor()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+    cv_.notify_all();
+  }
+  thread_.join();
+}
+
+void ActivityMonitor::process(const uint8_t * data, size_t numBytes)
+{
+  bool wakeup;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const size_t oldSize = pending_.size();
+    if (oldSize + numBytes > maxBacklog_) {
+      // decoder is behind, rather skip data than hold up the driver
+      gap_ = true;
+      bytesSkipped_.fetch_add(numBytes, std::memory_order_relaxed);
+      return;
+    }
+    resize_hack(pending_, oldSize + numBytes);
+    memcpy(pending_.data() + oldSize, data, numBytes);
+    wakeup = pending_.size() >= WAKEUP_SIZE;
+  }
+  if (wakeup) {
+    cv_.notify_one();
+  }
+}
+
+void ActivityMonitor::worker()
+{
+  std::vector<uint8_t> work;
+  auto nextPublish = std::chrono::steady_clock::now() + interval_;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (keepRunning_) {
+    cv_.wait_until(lock, nextPublish, [this] {
+      return (pending_.size() >= WAKEUP_SIZE || !keepRunning_);
+    });
+    if (!keepRunning_) {
+      break;
+    }
+    work.swap(pending_);  // the data path keeps appending meanwhile
+    pending_.clear();
+    const bool gap = gap_;
+    gap_ = false;
+    lock.unlock();
+    if (gap) {
+      y_ = height_;  // row is unknown until the next ADDR_Y
+    }
+    decode(work.data(), work.size());
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= nextPublish) {
+      const auto t = std::chrono::system_clock::now();
+      if (enabled_.load(std::memory_order_relaxed)) {
+        Snapshot s;
+        s.width = tilesX_;
+        s.height = tilesY_;
+        s.tileSize = tileSize_;
+        s.counts.assign(counts_.begin(), counts_.end());
+        s.numEvents[0] = numEvents_[0];
+        s.numEvents[1] = numEvents_[1];
+        s.duration = std::chrono::duration<double>(t - intervalStart_).count();
+        s.time = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+        publish_(s);
+      }
+      // the counts always start fresh, also when just enabled
+      resetCounts();
+      intervalStart_ = t;
+      enabled_.store(isSubscribed_(), std::memory_order_relaxed);
+      nextPublish += interval_;
+      if (nextPublish < now) {
+        nextPublish = now + interval_;  // fell behind, e.g. a slow publish
+      }
+    }
+    lock.lock();
+  }
+}
+
+void ActivityMonitor::resetCounts()
+{
+  std::fill(counts_.begin(), counts_.end(), 0);
+  numEvents_[0] = numEvents_[1] = 0;
+}
+
+inline void ActivityMonitor::countVector(uint32_t mask)
+{
+  if (y_ >= height_) {
+    return;
+  }
+  uint32_t * row = &counts_[(y_ / tileSize_) * tilesX_];
+  uint32_t x = baseX_;
+  // split the vector at the tile boundaries
+  while (mask != 0 && x < width_) {
+    const uint32_t k = tileSize_ - x % tileSize_;  // columns left in this tile
+    const uint32_t n = __builtin_popcount(k >= 32 ? mask : (mask & ((1U << k) - 1)));
+    row[x / tileSize_] += n;
+    numEvents_[polarity_] += n;
+    if (k >= 32) {
+      break;
+    }
+    mask >>= k;
+    x += k;
+  }
+}
+
+void ActivityMonitor::decode(const uint8_t * data, size_t numBytes)
+{
+  const size_t numWords = numBytes / 2;
+  for (size_t i = 0; i < numWords; i++) {
+    uint16_t w;
+    memcpy(&w, data + 2 * i, sizeof(w));  // EVT3 is little endian
+    switch (evt3::type(w)) {
+      case evt3::ADDR_Y:
+        y_ = w & 0x07FF;
+        break;
+      case evt3::ADDR_X: {
+        const uint32_t x = w & 0x07FF;
+        if (x < width_ && y_ < height_) {
+          counts_[(y_ / tileSize_) * tilesX_ + x / tileSize_]++;
+          numEvents_[(w >> 11) & 1]++;
+        }
+        break;
+      }
+      case evt3::VECT_BASE_X:
+        baseX_ = w & 0x07FF;
+        polarity_ = (w >> 11) & 1;
+        break;
+      case evt3::VECT_12:
+        countVector(w & 0x0FFF);
+        baseX_ += 12;
+        break;
+      case evt3::VECT_8:
+        countVector(w & 0x00FF);
+        baseX_ += 8;
+        break;
+      default:
+        break;
+    }
+  }
+}
+}  // namespace metavision_driver
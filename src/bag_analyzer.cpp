@@ -0,0 +1,177 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// Reads the event packets of a bag one message at a time and reports
+// message gaps, seq jumps, header stamp drift against the sensor time,
+// bandwidth and likely SDK/USB drops. The memory used does not depend
+// on the size of the bag.
+//
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef USING_ROS_1
+#include <event_camera_msgs/EventPacket.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#else
+#include <event_camera_msgs/msg/event_packet.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <rmw/rmw.h>
+#include <rosbag2_cpp/reader.hpp>
+#include <rosbag2_storage/storage_filter.hpp>
+#include <rosidl_typesupport_cpp/message_type_support.hpp>
+#endif
+
+#include "metavision_driver/packet_stream_analyzer.h"
+
+using metavision_driver::PacketStreamAnalyzer;
+
+static void fillMessage(
+  uint64_t recordTime, uint64_t stamp, uint64_t seq, uint64_t timeBase,
+  const std::string & encoding, const std::vector<uint8_t> & events,
+  PacketStreamAnalyzer::Message * m)
+{
+  m->recordTime = recordTime;
+  m->stamp = stamp;
+  m->seq = seq;
+  m->timeBase = timeBase;
+  m->encoding = &encoding;
+  m->data = events.data();
+  m->size = events.size();
+}
+
+#ifdef USING_ROS_1
+static bool analyzeBag(
+  const std::string & bagName, const std::string & topic, PacketStreamAnalyzer * analyzer)
+{
+  rosbag::Bag bag;
+  try {
+    bag.open(bagName, rosbag::bagmode::Read);
+  } catch (const rosbag::BagException & e) {
+    printf("cannot open bag %s: %s\n", bagName.c_str(), e.what());
+    return (false);
+  }
+  // the view reads the bag chunk by chunk
+  rosbag::View view(bag, rosbag::TopicQuery(std::vector<std::string>{topic}));
+  for (const rosbag::MessageInstance & m : view) {
+    event_camera_msgs::EventPacket::ConstPtr msg = m.instantiate<event_camera_msgs::EventPacket>();
+    if (!msg) {
+      printf("topic %s does not have event packets!\n", topic.c_str());
+      return (false);
+    }
+    PacketStreamAnalyzer::Message am;
+    fillMessage(
+      m.getTime().toNSec(), msg->header.stamp.toNSec(), msg->seq, msg->time_base, msg->encoding,
+      msg->events, &am);
+    analyzer->process(am);
+  }
+  return (true);
+}
+#else
+// the recording time field was renamed in newer rosbag2 versions
+template <class T>
+static auto getRecordTime(const T & m, int) -> decltype(m.recv_timestamp)
+{
+  return (m.recv_timestamp);
+}
+template <class T>
+static auto getRecordTime(const T & m, long) -> decltype(m.time_stamp)  // NOLINT
+{
+  return (m.time_stamp);
+}
+
+static bool analyzeBag(
+  const std::string & bagName, const std::string & topic, PacketStreamAnalyzer * analyzer)
+{
+  using EventPacket = event_camera_msgs::msg::EventPacket;
+  rosbag2_cpp::Reader reader;
+  try {
+    reader.open(bagName);  // storage plugin is detected from the metadata
+  } catch (const std::exception & e) {
+    printf("cannot open bag %s: %s\n", bagName.c_str(), e.what());
+    return (false);
+  }
+  rosbag2_storage::StorageFilter filter;
+  filter.topics.push_back(topic);
+  reader.set_filter(filter);
+  const auto * typeSupport = rosidl_typesupport_cpp::get_message_type_support_handle<EventPacket>();
+  EventPacket msg;  // reused, so the event buffer does not get reallocated
+  while (reader.has_next()) {
+    auto bagMsg = reader.read_next();
+    // deserialize straight from the bag buffer, without extra copy
+    if (rmw_deserialize(bagMsg->serialized_data.get(), typeSupport, &msg) != RMW_RET_OK) {
+      printf("cannot deserialize message on topic %s!\n", topic.c_str());
+      return (false);
+    }
+    const uint64_t stamp = rclcpp::Time(msg.header.stamp).nanoseconds();
+    PacketStreamAnalyzer::Message am;
+    fillMessage(
+      getRecordTime(*bagMsg, 0), stamp, msg.seq, msg.time_base, msg.encoding, msg.events, &am);
+    analyzer->process(am);
+  }
+  return (true);
+}
+#endif
+
+static void usage()
+{
+  printf("usage: metavision_driver_bag_analyzer [options] bag\n");
+  printf("  -t topic       event packet topic (default /event_camera/events)\n");
+  printf("  -i seconds     report interval, 0 = summary only (default 1)\n");
+  printf("  -g seconds     report header stamp gaps larger than this (default 0.1)\n");
+  printf("  -q             do not print the individual gaps, jumps and drops\n");
+}
+
+int main(int argc, char ** argv)
+{
+  std::string topic("/event_camera/events");
+  PacketStreamAnalyzer::Config config;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:i:g:qh")) != -1) {
+    switch (opt) {
+      case 't':
+        topic = optarg;
+        break;
+      case 'i':
+        config.interval = atof(optarg);
+        break;
+      case 'g':
+        config.maxGap = atof(optarg);
+        break;
+      case 'q':
+        config.verbose = false;
+        break;
+      default:
+        usage();
+        return (-1);
+    }
+  }
+  if (optind != argc - 1) {
+    usage();
+    return (-1);
+  }
+  const std::string bagName(argv[optind]);
+  printf("analyzing topic %s of bag %s\n", topic.c_str(), bagName.c_str());
+  PacketStreamAnalyzer analyzer(config);
+  const bool ok = analyzeBag(bagName, topic, &analyzer);
+  analyzer.finish();
+  return (ok ? 0 : -1);
+}
@@ -0,0 +1,576 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// Measures the overhead of the driver's packet path without a camera:
+// a synthetic (or recorded) EVT3 file is played back through the mmap
+// file player into MetavisionWrapper, and the messages are aggregated
+// (and compressed) by the same MessageAggregator the drivers use, but
+// go to a null publisher that discards them.
+//
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef USING_ROS_1
+#include <event_camera_msgs/EventPacket.h>
+#include <ros/ros.h>
+#else
+#include <event_camera_msgs/msg/event_packet.hpp>
+#include <rclcpp/rclcpp.hpp>
+#endif
+
+#include "metavision_driver/compression_pool.h"
+#include "metavision_driver/evt3_scanner.h"
+#include "metavision_driver/file_player.h"
+#include "metavision_driver/message_aggregator.h"
+#include "metavision_driver/message_pool.h"
+#include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/packet_codec.h"
+
+// ------------- count heap allocations of the whole process
+
+static std::atomic<size_t> numAllocations{0};
+
+void * operator new(size_t n)
+{
+  numAllocations.fetch_add(1, std::memory_order_relaxed);
+  void * p = malloc(n == 0 ? 1 : n);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return (p);
+}
+void operator delete(void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+
+namespace metavision_driver
+{
+// ------------- synthetic EVT3 data
+
+static void push(std::vector<uint16_t> * w, uint8_t type, uint16_t payload)
+{
+  w->push_back(static_cast<uint16_t>((type << 12) | (payload & 0x0FFF)));
+}
+
+// writes a raw file with rate [Mev/s] for the given duration [s] of sensor time
+static size_t writeSyntheticFile(
+  const std::string & fileName, double rate, double duration, bool useVectors)
+{
+  const int width = 1280, height = 720;
+  FILE * f = fopen(fileName.c_str(), "wb");
+  if (!f) {
+    return (0);
+  }
+  fprintf(f, "%% evt 3.0\n%% format EVT3;height=%d;width=%d\n", height, width);
+  fprintf(f, "%% geometry %dx%d\n%% serial_number bench\n%% end\n", width, height);
+  std::vector<uint16_t> w;
+  size_t numEvents = 0;
+  double eventsDue = 0;
+  uint64_t lastTimeHigh = ~uint64_t(0);
+  int x = 0, y = 0;
+  const uint64_t tEnd = static_cast<uint64_t>(duration * 1e6);
+  for (uint64_t t = 0; t < tEnd; t++) {  // one iteration per usec
+    const uint64_t th = (t >> 12) & 0xFFF;
+    if (th != lastTimeHigh) {
+      push(&w, evt3::TIME_HIGH, th);
+      lastTimeHigh = th;
+    }
+    eventsDue += rate;
+    int k = static_cast<int>(eventsDue);
+    if (k == 0) {
+      continue;
+    }
+    eventsDue -= k;
+    numEvents += k;
+    push(&w, evt3::TIME_LOW, t & 0xFFF);
+    push(&w, evt3::ADDR_Y, y);
+    y = (y + 1) % height;
+    if (useVectors) {
+      x = x + k >= width ? 0 : x;
+      push(&w, evt3::VECT_BASE_X, static_cast<uint16_t>(x | ((t & 1) << 11)));
+      x += k;
+      for (; k >= 12; k -= 12) {
+        push(&w, evt3::VECT_12, 0x0FFF);
+      }
+      if (k != 0) {
+        push(&w, evt3::VECT_12, static_cast<uint16_t>((1 << k) - 1));
+      }
+    } else {
+      for (; k > 0; k--) {
+        push(&w, evt3::ADDR_X, static_cast<uint16_t>(x | ((t & 1) << 11)));
+        x = (x + 1) % width;
+      }
+    }
+    if (w.size() > (1 << 20)) {
+      fwrite(w.data(), sizeof(uint16_t), w.size(), f);
+      w.clear();
+    }
+  }
+  fwrite(w.data(), sizeof(uint16_t), w.size(), f);
+  fclose(f);
+  return (numEvents);
+}
+
+// ------------- message aggregation of the drivers, with a null publisher
+
+#ifdef USING_ROS_1
+using EventPacketMsg = event_camera_msgs::EventPacket;
+#else
+using EventPacketMsg = event_camera_msgs::msg::EventPacket;
+#endif
+using EventPacketPtr = std::unique_ptr<EventPacketMsg>;
+
+class BenchHandler : public MessageAggregator<BenchHandler, EventPacketMsg, EventPacketPtr>
+{
+  using Aggregator = MessageAggregator<BenchHandler, EventPacketMsg, EventPacketPtr>;
+  friend Aggregator;
+
+public:
+  struct Config
+  {
+    uint64_t timeThreshold{1000000};  // nsec
+    size_t sizeThreshold{1000000000};
+    size_t messagePoolSize{16};  // 0 = no message pool
+    bool useLoanedMessages{false};
+    PacketCodec::Type codecType{PacketCodec::NONE};
+    int codecLevel{0};
+    size_t compressionThreads{1};
+  };
+
+  BenchHandler(const std::shared_ptr<MetavisionWrapper> & w, const Config & config)
+  : useLoanedMessages_(config.useLoanedMessages)
+  {
+    wrapper_ = w;
+    timeKeeper_.reset(new ROSTimeKeeper("metavision_driver_bench"));
+    encoding_ = "evt3";
+    messageThresholdTime_ = config.timeThreshold;
+    messageThresholdSize_ = config.sizeThreshold;
+    if (config.messagePoolSize > 0) {
+      messagePool_ = std::make_shared<MessagePool<EventPacketMsg>>(config.messagePoolSize);
+    }
+    if (config.codecType != PacketCodec::NONE) {
+      compressor_.reset(new CompressionPool<EventPacketPtr>(
+        config.codecType, config.codecLevel, config.compressionThreads,
+        4 * config.compressionThreads, [this](EventPacketPtr msg) { sink(std::move(msg)); }));
+    }
+  }
+
+  void eventCDCallback(uint64_t, const Metavision::EventCD *, const Metavision::EventCD *) override
+  {
+  }
+
+  void triggerCallback(
+    uint64_t, const EVT3TriggerScanner::Trigger *, const EVT3TriggerScanner::Trigger *) override
+  {
+  }
+
+  void statisticsCallback(const Statistics & s) override
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    msgsDropped_ += s.msgsDropped;
+    bytesDropped_ += s.bytesDropped;
+    poolExhausted_ += s.poolExhausted;
+    sdkPageFaults_ += s.sdkPageFaults;
+    maxQueueSize_ = std::max(maxQueueSize_, s.maxQueueSize);
+    hasQueue_ = s.hasQueue;
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++) {
+      auto & l = worstLatency_[i];
+      l.p50 = std::max(l.p50, s.latency[i].p50);
+      l.p99 = std::max(l.p99, s.latency[i].p99);
+      l.p999 = std::max(l.p999, s.latency[i].p999);
+      l.max = std::max(l.max, s.latency[i].max);
+      l.count += s.latency[i].count;
+    }
+  }
+
+  // bytes that went into published messages, before compression
+  size_t getBytesPublished() const { return (bytesPublished_.load(std::memory_order_relaxed)); }
+
+  void report() const
+  {
+    printf("messages published: %zu\n", numMessages_.load());
+    if (compressor_) {
+      size_t bytesIn, bytesOut;
+      compressor_->getAndResetStatistics(&bytesIn, &bytesOut);
+      printf("compression ratio:  %.2f\n", bytesOut != 0 ? double(bytesIn) / bytesOut : 0.0);
+    }
+    printf("packets dropped:    %zu (%zu bytes)\n", msgsDropped_, bytesDropped_);
+    printf("pool exhausted:     %zu\n", poolExhausted_);
+    printf("sdk page faults:    %zu\n", sdkPageFaults_);
+    if (hasQueue_) {
+      printf("max queue size:     %zu\n", maxQueueSize_);
+    }
+    if (messagePool_) {
+      size_t inUse, numFree;
+      messagePool_->getOccupancy(&inUse, &numFree);
+      printf("message pool:       %zu in use, %zu free\n", inUse, numFree);
+    }
+    const char * names[NUM_LATENCY_STAGES] = {"queue", "msg", "pub", "total"};
+    printf("latency [us], worst interval: p50 / p99 / p99.9 / max\n");
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++) {
+      if (i == QUEUE_LATENCY && !hasQueue_) {
+        continue;
+      }
+      const auto & l = worstLatency_[i];
+      printf(
+        "  %-6s %8.1f / %8.1f / %8.1f / %8.1f\n", names[i], l.p50 * 1e-3, l.p99 * 1e-3,
+        l.p999 * 1e-3, l.max * 1e-3);
+    }
+  }
+
+private:
+  // ---------------- hooks for the MessageAggregator -----------
+  bool hasSubscribers() const { return (true); }
+
+  EventPacketPtr newMessage(size_t reserveSize)
+  {
+    if (messagePool_) {
+      return (messagePool_->get(reserveSize));
+    }
+    EventPacketPtr msg(new EventPacketMsg());
+    msg->events.reserve(reserveSize);
+    return (msg);
+  }
+
+  void submitMessage(EventPacketPtr msg)
+  {
+    bytesPublished_.fetch_add(msg->events.size(), std::memory_order_relaxed);
+    if (compressor_) {
+      compressor_->submit(std::move(msg));
+    } else {
+      sink(std::move(msg));
+    }
+  }
+
+  void setHeader(EventPacketMsg & msg, uint64_t, uint64_t stamp)
+  {
+#ifdef USING_ROS_1
+    msg.header.stamp = ros::Time().fromNSec(stamp);
+#else
+    msg.header.stamp = rclcpp::Time(stamp, RCL_SYSTEM_TIME);
+#endif
+  }
+
+  EventPacketMsg * borrowMessage()
+  {
+    if (!useLoanedMessages_) {
+      return (nullptr);
+    }
+    // the reused member stands in for middleware-owned memory
+    loanedMsg_.events.clear();
+    return (&loanedMsg_);
+  }
+
+  void publishBorrowedMessage()
+  {
+    bytesPublished_.fetch_add(loanedMsg_.events.size(), std::memory_order_relaxed);
+    touch(loanedMsg_);
+    loanedMsg_.events.clear();
+  }
+
+  void releaseBorrowedMessage() { loanedMsg_.events.clear(); }
+  // ---------------- end of hooks -----------
+
+  // stands in for publish(): touch the data so it cannot be optimized away
+  void touch(const EventPacketMsg & msg)
+  {
+    volatile uint8_t v = msg.events.empty() ? 0 : msg.events[msg.events.size() / 2];
+    (void)v;
+    numMessages_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // called by the aggregator, or by the compression threads
+  void sink(EventPacketPtr msg)
+  {
+    touch(*msg);
+    if (messagePool_) {
+      messagePool_->put(std::move(msg));
+      updateMessagePoolStatistics();
+    }
+  }
+  // ------------ variables
+  bool useLoanedMessages_{false};
+  EventPacketMsg loanedMsg_;
+  std::unique_ptr<CompressionPool<EventPacketPtr>> compressor_;
+  std::atomic<size_t> bytesPublished_{0};
+  std::atomic<size_t> numMessages_{0};
+  // ---- statistics
+  std::mutex mutex_;
+  size_t msgsDropped_{0};
+  size_t bytesDropped_{0};
+  size_t poolExhausted_{0};
+  size_t sdkPageFaults_{0};
+  size_t maxQueueSize_{0};
+  bool hasQueue_{false};
+  LatencyHistogram::Summary worstLatency_[NUM_LATENCY_STAGES];
+};
+
+static double cpuTime()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (
+    ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + 1e-6 * (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec));
+}
+}  // namespace metavision_driver
+
+static void usage()
+{
+  printf("usage: metavision_driver_bench [options]\n");
+  printf("  -r rate        synthetic event rate in Mev/s (default 50)\n");
+  printf("  -d duration    synthetic data duration in seconds (default 5)\n");
+  printf("  -e encoding    synthetic event encoding: vect or addr (default vect)\n");
+  printf("  -f file        play back recorded EVT3 raw file instead of synthetic data\n");
+  printf("  -o file        where to write the synthetic data (default /tmp/bench.raw)\n");
+  printf("  -x speed       playback rate, 0 = as fast as possible (default 1)\n");
+  printf("  -p bytes       packet size (default 65536)\n");
+  printf("  -m mode        single, multi, direct, or loan (default multi)\n");
+  printf("  -q queue       queue type for multi mode: deque or ring (default deque)\n");
+  printf("  -b blocks      number of queue pool blocks, 0 = no pool (default 512)\n");
+  printf("  -g pages       huge pages: none, transparent, or explicit (default none)\n");
+  printf("  -F             pre-fault the queue pool\n");
+  printf("  -L             lock the queue pool into memory\n");
+  printf("  -u megabytes   queue byte budget, 0 = unbounded (default 0)\n");
+  printf("  -k policy      overload policy: drop_newest or drop_oldest (default drop_newest)\n");
+  printf("  -w threads     serve the camera from a worker pool with that many threads\n");
+  printf("  -t seconds     message time threshold (default 1e-3)\n");
+  printf("  -s bytes       message size threshold (default 1000000000)\n");
+  printf("  -n messages    message pool size, 0 = no pool (default 16)\n");
+  printf("  -c encoding    message encoding: evt3, evt3_lz4, evt3_zstd[:level] (default evt3)\n");
+  printf("  -j threads     number of compression threads (default 1)\n");
+  printf("  -v             print driver statistics while running\n");
+}
+
+int main(int argc, char ** argv)
+{
+  using metavision_driver::BenchHandler;
+  using metavision_driver::MetavisionWrapper;
+  using metavision_driver::PacketCodec;
+  double rate = 50, duration = 5, speed = 1.0, timeThreshold = 1e-3;
+  size_t packetSize = 65536, poolSize = 512, numWorkers = 0;
+  size_t queueBudget = 0;
+  std::string encoding("vect"), inFile, outFile("/tmp/bench.raw"), mode("multi");
+  std::string queueType("deque"), overloadPolicy("drop_newest"), msgEncoding("evt3");
+  BenchHandler::Config config;
+  bool verbose = false;
+  metavision_driver::MemoryConfig memoryConfig;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:d:e:f:o:x:p:m:q:b:g:FLu:k:w:t:s:n:c:j:vh")) != -1) {
+    switch (opt) {
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'd':
+        duration = atof(optarg);
+        break;
+      case 'e':
+        encoding = optarg;
+        break;
+      case 'f':
+        inFile = optarg;
+        break;
+      case 'o':
+        outFile = optarg;
+        break;
+      case 'x':
+        speed = atof(optarg);
+        break;
+      case 'p':
+        packetSize = static_cast<size_t>(atol(optarg));
+        break;
+      case 'm':
+        mode = optarg;
+        break;
+      case 'q':
+        queueType = optarg;
+        break;
+      case 'b':
+        poolSize = static_cast<size_t>(atol(optarg));
+        break;
+      case 'g':
+        memoryConfig.hugePages = optarg;
+        break;
+      case 'F':
+        memoryConfig.prefault = true;
+        break;
+      case 'L':
+        memoryConfig.lock = true;
+        break;
+      case 'u':
+        queueBudget = static_cast<size_t>(atol(optarg)) << 20;
+        break;
+      case 'k':
+        overloadPolicy = optarg;
+        break;
+      case 'w':
+        numWorkers = static_cast<size_t>(atol(optarg));
+        break;
+      case 't':
+        timeThreshold = atof(optarg);
+        break;
+      case 's':
+        config.sizeThreshold = static_cast<size_t>(atol(optarg));
+        break;
+      case 'n':
+        config.messagePoolSize = static_cast<size_t>(atol(optarg));
+        break;
+      case 'c':
+        msgEncoding = optarg;
+        break;
+      case 'j':
+        config.compressionThreads = std::max(static_cast<size_t>(atol(optarg)), size_t(1));
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage();
+        return (-1);
+    }
+  }
+  if (mode != "single" && mode != "multi" && mode != "direct" && mode != "loan") {
+    usage();
+    return (-1);
+  }
+  std::string codecError;
+  if (!PacketCodec::parse(msgEncoding, &config.codecType, &config.codecLevel, &codecError)) {
+    printf("%s\n", codecError.c_str());
+    return (-1);
+  }
+  config.timeThreshold = static_cast<uint64_t>(timeThreshold * 1e9);
+  // loaned messages are filled in place, in single threaded mode,
+  // and like in the driver only when they are not compressed
+  config.useLoanedMessages = mode == "loan" && config.codecType == PacketCodec::NONE;
+  if (mode == "loan" && !config.useLoanedMessages) {
+    printf("compressed messages cannot be loaned!\n");
+    return (-1);
+  }
+#ifdef USING_ROS_1
+  ros::init(argc, argv, "metavision_driver_bench", ros::init_options::AnonymousName);
+  ros::start();  // ros::ok() must be true for the wrapper threads
+#else
+  rclcpp::init(argc, argv);
+#endif
+  size_t numEvents = 0;
+  if (inFile.empty()) {
+    printf(
+      "writing %.1fs of synthetic data at %.1f Mev/s to %s\n", duration, rate, outFile.c_str());
+    numEvents = metavision_driver::writeSyntheticFile(outFile, rate, duration, encoding == "vect");
+    inFile = outFile;
+  }
+  size_t dataSize;
+  {
+    metavision_driver::FilePlayer probe;
+    if (!probe.open(inFile)) {
+      printf("cannot open %s: %s\n", inFile.c_str(), probe.getError().c_str());
+      return (-1);
+    }
+    dataSize = probe.getDataSize() & ~size_t(1);
+  }
+
+  auto wrapper = std::make_shared<MetavisionWrapper>("metavision_driver_bench");
+  BenchHandler handler(wrapper, config);
+  wrapper->setFromFile(inFile);
+  wrapper->setPlayback(speed, true, packetSize);
+  wrapper->setStatisticsInterval(0.5);
+  wrapper->setLogStatistics(verbose);
+  wrapper->setLatencyStatistics(true);
+  wrapper->setQueueType(queueType, 1024);
+  wrapper->setQueuePool(poolSize, 0);
+  wrapper->setMemoryConfig(memoryConfig);
+  wrapper->setOverloadPolicy(overloadPolicy, queueBudget);
+  if (numWorkers != 0) {
+    wrapper->setWorkerPool(metavision_driver::WorkerPool::getShared(numWorkers, {}));
+  }
+  wrapper->setDirectAggregation(mode == "direct");
+  if (!wrapper->initialize(mode == "multi" || mode == "direct", std::string(""))) {
+    printf("wrapper initialization failed!\n");
+    return (-1);
+  }
+  const size_t alloc0 = numAllocations.load();
+  const double cpu0 = metavision_driver::cpuTime();
+  const auto t0 = std::chrono::steady_clock::now();
+  wrapper->startCamera(&handler);
+  // Wait until all data has been published, or no more data gets
+  // published. The last message is never completed, so measure up to
+  // the last progress.
+  size_t lastBytes = 0;
+  auto lastProgress = t0;
+  double cpu = 0;
+  size_t numAlloc = 0;
+  while (handler.getBytesPublished() < dataSize) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const auto now = std::chrono::steady_clock::now();
+    const size_t bytes = handler.getBytesPublished();
+    if (bytes != lastBytes) {
+      lastBytes = bytes;
+      lastProgress = now;
+      cpu = metavision_driver::cpuTime() - cpu0;
+      numAlloc = numAllocations.load() - alloc0;
+    } else if (now - lastProgress > std::chrono::seconds(1)) {
+      break;
+    }
+  }
+  const double dt = std::chrono::duration<double>(lastProgress - t0).count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));  // last statistics interval
+  wrapper->stop();
+
+  const double bytesIn = static_cast<double>(lastBytes);
+  printf("mode: %s", mode.c_str());
+  if (mode == "multi") {
+    printf(" (%s)", queueType.c_str());
+  }
+  if (numWorkers != 0) {
+    printf(" (worker pool)");
+  }
+  printf(", encoding: %s", msgEncoding.c_str());
+  printf(", packet size: %zu, playback rate: %.1f\n", packetSize, speed);
+  printf("wall time:          %.3f s\n", dt);
+  printf(
+    "data:               %.1f MB of %.1f MB, %.1f MB/s\n", bytesIn * 1e-6, dataSize * 1e-6,
+    bytesIn * 1e-6 / dt);
+  if (numEvents != 0) {
+    const double mev = numEvents * 1e-6 * (bytesIn / dataSize);
+    printf("events:             %.1f Mev, %.1f Mev/s\n", mev, mev / dt);
+    printf(
+      "cpu:                %.3f ms per Mev (%.0f%% of one core)\n", cpu * 1e3 / mev,
+      100 * cpu / dt);
+  } else {
+    printf(
+      "cpu:                %.3f ms per MB (%.0f%% of one core)\n", cpu * 1e3 / (bytesIn * 1e-6),
+      100 * cpu / dt);
+  }
+  printf("allocations:        %.0f per second\n", numAlloc / dt);
+  handler.report();
+#ifdef USING_ROS_1
+  ros::shutdown();
+#else
+  rclcpp::shutdown();
+#endif
+  return (0);
+}
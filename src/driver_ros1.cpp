@@ -17,6 +17,9 @@
 
 #include <event_camera_msgs/EventPacket.h>
 
+#include <algorithm>
+#include <sstream>
+
 #include "metavision_driver/check_endian.h"
 #include "metavision_driver/metavision_wrapper.h"
 
@@ -26,20 +29,69 @@ namespace ph = std::placeholders;
 DriverROS1::DriverROS1(ros::NodeHandle & nh) : nh_(nh)
 {
   configureWrapper(ros::this_node::getName());
-
-  encoding_ = nh.param<std::string>("encoding", "evt3");
-  if (encoding_ != "evt3") {
-    ROS_ERROR_STREAM("invalid encoding: " << encoding_);
+  timeKeeper_.reset(new ROSTimeKeeper(ros::this_node::getName()));
+
+  const std::string encoding = nh.param<std::string>("encoding", "evt3");
+  PacketCodec::Type codecType;
+  int codecLevel;
+  std::string codecError;
+  if (!PacketCodec::parse(encoding, &codecType, &codecLevel, &codecError)) {
+    ROS_ERROR_STREAM(codecError);
     throw std::runtime_error("invalid encoding!");
   }
+  encoding_ = "evt3";  // messages are filled with raw EVT3, compression comes later
   messageThresholdTime_ =
     uint64_t(std::abs(nh_.param<double>("event_message_time_threshold", 1e-3) * 1e9));
   messageThresholdSize_ =
     static_cast<size_t>(std::abs(nh_.param<int>("event_message_size_threshold", 1024 * 1024)));
+  const std::string batchingMode = nh_.param<std::string>("message_batching_mode", "static");
+  if (batchingMode == "adaptive") {
+    const double latencyTarget = nh_.param<double>("batching_latency_target", 5e-3);
+    const double maxRate = nh_.param<double>("batching_max_message_rate", 1000.0);
+    const int maxSize = nh_.param<int>("batching_max_message_size", 4 * 1024 * 1024);
+    batching_.reset(new BatchingController(
+      uint64_t(std::abs(latencyTarget) * 1e9), std::abs(maxRate),
+      static_cast<size_t>(std::abs(maxSize))));
+    messageThresholdTime_ = batching_->getTimeThreshold();
+    messageThresholdSize_ = batching_->getSizeThreshold();
+    ROS_INFO_STREAM(
+      "adaptive batching with latency target " << latencyTarget << "s, max message rate "
+                                               << maxRate << "Hz, max size " << maxSize);
+  } else if (batchingMode != "static") {
+    ROS_WARN_STREAM("invalid message batching mode: " << batchingMode << ", using static");
+  }
 
   eventPub_ = nh_.advertise<EventPacketMsg>("events", nh_.param<int>("send_queue_size", 1000));
+  if (codecType != PacketCodec::NONE) {
+    const int numThreads = std::max(nh_.param<int>("compression_threads", 1), 1);
+    compressor_.reset(new CompressionPool<EventPacketMsg::Ptr>(
+      codecType, codecLevel, numThreads, 4 * numThreads,
+      [this](EventPacketMsg::Ptr msg) { eventPub_.publish(msg); }));
+    ROS_INFO_STREAM("publishing " << encoding << " with " << numThreads << " compression threads");
+  }
+  const int msgPoolSize = nh_.param<int>("message_pool_size", 16);
+  if (msgPoolSize > 0) {
+    messagePool_ = std::make_shared<MessagePool<EventPacketMsg>>(msgPoolSize);
+  }
+  configureMemory();
 
-  if (wrapper_->getSyncMode() == "primary") {
+  const std::string syncGroup = nh_.param<std::string>("sync_group", "");
+  if (!syncGroup.empty() && wrapper_->getSyncMode() != "standalone") {
+    // all drivers of the group run in this process: no ROS round trip
+    syncGroup_ = SyncGroup::get(syncGroup);
+    ROS_INFO_STREAM("using in-process sync group: " << syncGroup);
+  }
+  if (wrapper_->getSyncMode() == "primary" && syncGroup_) {
+    // started by the last secondary to report in, or right away
+    syncGroup_->onSecondariesReady(
+      std::max(nh_.param<int>("num_secondary_nodes", 1), 0), [this]() {
+        ROS_INFO_STREAM("all secondaries are up!");
+        start();
+      });
+  } else if (wrapper_->getSyncMode() == "secondary" && syncGroup_) {
+    start();
+    syncGroup_->secondaryReady(nh_.getNamespace());
+  } else if (wrapper_->getSyncMode() == "primary") {
     // defer starting the primary until the secondary is up
     ros::ServiceClient client = nh_.serviceClient<Trigger>("ready");
     Trigger trig;
@@ -62,8 +114,14 @@ DriverROS1::DriverROS1(ros::NodeHandle & nh) : nh_(nh)
 
 DriverROS1::~DriverROS1()
 {
-  stop();
+  if (syncGroup_) {
+    syncGroup_->cancel();
+  }
+  stop();  // no more packets from here on
+  // publishes what is still pending, which needs the wrapper for the statistics
+  compressor_.reset();
   wrapper_.reset();  // invoke destructor
+  activityMonitor_.reset();
 }
 
 bool DriverROS1::saveBiases(Trigger::Request & req, Trigger::Response & res)
@@ -77,6 +135,17 @@ bool DriverROS1::saveBiases(Trigger::Request & req, Trigger::Response & res)
   return (res.success);
 }
 
+bool DriverROS1::restartStreaming(Trigger::Request & req, Trigger::Response & res)
+{
+  (void)req;
+  res.success = false;
+  if (wrapper_) {
+    res.success = wrapper_->restartStreaming();
+  }
+  res.message = std::string("restart ") + (res.success ? "succeeded" : "failed");
+  return (res.success);
+}
+
 int DriverROS1::getBias(const std::string & name) const
 {
   if (biasParameters_.find(name) != biasParameters_.end()) {
@@ -85,18 +154,76 @@ int DriverROS1::getBias(const std::string & name) const
   return (0);
 }
 
-void DriverROS1::setBias(int * field, const std::string & name)
+void DriverROS1::requestBias(
+  std::map<std::string, int> * values, int field, const std::string & name) const
 {
   auto it = biasParameters_.find(name);
   if (it != biasParameters_.end()) {
     auto & bp = it->second;
-    int val = std::min(std::max(*field, bp.minVal), bp.maxVal);
-    if (val != *field) {
+    int val = std::min(std::max(field, bp.minVal), bp.maxVal);
+    if (val != field) {
       ROS_WARN_STREAM(name << " must be between " << bp.minVal << " and " << bp.maxVal);
     }
-    wrapper_->setBias(name, val);
-    const int new_val = wrapper_->getBias(name);  // read back
-    *field = new_val;                             // feed back if not changed to desired value!
+    (*values)[name] = val;
+  }
+}
+
+void DriverROS1::updateBias(
+  const std::map<std::string, int> & values, int * field, const std::string & name) const
+{
+  auto it = values.find(name);
+  if (it != values.end()) {
+    *field = it->second;  // feed back if not changed to desired value!
+  }
+}
+
+// "x y width height ..." (commas also work) to ROI vector
+static bool parseROI(std::string s, std::vector<int> * roi)
+{
+  std::replace(s.begin(), s.end(), ',', ' ');
+  std::stringstream ss(s);
+  roi->clear();
+  int v;
+  while (ss >> v) {
+    roi->push_back(v);
+  }
+  return (ss.eof() && roi->size() % 4 == 0);
+}
+
+static std::string formatROI(const std::vector<int> & roi)
+{
+  std::stringstream ss;
+  for (size_t i = 0; i < roi.size(); i++) {
+    ss << (i == 0 ? "" : " ") << roi[i];
+  }
+  return (ss.str());
+}
+
+// level bits of the settings in MetaVisionDyn.cfg
+static constexpr int ROI_LEVEL = 1;
+static constexpr int ERC_LEVEL = 2;
+static constexpr int MIPI_LEVEL = 4;
+
+void DriverROS1::configureCamera(Config & config, int level)
+{
+  if (level & ROI_LEVEL) {
+    std::vector<int> roi;
+    if (!parseROI(config.roi_rects, &roi)) {
+      ROS_WARN_STREAM("invalid ROI: " << config.roi_rects);
+      config.roi_rects = formatROI(wrapper_->getROI());
+    } else if (!wrapper_->updateROI(roi)) {
+      config.roi_rects = formatROI(wrapper_->getROI());
+    }
+  }
+  if (level & ERC_LEVEL) {
+    wrapper_->updateEventRateController(config.erc_mode, config.erc_rate);
+  }
+  if ((level & MIPI_LEVEL) && config.mipi_frame_period > 0) {
+    const int period = wrapper_->updateMIPIFramePeriod(config.mipi_frame_period);
+    if (period > 0) {
+      resetBatching_ = true;  // packets now arrive at a different cadence
+      config.mipi_frame_period = period;
+    }
   }
 }
 
@@ -110,14 +237,26 @@ void DriverROS1::configure(Config & config, int level)
     config.bias_hpf = getBias("bias_hpf");
     config.bias_pr = getBias("bias_pr");
     config.bias_refr = getBias("bias_refr");
+    // erc and mipi were read from the same parameters at startup
+    config.roi_rects = formatROI(wrapper_->getROI());
     ROS_INFO("initialized config to camera biases");
   } else {
-    setBias(&config.bias_diff_off, "bias_diff_off");
-    setBias(&config.bias_diff_on, "bias_diff_on");
-    setBias(&config.bias_fo, "bias_fo");
-    setBias(&config.bias_hpf, "bias_hpf");
-    setBias(&config.bias_pr, "bias_pr");
-    setBias(&config.bias_refr, "bias_refr");
+    // apply all biases at once, with a single read back
+    std::map<std::string, int> values;
+    requestBias(&values, config.bias_diff_off, "bias_diff_off");
+    requestBias(&values, config.bias_diff_on, "bias_diff_on");
+    requestBias(&values, config.bias_fo, "bias_fo");
+    requestBias(&values, config.bias_hpf, "bias_hpf");
+    requestBias(&values, config.bias_pr, "bias_pr");
+    requestBias(&values, config.bias_refr, "bias_refr");
+    values = wrapper_->setBiases(values);
+    updateBias(values, &config.bias_diff_off, "bias_diff_off");
+    updateBias(values, &config.bias_diff_on, "bias_diff_on");
+    updateBias(values, &config.bias_fo, "bias_fo");
+    updateBias(values, &config.bias_hpf, "bias_hpf");
+    updateBias(values, &config.bias_pr, "bias_pr");
+    updateBias(values, &config.bias_refr, "bias_refr");
+    configureCamera(config, level);
   }
   config_ = config;  // remember current values
 }
@@ -132,17 +271,72 @@ bool DriverROS1::secondaryReadyCallback(Trigger::Request &, Trigger::Response &
 void DriverROS1::start()
 {
   wrapper_->setStatisticsInterval(nh_.param<double>("statistics_print_interval", 1.0));
+  wrapper_->setLatencyStatistics(nh_.param<bool>("latency_statistics", false));
+  const std::string cutMode = nh_.param<std::string>("message_cut_mode", "host");
+  cutOnSensorTime_ = (cutMode == "sensor");
+  if (cutMode != "host" && cutMode != "sensor") {
+    ROS_WARN_STREAM("invalid message_cut_mode: " << cutMode << ", using host time!");
+  }
+  const std::string stampMode = nh_.param<std::string>("time_stamp_mode", "host");
+  stampOnSensorTime_ = (stampMode == "sensor");
+  if (stampMode != "host" && stampMode != "sensor") {
+    ROS_WARN_STREAM("invalid time_stamp_mode: " << stampMode << ", using host time!");
+  }
+  const bool useDirect = nh_.param<bool>("use_direct_aggregation", false);
+  if ((cutOnSensorTime_ || stampOnSensorTime_) && useDirect) {
+    ROS_WARN_STREAM("sensor time message cut/stamp is not supported with direct aggregation!");
+    cutOnSensorTime_ = false;
+    stampOnSensorTime_ = false;
+  }
+  wrapper_->setLogStatistics(nh_.param<bool>("log_statistics", true));
+  publishStatistics_ = nh_.param<bool>("publish_statistics", false);
+  if (publishStatistics_) {
+    diagnosticsPub_ = ros::NodeHandle().advertise<diagnostic_msgs::DiagnosticArray>(
+      "/diagnostics", 10);
+  }
+  wrapper_->setQueuePool(
+    std::max(nh_.param<int>("queue_pool_size", 512), 0),
+    std::max(nh_.param<int>("queue_pool_block_size", 0), 0));
+  wrapper_->setQueueType(
+    nh_.param<std::string>("queue_type", "deque"), std::max(nh_.param<int>("ring_size", 1024), 1));
+  wrapper_->setOverloadPolicy(
+    nh_.param<std::string>("overload_policy", "drop_newest"),
+    static_cast<size_t>(std::max(nh_.param<int>("queue_budget_size", 0), 0)) << 20);  // MB
+  for (const auto & thread : {"sdk", "processing", "statistics", "recorder"}) {
+    wrapper_->setThreadConfig(thread, getThreadConfig(thread));
+  }
+  if (nh_.param<bool>("use_worker_pool", false)) {
+    // the first driver in the process determines the pool configuration,
+    // the workers are scheduled like the processing thread
+    auto pool = WorkerPool::getShared(
+      std::max(nh_.param<int>("worker_pool_threads", 2), 1),
+      nh_.param<std::vector<int>>("worker_pool_cpus", std::vector<int>()),
+      getThreadConfig("processing"));
+    if (!pool->getThreadConfigError().empty()) {
+      ROS_WARN_STREAM("worker pool: " << pool->getThreadConfigError());
+    }
+    wrapper_->setWorkerPool(pool);
+  }
+  wrapper_->setDirectAggregation(useDirect);
+  wrapper_->setRecorder(
+    nh_.param<std::string>("recorder_type", "sdk"),
+    nh_.param<std::string>("recording_directory", "/tmp/recordings"));
+  wrapper_->setRecorderRotation(
+    static_cast<size_t>(std::max(nh_.param<int>("recording_rotate_size", 0), 0)) << 20,  // MB
+    nh_.param<double>("recording_rotate_time", 0.0));
+  wrapper_->setRecorderBuffers(
+    static_cast<size_t>(std::max(nh_.param<int>("recording_buffer_size", 4096), 4)) << 10,  // kB
+    std::max(nh_.param<int>("recording_num_buffers", 16), 2),
+    nh_.param<bool>("recording_use_direct_io", true));
+  wrapper_->setRecorderIndexInterval(
+    static_cast<uint64_t>(std::max(nh_.param<double>("recording_index_interval", 0.1), 0.0) * 1e6));
   if (!wrapper_->initialize(
-        nh_.param<bool>("use_multithreading", false), nh_.param<std::string>("bias_file", ""))) {
+        nh_.param<bool>("use_multithreading", false), nh_.param<std::string>("bias_file", ""),
+        nh_.param<bool>("save_raw_file", false))) {
     ROS_ERROR("driver initialization failed!");
     throw std::runtime_error("driver init failed!");
   }
 
-  if (wrapper_->getSyncMode() == "secondary") {
-    ROS_INFO("secondary is decoding events...");
-    wrapper_->setDecodingEvents(true);
-  }
-
   if (frameId_.empty()) {
     // default frame id to last 4 digits of serial number
     const auto sn = wrapper_->getSerialNumber();
@@ -161,9 +355,13 @@ void DriverROS1::start()
   width_ = wrapper_->getWidth();
   height_ = wrapper_->getHeight();
   isBigEndian_ = check_endian::isBigEndian();
+  openShmRing();
+  openActivityMonitor();
+  openTriggerPublisher();
 
   // ------ start camera, may get callbacks from then on
   wrapper_->startCamera(this);
+  restartService_ = nh_.advertiseService("restart", &DriverROS1::restartStreaming, this);
 
   if (wrapper_->getFromFile().empty()) {
     initializeBiasParameters(wrapper_->getSensorVersion());
@@ -215,17 +413,164 @@ static MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(
   return (config);
 }
 
+void DriverROS1::openShmRing()
+{
+  const std::string name = nh_.param<std::string>("shm_ring_name", "");
+  if (name.empty()) {
+    return;
+  }
+  if (nh_.param<bool>("use_direct_aggregation", false)) {
+    ROS_WARN_STREAM("shared memory ring is not supported with direct aggregation!");
+    return;
+  }
+  const size_t size = static_cast<size_t>(std::max(nh_.param<int>("shm_ring_size", 64), 1)) << 20;
+  shmRing_.reset(new ShmRingWriter());
+  if (!shmRing_->open(name, size, width_, height_, encoding_)) {
+    ROS_ERROR_STREAM(shmRing_->getError());
+    shmRing_.reset();
+    return;
+  }
+  ROS_INFO_STREAM("publishing raw data to shared memory ring " << name);
+}
+
+void DriverROS1::openActivityMonitor()
+{
+  if (!nh_.param<bool>("publish_activity_map", false)) {
+    return;
+  }
+  const int tileSize = std::max(nh_.param<int>("activity_map_tile_size", 16), 1);
+  const double interval = nh_.param<double>("activity_map_interval", 1.0);
+  activityPub_ = nh_.advertise<sensor_msgs::Image>("activity_map", 1);
+  eventRatePub_ = nh_.advertise<std_msgs::Float64MultiArray>("event_rate", 1);
+  activityMonitor_ = std::make_shared<ActivityMonitor>(
+    width_, height_, tileSize, interval, 64 << 20,
+    [this](const ActivityMonitor::Snapshot & s) { publishActivity(s); },
+    [this]() {
+      return (activityPub_.getNumSubscribers() != 0 || eventRatePub_.getNumSubscribers() != 0);
+    });
+  wrapper_->setActivityMonitor(activityMonitor_);
+  ROS_INFO_STREAM("activity map with tile size " << tileSize << " every " << interval << "s");
+}
+
+void DriverROS1::openTriggerPublisher()
+{
+  if (!nh_.param<bool>("publish_triggers", false)) {
+    return;
+  }
+  if (!wrapper_->triggerInActive()) {
+    ROS_WARN("publishing triggers, but trigger_in_mode is disabled!");
+  }
+  triggerPub_ = nh_.advertise<sensor_msgs::TimeReference>("trigger", 100);
+  wrapper_->setExtractTriggers(true);
+  ROS_INFO("publishing external triggers");
+}
+
+void DriverROS1::triggerCallback(
+  uint64_t t, const EVT3TriggerScanner::Trigger * start, const EVT3TriggerScanner::Trigger * end)
+{
+  if (triggerPub_.getNumSubscribers() == 0) {
+    return;
+  }
+  for (const auto * trig = start; trig != end; trig++) {
+    sensor_msgs::TimeReference msg;
+    msg.header.frame_id = frameId_;
+    msg.header.stamp.fromNSec(t);              // arrival of the packet
+    msg.time_ref.fromNSec(trig->time * 1000);  // sensor time
+    msg.source = "trigger" + std::to_string(trig->id) + (trig->polarity ? "_rise" : "_fall");
+    triggerPub_.publish(msg);
+  }
+}
+
+void DriverROS1::publishActivity(const ActivityMonitor::Snapshot & s)
+{
+  ros::Time stamp;
+  stamp.fromNSec(s.time);
+  if (activityPub_.getNumSubscribers() != 0) {
+    sensor_msgs::ImagePtr img(new sensor_msgs::Image());
+    img->header.stamp = stamp;
+    img->header.frame_id = frameId_;
+    img->height = s.height;
+    img->width = s.width;
+    img->encoding = "32FC1";  // events per tile and interval
+    img->is_bigendian = isBigEndian_;
+    img->step = s.width * sizeof(float);
+    img->data.resize(img->step * img->height);
+    memcpy(img->data.data(), s.counts.data(), img->data.size());
+    activityPub_.publish(img);
+  }
+  if (eventRatePub_.getNumSubscribers() != 0) {
+    std_msgs::Float64MultiArrayPtr rate(new std_msgs::Float64MultiArray());
+    std_msgs::MultiArrayDimension dim;
+    dim.label = "polarity";  // OFF, ON
+    dim.size = 2;
+    dim.stride = 2;
+    rate->layout.dim.push_back(dim);
+    const double scale = s.duration > 0 ? 1.0 / s.duration : 0;
+    rate->data = {s.numEvents[0] * scale, s.numEvents[1] * scale};  // events/sec
+    eventRatePub_.publish(rate);
+  }
+}
+
+void DriverROS1::configureMemory()
+{
+  MemoryConfig c;
+  c.hugePages = nh_.param<std::string>("memory_huge_pages", "none");
+  c.prefault = nh_.param<bool>("memory_prefault", false);
+  c.lock = nh_.param<bool>("memory_lock", false);
+  if (c.hugePages != "none" && c.hugePages != "transparent" && c.hugePages != "explicit") {
+    ROS_WARN_STREAM("invalid memory_huge_pages: " << c.hugePages << ", using none");
+    c.hugePages = "none";
+  }
+  wrapper_->setMemoryConfig(c);
+  reserveSize_ = static_cast<size_t>(std::max(nh_.param<int>("message_reserve_size", 0), 0));
+  if (c.isDefault() || reserveSize_ == 0) {
+    return;
+  }
+  if (!messagePool_) {
+    ROS_WARN("no message pool, message buffers are not prepared!");
+    return;
+  }
+  // the pooled messages are allocated up front so that
+  // the data path does not take page faults on them
+  std::string error;
+  messagePool_->prefill(reserveSize_, c, &error);
+  ROS_INFO_STREAM("prepared message pool buffers of " << reserveSize_ << " bytes");
+  if (!error.empty()) {
+    ROS_WARN_STREAM("message pool: " << error);
+  }
+}
+
+ThreadConfig DriverROS1::getThreadConfig(const std::string & thread)
+{
+  ThreadConfig c;
+  for (const int cpu : nh_.param<std::vector<int>>(thread + "_cpus", std::vector<int>())) {
+    if (cpu >= 0) {
+      c.cpus.push_back(cpu);
+    }
+  }
+  c.policy = nh_.param<std::string>(thread + "_sched_policy", "other");
+  c.priority = nh_.param<int>(thread + "_sched_priority", 0);
+  return (c);
+}
+
 void DriverROS1::configureWrapper(const std::string & name)
 {
   wrapper_ = std::make_shared<MetavisionWrapper>(name);
   wrapper_->setSerialNumber(nh_.param<std::string>("serial", ""));
   wrapper_->setFromFile(nh_.param<std::string>("from_file", ""));
+  wrapper_->setPlayback(
+    std::max(nh_.param<double>("playback_rate", 1.0), 0.0),
+    nh_.param<bool>("playback_use_mmap", false),
+    std::max(nh_.param<int>("playback_packet_size", 65536), 2));
   wrapper_->setSyncMode(nh_.param<std::string>("sync_mode", "standalone"));
   auto roi = nh_.param<std::vector<int>>("roi", std::vector<int>());
   if (!roi.empty()) {
     ROS_INFO_STREAM("using ROI with " << (roi.size() / 4) << " rectangle(s)");
   }
   wrapper_->setROI(roi);
+  wrapper_->setSoftwareFilter(
+    nh_.param<std::vector<int>>("software_roi", std::vector<int>()),
+    nh_.param<std::string>("pixel_mask_file", ""));
   ROS_INFO_STREAM("sync mode: " << wrapper_->getSyncMode());
   // disabled, enabled, loopback
   wrapper_->setExternalTriggerInMode(nh_.param<std::string>("trigger_in_mode", "disabled"));
@@ -248,60 +593,78 @@ void DriverROS1::configureWrapper(const std::string & name)
   }
 }
 
-void DriverROS1::rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end)
+void DriverROS1::setHeader(EventPacketMsg & msg, uint64_t seq, uint64_t stamp)
 {
-  if (eventPub_.getNumSubscribers() != 0) {
-    if (!msg_) {
-      msg_.reset(new EventPacketMsg());
-      msg_->header.frame_id = frameId_;
-      msg_->header.seq = seq_++;
-      msg_->time_base = 0;  // not used here
-      msg_->encoding = encoding_;
-      msg_->seq = msg_->header.seq;
-      msg_->width = width_;
-      msg_->height = height_;
-      msg_->header.stamp = ros::Time().fromNSec(t);
-      msg_->events.reserve(reserveSize_);
-    }
-    const size_t n = end - start;
-    auto & events = msg_->events;
-    const size_t oldSize = events.size();
-    resize_hack(events, oldSize + n);
-    memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
-
-    if (t - lastMessageTime_ > messageThresholdTime_ || events.size() > messageThresholdSize_) {
-      reserveSize_ = std::max(reserveSize_, events.size());
-      wrapper_->updateBytesSent(events.size());
-      wrapper_->updateMsgsSent(1);
-      eventPub_.publish(std::move(msg_));
-      lastMessageTime_ = t;
-      msg_.reset();
-    }
+  msg.header.seq = seq;
+  msg.header.stamp = ros::Time().fromNSec(stamp);
+}
+
+void DriverROS1::submitMessage(EventPacketMsg::Ptr msg)
+{
+  if (compressor_) {
+    compressor_->submit(std::move(msg));
   } else {
-    if (msg_) {
-      msg_.reset();
-    }
+    eventPub_.publish(msg);
+    msg.reset();  // back to the pool unless a subscriber holds on to it
   }
+  updateMessagePoolStatistics();
 }
 
-void DriverROS1::eventCDCallback(
-  uint64_t, const Metavision::EventCD * start, const Metavision::EventCD * end)
+DriverROS1::EventPacketMsg::Ptr DriverROS1::newMessage(size_t reserveSize)
 {
-  // This callback will only be exercised during startup on the
-  // secondary until good data is available. The moment good time stamps
-  // are available we disable decoding and use the raw interface.
-  bool hasZeroTime(false);
-  for (auto e = start; e != end; e++) {
-    if (e->t == 0) {
-      hasZeroTime = true;
-      break;
-    }
+  if (!messagePool_) {
+    EventPacketMsg::Ptr msg(new EventPacketMsg());
+    msg->events.reserve(reserveSize);
+    return (msg);
+  }
+  // the deleter hands the message back to the pool once the
+  // last subscriber has released it
+  auto pool = messagePool_;
+  return (EventPacketMsg::Ptr(pool->get(reserveSize).release(), [pool](EventPacketMsg * m) {
+    pool->put(std::unique_ptr<EventPacketMsg>(m));
+  }));
+}
+
+void DriverROS1::statisticsCallback(const Statistics & stats)
+{
+  // called from the statistics thread, not from the data path
+  if (!publishStatistics_ || diagnosticsPub_.getNumSubscribers() == 0) {
+    return;
+  }
+  diagnostic_msgs::DiagnosticArray::Ptr msg(new diagnostic_msgs::DiagnosticArray());
+  msg->header.stamp = ros::Time::now();
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = ros::this_node::getName() + ": statistics";
+  status.hardware_id = wrapper_->getSerialNumber();
+  const bool lossy =
+    stats.msgsDropped != 0 || stats.poolExhausted != 0 || stats.recordingDropped != 0 ||
+    stats.ercThrottled;
+  status.level =
+    lossy ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = stats.ercThrottled ? "overload, erc rate lowered"
+                   : lossy              ? "dropping data or pool exhausted"
+                                        : "ok";
+  auto kvs = toKeyValues(stats);
+  if (compressor_) {
+    size_t bytesIn, bytesOut;
+    compressor_->getAndResetStatistics(&bytesIn, &bytesOut);
+    const double ratio = bytesOut != 0 ? static_cast<double>(bytesIn) / bytesOut : 0;
+    kvs.emplace_back("compression ratio", std::to_string(ratio));
   }
-  if (!hasZeroTime) {
-    // finally the primary is up, no longer need the expensive decoding
-    ROS_INFO("secondary sees primary up!");
-    wrapper_->setDecodingEvents(false);
+  for (const auto & kv : kvs) {
+    diagnostic_msgs::KeyValue v;
+    v.key = kv.first;
+    v.value = kv.second;
+    status.values.push_back(v);
   }
+  msg->status.push_back(status);
+  diagnosticsPub_.publish(msg);
+}
+
+void DriverROS1::eventCDCallback(uint64_t, const Metavision::EventCD *, const Metavision::EventCD *)
+{
+  // Not used: until the secondary has a sync clock, the wrapper drops
+  // packets by looking at the raw time words, without decoding events.
 }
 
 }  // namespace metavision_driver
@@ -18,6 +18,7 @@
 #include <chrono>
 #include <event_camera_msgs/msg/event_packet.hpp>
 #include <map>
+#include <new>
 #include <rclcpp/parameter_events_filter.hpp>
 #include <rclcpp_components/register_node_macro.hpp>
 #include <rclcpp/qos.hpp>
@@ -36,24 +37,85 @@ DriverROS2::DriverROS2(const rclcpp::NodeOptions & options)
     rclcpp::NodeOptions(options).automatically_declare_parameters_from_overrides(true))
 {
   configureWrapper(get_name());
-
-  this->get_parameter_or("encoding", encoding_, std::string("evt3"));
-  if (encoding_ != "evt3") {
-    LOG_ERROR("invalid encoding: " << encoding_);
+  timeKeeper_.reset(new ROSTimeKeeper(get_name()));
+
+  std::string encoding;
+  this->get_parameter_or("encoding", encoding, std::string("evt3"));
+  PacketCodec::Type codecType;
+  int codecLevel;
+  std::string codecError;
+  if (!PacketCodec::parse(encoding, &codecType, &codecLevel, &codecError)) {
+    LOG_ERROR(codecError);
     throw std::runtime_error("invalid encoding!");
   }
+  encoding_ = "evt3";  // messages are filled with raw EVT3, compression comes later
   double mtt;
   this->get_parameter_or("event_message_time_threshold", mtt, 1e-3);
   messageThresholdTime_ = uint64_t(std::abs(mtt) * 1e9);
   int64_t mts;
   this->get_parameter_or("event_message_size_threshold", mts, int64_t(1000000000));
   messageThresholdSize_ = static_cast<size_t>(std::abs(mts));
+  std::string batchingMode;
+  this->get_parameter_or("message_batching_mode", batchingMode, std::string("static"));
+  if (batchingMode == "adaptive") {
+    double latencyTarget, maxRate;
+    this->get_parameter_or("batching_latency_target", latencyTarget, 5e-3);
+    this->get_parameter_or("batching_max_message_rate", maxRate, 1000.0);
+    int64_t maxSize;
+    this->get_parameter_or("batching_max_message_size", maxSize, int64_t(4 * 1024 * 1024));
+    batching_.reset(new BatchingController(
+      uint64_t(std::abs(latencyTarget) * 1e9), std::abs(maxRate),
+      static_cast<size_t>(std::abs(maxSize))));
+    messageThresholdTime_ = batching_->getTimeThreshold();
+    messageThresholdSize_ = batching_->getSizeThreshold();
+    LOG_INFO(
+      "adaptive batching with latency target " << latencyTarget << "s, max message rate "
+                                               << maxRate << "Hz, max size " << maxSize);
+  } else if (batchingMode != "static") {
+    LOG_WARN("invalid message batching mode: " << batchingMode << ", using static");
+  }
 
   int qs;
   this->get_parameter_or("send_queue_size", qs, 1000);
   eventPub_ = this->create_publisher<EventPacketMsg>(
     "~/events", rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+  bool useLoans;
+  this->get_parameter_or("use_loaned_messages", useLoans, false);
+  if (useLoans) {
+    // the middleware decides if it can loan memory for this message type
+    // compressed messages are allocated and filled on the compression threads
+    useLoanedMessages_ = eventPub_->can_loan_messages() && codecType == PacketCodec::NONE;
+    if (useLoanedMessages_) {
+      LOG_INFO("loaned messages are enabled");
+    } else {
+      LOG_WARN("loaned messages are not available, publishing regular messages");
+    }
+  }
+  int msgPoolSize;
+  this->get_parameter_or("message_pool_size", msgPoolSize, 16);
+  // With intra-process communication the subscribers take ownership
+  // of the message and it cannot be recycled.
+  if (msgPoolSize > 0 && !options.use_intra_process_comms()) {
+    messagePool_ = std::make_shared<MessagePool<EventPacketMsg>>(msgPoolSize);
+  }
+  configureMemory();
+  if (codecType != PacketCodec::NONE) {
+    int numThreads;
+    this->get_parameter_or("compression_threads", numThreads, 1);
+    numThreads = std::max(numThreads, 1);
+    compressor_ = std::make_unique<CompressionPool<EventPacketMsg::UniquePtr>>(
+      codecType, codecLevel, numThreads, 4 * numThreads,
+      [this](EventPacketMsg::UniquePtr msg) { publishUniqueMessage(std::move(msg)); });
+    LOG_INFO("publishing " << encoding << " with " << numThreads << " compression threads");
+  }
 
+  std::string syncGroup;
+  this->get_parameter_or("sync_group", syncGroup, std::string(""));
+  if (!syncGroup.empty() && wrapper_->getSyncMode() != "standalone") {
+    // all drivers of the group run in this process: no ROS round trip
+    syncGroup_ = SyncGroup::get(syncGroup);
+    LOG_INFO("using in-process sync group: " << syncGroup);
+  }
   if (wrapper_->getSyncMode() == "primary") {
     this->get_parameter_or("num_secondary_nodes", numSecondaryNodes_, 5);
     LOG_INFO("Num of secondary nodes: " << std::to_string(numSecondaryNodes_));
@@ -63,7 +125,13 @@ DriverROS2::DriverROS2(const rclcpp::NodeOptions & options)
   }
 
 
-  if (wrapper_->getSyncMode() == "primary") {
+  if (wrapper_->getSyncMode() == "primary" && syncGroup_) {
+    // started by the last secondary to report in, or right away
+    syncGroup_->onSecondariesReady(numSecondaryNodes_, [this]() {
+      LOG_INFO("All secondary nodes are up!");
+      start();
+    });
+  } else if (wrapper_->getSyncMode() == "primary") {
     // delay primary until secondary is up and running
     // need to delay this to finish the constructor and release the thread
     // rmw_qos_profile_t qosProf = rmw_qos_profile_default.reliable();
@@ -90,6 +158,9 @@ DriverROS2::DriverROS2(const rclcpp::NodeOptions & options)
         // start();  // only now can this be started
       });
     */
+  } else if (wrapper_->getSyncMode() == "secondary" && syncGroup_) {
+    start();
+    syncGroup_->secondaryReady(this->get_fully_qualified_name());
   } else if (wrapper_->getSyncMode() == "secondary") {
     start();
     // creation of server signals to primary that we are ready.
@@ -116,8 +187,17 @@ DriverROS2::DriverROS2(const rclcpp::NodeOptions & options)
 
 DriverROS2::~DriverROS2()
 {
-  stop();
+  if (syncGroup_) {
+    syncGroup_->cancel();
+  }
+  stop();  // no more packets from here on
+  // publishes what is still pending, which needs the wrapper for the statistics
+  compressor_.reset();
+  if (hasLoan_) {
+    endLoan();  // returns the loan before the publisher goes
+  }
   wrapper_.reset();  // invoke destructor
+  activityMonitor_.reset();
 }
 
 void DriverROS2::readyCallback(const std_msgs::msg::Int16::SharedPtr msg)
@@ -191,6 +271,48 @@ void DriverROS2::saveBiases(
   response->message += (response->success ? "succeeded" : "failed");
 }
 
+void DriverROS2::restartStreaming(
+  const std::shared_ptr<Trigger::Request> request,
+  const std::shared_ptr<Trigger::Response> response)
+{
+  (void)request;
+  response->success = false;
+  response->message = "restart ";
+  if (wrapper_) {
+    response->success = wrapper_->restartStreaming();
+  }
+  response->message += (response->success ? "succeeded" : "failed");
+}
+
+// camera settings other than the biases that can be changed while streaming
+static const std::vector<std::string> cameraParameters = {
+  "roi", "erc_mode", "erc_rate", "mipi_frame_period"};
+
+static bool checkCameraParameter(const rclcpp::Parameter & p, std::string * reason)
+{
+  using PT = rclcpp::ParameterType;
+  const std::string & name = p.get_name();
+  if (name == "roi") {
+    if (p.get_type() != PT::PARAMETER_INTEGER_ARRAY || p.as_integer_array().size() % 4 != 0) {
+      *reason = "roi must be an integer array with a length that is a multiple of 4";
+      return (false);
+    }
+  } else if (name == "erc_mode") {
+    if (
+      p.get_type() != PT::PARAMETER_STRING ||
+      (p.as_string() != "enabled" && p.as_string() != "disabled" && p.as_string() != "na")) {
+      *reason = "erc_mode must be one of enabled, disabled, na";
+      return (false);
+    }
+  } else if (name == "erc_rate" || name == "mipi_frame_period") {
+    if (p.get_type() != PT::PARAMETER_INTEGER || p.as_int() <= 0) {
+      *reason = name + " must be a positive integer";
+      return (false);
+    }
+  }
+  return (true);
+}
+
 rcl_interfaces::msg::SetParametersResult DriverROS2::parameterChanged(
   const std::vector<rclcpp::Parameter> & params)
 {
@@ -198,6 +320,10 @@ rcl_interfaces::msg::SetParametersResult DriverROS2::parameterChanged(
   res.successful = false;
   res.reason = "not set";
   for (const auto & p : params) {
+    if (!checkCameraParameter(p, &res.reason)) {
+      res.successful = false;
+      return (res);
+    }
     const auto it = biasParameters_.find(p.get_name());
     if (it != biasParameters_.end()) {
       if (wrapper_) {
@@ -222,25 +348,82 @@ void DriverROS2::onParameterEvent(std::shared_ptr<const rcl_interfaces::msg::Par
   for (auto it = biasParameters_.begin(); it != biasParameters_.end(); ++it) {
     validEvents.push_back(it->first);
   }
+  validEvents.insert(validEvents.end(), cameraParameters.begin(), cameraParameters.end());
   // need to make copy to work around Foxy API
   auto ev = std::make_shared<rcl_interfaces::msg::ParameterEvent>(*event);
   rclcpp::ParameterEventsFilter filter(
     ev, validEvents, {rclcpp::ParameterEventsFilter::EventType::CHANGED});
+  std::map<std::string, int> values;
+  std::map<std::string, rclcpp::Parameter> cameraValues;
   for (auto & it : filter.get_events()) {
     const std::string & name = it.second->name;
-    const auto bp_it = biasParameters_.find(name);
-    if (bp_it != biasParameters_.end()) {
-      if (wrapper_) {
-        // apply bias to SDK. The driver may adjust the parameter value!
-        const int oldVal = wrapper_->getBias(name);
-        const int val = it.second->value.integer_value;
-        if (oldVal != val) {
-          const int newVal = wrapper_->setBias(name, val);
-          if (val != newVal) {
-            // communicate adjusted value to ROS world
-            this->set_parameter(rclcpp::Parameter(name, newVal));
-          }
-        }
+    if (biasParameters_.find(name) != biasParameters_.end()) {
+      values[name] = static_cast<int>(it.second->value.integer_value);
+    } else {
+      cameraValues[name] = rclcpp::Parameter::from_parameter_msg(*it.second);
+    }
+  }
+  if (!wrapper_) {
+    return;
+  }
+  if (!values.empty()) {
+    // apply all biases to SDK at once. The driver may adjust the parameter values!
+    const auto newValues = wrapper_->setBiases(values);
+    for (const auto & v : newValues) {
+      if (v.second != values[v.first]) {
+        // communicate adjusted value to ROS world
+        this->set_parameter(rclcpp::Parameter(v.first, v.second));
+      }
+    }
+  }
+  if (!cameraValues.empty()) {
+    applyCameraParameters(cameraValues);
+  }
+}
+
+void DriverROS2::declareCameraParameters()
+{
+  // Only declared here if not given at startup, since changing
+  // requires the parameter to be declared. Same defaults as in
+  // configureWrapper().
+  if (!this->has_parameter("roi")) {
+    this->declare_parameter("roi", rclcpp::ParameterValue(std::vector<int64_t>()));
+  }
+  if (!this->has_parameter("erc_mode")) {
+    this->declare_parameter("erc_mode", rclcpp::ParameterValue(std::string("na")));
+  }
+  if (!this->has_parameter("erc_rate")) {
+    this->declare_parameter("erc_rate", rclcpp::ParameterValue(100000000));
+  }
+  if (!this->has_parameter("mipi_frame_period")) {
+    this->declare_parameter("mipi_frame_period", rclcpp::ParameterValue(-1));
+  }
+}
+
+void DriverROS2::applyCameraParameters(const std::map<std::string, rclcpp::Parameter> & params)
+{
+  auto it = params.find("roi");
+  if (it != params.end()) {
+    const auto & r = it->second.as_integer_array();
+    if (!wrapper_->updateROI(std::vector<int>(r.begin(), r.end()))) {
+      // communicate the ROI still in effect to ROS world
+      const auto roi = wrapper_->getROI();
+      this->set_parameter(rclcpp::Parameter("roi", std::vector<int64_t>(roi.begin(), roi.end())));
+    }
+  }
+  if (params.count("erc_mode") != 0 || params.count("erc_rate") != 0) {
+    // mode and rate are always set together
+    wrapper_->updateEventRateController(
+      this->get_parameter("erc_mode").as_string(),
+      static_cast<int>(this->get_parameter("erc_rate").as_int()));
+  }
+  it = params.find("mipi_frame_period");
+  if (it != params.end()) {
+    const int period = wrapper_->updateMIPIFramePeriod(static_cast<int>(it->second.as_int()));
+    if (period > 0) {
+      resetBatching_ = true;  // packets now arrive at a different cadence
+      if (period != it->second.as_int()) {
+        this->set_parameter(rclcpp::Parameter("mipi_frame_period", period));
       }
     }
   }
@@ -314,23 +497,102 @@ void DriverROS2::start()
   double printInterval;
   this->get_parameter_or("statistics_print_interval", printInterval, 1.0);
   wrapper_->setStatisticsInterval(printInterval);
+  bool latencyStats;
+  this->get_parameter_or("latency_statistics", latencyStats, false);
+  wrapper_->setLatencyStatistics(latencyStats);
+  std::string cutMode;
+  this->get_parameter_or("message_cut_mode", cutMode, std::string("host"));
+  cutOnSensorTime_ = (cutMode == "sensor");
+  if (cutMode != "host" && cutMode != "sensor") {
+    LOG_WARN("invalid message_cut_mode: " << cutMode << ", using host time!");
+  }
+  std::string stampMode;
+  this->get_parameter_or("time_stamp_mode", stampMode, std::string("host"));
+  stampOnSensorTime_ = (stampMode == "sensor");
+  if (stampMode != "host" && stampMode != "sensor") {
+    LOG_WARN("invalid time_stamp_mode: " << stampMode << ", using host time!");
+  }
+  bool logStats;
+  this->get_parameter_or("log_statistics", logStats, true);
+  wrapper_->setLogStatistics(logStats);
+  bool publishStats;
+  this->get_parameter_or("publish_statistics", publishStats, false);
+  if (publishStats) {
+    diagnosticsPub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+      "/diagnostics", rclcpp::QoS(rclcpp::KeepLast(10)));
+  }
+  int poolSize;
+  this->get_parameter_or("queue_pool_size", poolSize, 512);
+  int poolBlockSize;
+  this->get_parameter_or("queue_pool_block_size", poolBlockSize, 0);
+  wrapper_->setQueuePool(std::max(poolSize, 0), std::max(poolBlockSize, 0));
+  std::string queueType;
+  this->get_parameter_or("queue_type", queueType, std::string("deque"));
+  int ringSize;
+  this->get_parameter_or("ring_size", ringSize, 1024);
+  wrapper_->setQueueType(queueType, std::max(ringSize, 1));
+  std::string overloadPolicy;
+  this->get_parameter_or("overload_policy", overloadPolicy, std::string("drop_newest"));
+  int queueBudget;
+  this->get_parameter_or("queue_budget_size", queueBudget, 0);
+  wrapper_->setOverloadPolicy(
+    overloadPolicy, static_cast<size_t>(std::max(queueBudget, 0)) << 20);  // MB
+  for (const auto & thread : {"sdk", "processing", "statistics", "recorder"}) {
+    wrapper_->setThreadConfig(thread, getThreadConfig(thread));
+  }
+  bool useWorkerPool;
+  this->get_parameter_or("use_worker_pool", useWorkerPool, false);
+  if (useWorkerPool) {
+    int numWorkers;
+    this->get_parameter_or("worker_pool_threads", numWorkers, 2);
+    std::vector<int64_t> cpusLong;
+    this->get_parameter_or("worker_pool_cpus", cpusLong, std::vector<int64_t>());
+    const std::vector<int> cpus(cpusLong.begin(), cpusLong.end());
+    // the first driver in the process determines the pool configuration,
+    // the workers are scheduled like the processing thread
+    auto pool = WorkerPool::getShared(std::max(numWorkers, 1), cpus, getThreadConfig("processing"));
+    if (!pool->getThreadConfigError().empty()) {
+      LOG_WARN("worker pool: " << pool->getThreadConfigError());
+    }
+    wrapper_->setWorkerPool(pool);
+  }
+  bool useDirect;
+  this->get_parameter_or("use_direct_aggregation", useDirect, false);
+  wrapper_->setDirectAggregation(useDirect);
+  if ((cutOnSensorTime_ || stampOnSensorTime_) && useDirect) {
+    LOG_WARN("sensor time message cut/stamp is not supported with direct aggregation!");
+    cutOnSensorTime_ = false;
+    stampOnSensorTime_ = false;
+  }
   std::string biasFile;
   this->get_parameter_or("bias_file", biasFile, std::string(""));
   bool saveRawFile;
   this->get_parameter_or("save_raw_file", saveRawFile, false);
+  std::string recorderType;
+  this->get_parameter_or("recorder_type", recorderType, std::string("sdk"));
+  std::string recordingDir;
+  this->get_parameter_or("recording_directory", recordingDir, std::string("/tmp/recordings"));
+  wrapper_->setRecorder(recorderType, recordingDir);
+  int rotateSize;  // in MB
+  this->get_parameter_or("recording_rotate_size", rotateSize, 0);
+  double rotateTime;
+  this->get_parameter_or("recording_rotate_time", rotateTime, 0.0);
+  wrapper_->setRecorderRotation(static_cast<size_t>(std::max(rotateSize, 0)) << 20, rotateTime);
+  int recBufSize;  // in kB
+  this->get_parameter_or("recording_buffer_size", recBufSize, 4096);
+  int recNumBuf;
+  this->get_parameter_or("recording_num_buffers", recNumBuf, 16);
+  bool recDirectIO;
+  this->get_parameter_or("recording_use_direct_io", recDirectIO, true);
+  wrapper_->setRecorderBuffers(
+    static_cast<size_t>(std::max(recBufSize, 4)) << 10, std::max(recNumBuf, 2), recDirectIO);
+  double indexInterval;  // in sec
+  this->get_parameter_or("recording_index_interval", indexInterval, 0.1);
+  wrapper_->setRecorderIndexInterval(static_cast<uint64_t>(std::max(indexInterval, 0.0) * 1e6));
   if (!wrapper_->initialize(useMT, biasFile, saveRawFile)) {
     LOG_ERROR("driver initialization failed!");
     throw std::runtime_error("driver initialization failed!");
   }
-  if (wrapper_->getSyncMode() == "secondary") {
-    // For Gen3 the secondary will produce data with time stamps == 0
-    // until it sees a clock signal. To filter out those events we
-    // decode the events and wait until the time stamps are good.
-    // Only then do we switch to "raw" mode.
-    LOG_INFO("secondary is decoding events...");
-    wrapper_->setDecodingEvents(true);
-  }
-
   if (frameId_.empty()) {
     // default frame id to last 4 digits of serial number
     const auto sn = wrapper_->getSerialNumber();
@@ -349,12 +611,19 @@ void DriverROS2::start()
   width_ = wrapper_->getWidth();
   height_ = wrapper_->getHeight();
   isBigEndian_ = check_endian::isBigEndian();
+  openShmRing();
+  openActivityMonitor();
+  openTriggerPublisher();
 
   // ------ start camera, may get callbacks from then on
   wrapper_->startCamera(this);
+  restartService_ = this->create_service<Trigger>(
+    "restart",
+    std::bind(&DriverROS2::restartStreaming, this, std::placeholders::_1, std::placeholders::_2));
 
   if (wrapper_->getFromFile().empty()) {
     declareBiasParameters(wrapper_->getSensorVersion());
+    declareCameraParameters();
     callbackHandle_ = this->add_on_set_parameters_callback(
       std::bind(&DriverROS2::parameterChanged, this, std::placeholders::_1));
     parameterSubscription_ = rclcpp::AsyncParametersClient::on_parameter_event(
@@ -375,6 +644,94 @@ bool DriverROS2::stop()
   return false;
 }
 
+void DriverROS2::openActivityMonitor()
+{
+  bool publishActivity;
+  this->get_parameter_or("publish_activity_map", publishActivity, false);
+  if (!publishActivity) {
+    return;
+  }
+  int tileSize;
+  this->get_parameter_or("activity_map_tile_size", tileSize, 16);
+  double interval;
+  this->get_parameter_or("activity_map_interval", interval, 1.0);
+  activityPub_ = this->create_publisher<sensor_msgs::msg::Image>(
+    "~/activity_map", rclcpp::QoS(rclcpp::KeepLast(1)));
+  eventRatePub_ = this->create_publisher<std_msgs::msg::Float64MultiArray>(
+    "~/event_rate", rclcpp::QoS(rclcpp::KeepLast(1)));
+  activityMonitor_ = std::make_shared<ActivityMonitor>(
+    width_, height_, std::max(tileSize, 1), interval, 64 << 20,
+    [this](const ActivityMonitor::Snapshot & s) { publishActivity(s); },
+    [this]() {
+      return (
+        activityPub_->get_subscription_count() != 0 ||
+        eventRatePub_->get_subscription_count() != 0);
+    });
+  wrapper_->setActivityMonitor(activityMonitor_);
+  LOG_INFO("activity map with tile size " << tileSize << " every " << interval << "s");
+}
+
+void DriverROS2::openTriggerPublisher()
+{
+  bool publishTriggers;
+  this->get_parameter_or("publish_triggers", publishTriggers, false);
+  if (!publishTriggers) {
+    return;
+  }
+  if (!wrapper_->triggerInActive()) {
+    LOG_WARN("publishing triggers, but trigger_in_mode is disabled!");
+  }
+  triggerPub_ = this->create_publisher<sensor_msgs::msg::TimeReference>(
+    "~/trigger", rclcpp::QoS(rclcpp::KeepLast(100)));
+  wrapper_->setExtractTriggers(true);
+  LOG_INFO("publishing external triggers");
+}
+
+void DriverROS2::triggerCallback(
+  uint64_t t, const EVT3TriggerScanner::Trigger * start, const EVT3TriggerScanner::Trigger * end)
+{
+  if (triggerPub_->get_subscription_count() == 0) {
+    return;
+  }
+  for (const auto * trig = start; trig != end; trig++) {
+    auto msg = std::make_unique<sensor_msgs::msg::TimeReference>();
+    msg->header.frame_id = frameId_;
+    msg->header.stamp = rclcpp::Time(t, RCL_SYSTEM_TIME);              // arrival of the packet
+    msg->time_ref = rclcpp::Time(trig->time * 1000, RCL_SYSTEM_TIME);  // sensor time
+    msg->source = "trigger" + std::to_string(trig->id) + (trig->polarity ? "_rise" : "_fall");
+    triggerPub_->publish(std::move(msg));
+  }
+}
+
+void DriverROS2::publishActivity(const ActivityMonitor::Snapshot & s)
+{
+  const rclcpp::Time stamp(s.time, RCL_SYSTEM_TIME);
+  if (activityPub_->get_subscription_count() != 0) {
+    auto img = std::make_unique<sensor_msgs::msg::Image>();
+    img->header.stamp = stamp;
+    img->header.frame_id = frameId_;
+    img->height = s.height;
+    img->width = s.width;
+    img->encoding = "32FC1";  // events per tile and interval
+    img->is_bigendian = isBigEndian_;
+    img->step = s.width * sizeof(float);
+    img->data.resize(img->step * img->height);
+    memcpy(img->data.data(), s.counts.data(), img->data.size());
+    activityPub_->publish(std::move(img));
+  }
+  if (eventRatePub_->get_subscription_count() != 0) {
+    auto rate = std::make_unique<std_msgs::msg::Float64MultiArray>();
+    std_msgs::msg::MultiArrayDimension dim;
+    dim.label = "polarity";  // OFF, ON
+    dim.size = 2;
+    dim.stride = 2;
+    rate->layout.dim.push_back(dim);
+    const double scale = s.duration > 0 ? 1.0 / s.duration : 0;
+    rate->data = {s.numEvents[0] * scale, s.numEvents[1] * scale};  // events/sec
+    eventRatePub_->publish(std::move(rate));
+  }
+}
+
 static MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(rclcpp::Node * node)
 {
   MetavisionWrapper::HardwarePinConfig config;
@@ -396,6 +753,77 @@ static MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(rclcpp::Node
   return (config);
 }
 
+void DriverROS2::openShmRing()
+{
+  std::string name;
+  this->get_parameter_or("shm_ring_name", name, std::string(""));
+  if (name.empty()) {
+    return;
+  }
+  bool useDirect;
+  this->get_parameter_or("use_direct_aggregation", useDirect, false);
+  if (useDirect) {
+    LOG_WARN("shared memory ring is not supported with direct aggregation!");
+    return;
+  }
+  int sizeMB;
+  this->get_parameter_or("shm_ring_size", sizeMB, 64);
+  shmRing_ = std::make_unique<ShmRingWriter>();
+  if (!shmRing_->open(
+        name, static_cast<size_t>(std::max(sizeMB, 1)) << 20, width_, height_, encoding_)) {
+    LOG_ERROR(shmRing_->getError());
+    shmRing_.reset();
+    return;
+  }
+  LOG_INFO("publishing raw data to shared memory ring " << name);
+}
+
+void DriverROS2::configureMemory()
+{
+  MemoryConfig c;
+  this->get_parameter_or("memory_huge_pages", c.hugePages, std::string("none"));
+  this->get_parameter_or("memory_prefault", c.prefault, false);
+  this->get_parameter_or("memory_lock", c.lock, false);
+  if (c.hugePages != "none" && c.hugePages != "transparent" && c.hugePages != "explicit") {
+    LOG_WARN("invalid memory_huge_pages: " << c.hugePages << ", using none");
+    c.hugePages = "none";
+  }
+  wrapper_->setMemoryConfig(c);
+  int64_t reserveSize;
+  this->get_parameter_or("message_reserve_size", reserveSize, int64_t(0));
+  reserveSize_ = static_cast<size_t>(std::max(reserveSize, int64_t(0)));
+  if (c.isDefault() || reserveSize_ == 0) {
+    return;
+  }
+  if (!messagePool_) {
+    LOG_WARN("no message pool, message buffers are not prepared!");
+    return;
+  }
+  // the pooled messages are allocated up front so that
+  // the data path does not take page faults on them
+  std::string error;
+  messagePool_->prefill(reserveSize_, c, &error);
+  LOG_INFO("prepared message pool buffers of " << reserveSize_ << " bytes");
+  if (!error.empty()) {
+    LOG_WARN("message pool: " << error);
+  }
+}
+
+ThreadConfig DriverROS2::getThreadConfig(const std::string & thread)
+{
+  ThreadConfig c;
+  std::vector<int64_t> cpus;
+  this->get_parameter_or(thread + "_cpus", cpus, std::vector<int64_t>());
+  for (const auto cpu : cpus) {
+    if (cpu >= 0) {
+      c.cpus.push_back(static_cast<int>(cpu));
+    }
+  }
+  this->get_parameter_or(thread + "_sched_policy", c.policy, std::string("other"));
+  this->get_parameter_or(thread + "_sched_priority", c.priority, 0);
+  return (c);
+}
+
 void DriverROS2::configureWrapper(const std::string & name)
 {
   wrapper_ = std::make_shared<MetavisionWrapper>(name);
@@ -405,6 +833,13 @@ void DriverROS2::configureWrapper(const std::string & name)
   std::string fromFile;
   this->get_parameter_or("from_file", fromFile, std::string(""));
   wrapper_->setFromFile(fromFile);
+  double playbackRate;
+  this->get_parameter_or("playback_rate", playbackRate, 1.0);
+  bool useMmap;
+  this->get_parameter_or("playback_use_mmap", useMmap, false);
+  int playbackPacketSize;
+  this->get_parameter_or("playback_packet_size", playbackPacketSize, 65536);
+  wrapper_->setPlayback(std::max(playbackRate, 0.0), useMmap, std::max(playbackPacketSize, 2));
   std::string syncMode;
   this->get_parameter_or("sync_mode", syncMode, std::string("standalone"));
   wrapper_->setSyncMode(syncMode);
@@ -419,6 +854,12 @@ void DriverROS2::configureWrapper(const std::string & name)
     }
   }
   wrapper_->setROI(r);
+  std::vector<int64_t> softwareRoi;
+  this->get_parameter_or("software_roi", softwareRoi, std::vector<int64_t>());
+  std::string pixelMaskFile;
+  this->get_parameter_or("pixel_mask_file", pixelMaskFile, std::string(""));
+  wrapper_->setSoftwareFilter(
+    std::vector<int>(softwareRoi.begin(), softwareRoi.end()), pixelMaskFile);
   std::string tInMode;
   this->get_parameter_or("trigger_in_mode", tInMode, std::string("disabled"));
   if (tInMode != "disabled") {
@@ -455,58 +896,111 @@ void DriverROS2::configureWrapper(const std::string & name)
   wrapper_->setMIPIFramePeriod(mipiFramePeriod);
 }
 
-void DriverROS2::rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end)
+void DriverROS2::setHeader(EventPacketMsg & msg, uint64_t, uint64_t stamp)
 {
-  if (eventPub_->get_subscription_count() > 0) {
-    if (!msg_) {
-      msg_.reset(new EventPacketMsg());
-      msg_->header.frame_id = frameId_;
-      msg_->time_base = 0;  // not used here
-      msg_->encoding = encoding_;
-      msg_->seq = seq_++;
-      msg_->width = width_;
-      msg_->height = height_;
-      msg_->header.stamp = rclcpp::Time(t, RCL_SYSTEM_TIME);
-      msg_->events.reserve(reserveSize_);
-    }
-    const size_t n = end - start;
-    auto & events = msg_->events;
-    const size_t oldSize = events.size();
-    resize_hack(events, oldSize + n);
-    memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
-
-    if (t - lastMessageTime_ > messageThresholdTime_ || events.size() > messageThresholdSize_) {
-      reserveSize_ = std::max(reserveSize_, events.size());
-      eventPub_->publish(std::move(msg_));
-      lastMessageTime_ = t;
-      wrapper_->updateBytesSent(events.size());
-      wrapper_->updateMsgsSent(1);
-    }
+  msg.header.stamp = rclcpp::Time(stamp, RCL_SYSTEM_TIME);
+}
+
+DriverROS2::EventPacketMsg * DriverROS2::borrowMessage()
+{
+  if (!useLoanedMessages_) {
+    return (nullptr);
+  }
+  // message will be filled in place in middleware-owned memory
+  new (&loanedMsgStorage_) LoanedMsg(eventPub_->borrow_loaned_message());
+  hasLoan_ = true;
+  return (&loanedMsg().get());
+}
+
+void DriverROS2::publishBorrowedMessage()
+{
+  eventPub_->publish(std::move(loanedMsg()));
+  endLoan();
+}
+
+void DriverROS2::releaseBorrowedMessage()
+{
+  endLoan();  // returns the loan
+}
+
+void DriverROS2::endLoan()
+{
+  loanedMsg().~LoanedMsg();  // no-op once the message has been published
+  hasLoan_ = false;
+}
+
+DriverROS2::EventPacketMsg::UniquePtr DriverROS2::newMessage(size_t reserveSize)
+{
+  if (messagePool_) {
+    return (messagePool_->get(reserveSize));
+  }
+  EventPacketMsg::UniquePtr msg(new EventPacketMsg());
+  msg->events.reserve(reserveSize);
+  return (msg);
+}
+
+void DriverROS2::publishUniqueMessage(EventPacketMsg::UniquePtr msg)
+{
+  if (messagePool_) {
+    // without intra-process communication the message is
+    // serialized during publish() and can be reused afterwards
+    eventPub_->publish(*msg);
+    messagePool_->put(std::move(msg));
+    updateMessagePoolStatistics();
   } else {
-    if (msg_) {
-      msg_.reset();
-    }
+    eventPub_->publish(std::move(msg));
   }
 }
 
-void DriverROS2::eventCDCallback(
-  uint64_t, const Metavision::EventCD * start, const Metavision::EventCD * end)
+void DriverROS2::submitMessage(EventPacketMsg::UniquePtr msg)
 {
-  // This callback will only be exercised during startup on the
-  // secondary until good data is available. The moment good time stamps
-  // are available we disable decoding and use the raw interface.
-  bool hasZeroTime(false);
-  for (auto e = start; e != end; e++) {
-    if (e->t == 0) {
-      hasZeroTime = true;
-      break;
-    }
+  if (compressor_) {
+    compressor_->submit(std::move(msg));
+  } else {
+    publishUniqueMessage(std::move(msg));
   }
-  if (!hasZeroTime) {
-    // finally the primary is up, no longer need the expensive decoding
-    LOG_INFO("secondary sees primary up!");
-    wrapper_->setDecodingEvents(false);
+}
+
+void DriverROS2::statisticsCallback(const Statistics & stats)
+{
+  // called from the statistics thread, not from the data path
+  if (!diagnosticsPub_ || diagnosticsPub_->get_subscription_count() == 0) {
+    return;
+  }
+  auto msg = std::make_unique<diagnostic_msgs::msg::DiagnosticArray>();
+  msg->header.stamp = this->get_clock()->now();
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.name = std::string(this->get_fully_qualified_name()) + ": statistics";
+  status.hardware_id = wrapper_->getSerialNumber();
+  const bool lossy =
+    stats.msgsDropped != 0 || stats.poolExhausted != 0 || stats.recordingDropped != 0 ||
+    stats.ercThrottled;
+  status.level = lossy ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                       : diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.message = stats.ercThrottled ? "overload, erc rate lowered"
+                   : lossy              ? "dropping data or pool exhausted"
+                                        : "ok";
+  auto kvs = toKeyValues(stats);
+  if (compressor_) {
+    size_t bytesIn, bytesOut;
+    compressor_->getAndResetStatistics(&bytesIn, &bytesOut);
+    const double ratio = bytesOut != 0 ? static_cast<double>(bytesIn) / bytesOut : 0;
+    kvs.emplace_back("compression ratio", std::to_string(ratio));
   }
+  for (const auto & kv : kvs) {
+    diagnostic_msgs::msg::KeyValue v;
+    v.key = kv.first;
+    v.value = kv.second;
+    status.values.push_back(v);
+  }
+  msg->status.push_back(status);
+  diagnosticsPub_->publish(std::move(msg));
+}
+
+void DriverROS2::eventCDCallback(uint64_t, const Metavision::EventCD *, const Metavision::EventCD *)
+{
+  // Not used: until the secondary has a sync clock, the wrapper drops
+  // packets by looking at the raw time words, without decoding events.
 }
 
 }  // namespace metavision_driver
@@ -0,0 +1,375 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/evt3_filter.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "metavision_driver/evt3_scanner.h"
+
+namespace metavision_driver
+{
+static inline uint16_t getWord(const uint8_t * data, size_t i)
+{
+  uint16_t w;
+  memcpy(&w, data + 2 * i, sizeof(w));  // EVT3 is little endian
+  return (w);
+}
+
+static inline void putWord(uint8_t * data, size_t i, uint16_t w)
+{
+  memcpy(data + 2 * i, &w, sizeof(w));
+}
+
+// returns index of the first ADDR_Y word at or after word index i, or numWords
+static size_t findAddrY(const uint8_t * data, size_t i, size_t numWords)
+{
+  // ADDR_Y is type 0, so the upper 4 bits of the word are all zero
+#if defined(__AVX2__)
+  const __m256i typeMask = _mm256_set1_epi16(static_cast<int16_t>(0xF000));
+  const __m256i zero = _mm256_setzero_si256();
+  for (; i + 16 <= numWords; i += 16) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 2 * i));
+    const __m256i isY = _mm256_cmpeq_epi16(_mm256_and_si256(v, typeMask), zero);
+    const uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(isY));
+    if (m != 0) {
+      return (i + __builtin_ctz(m) / 2);
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i typeMask = _mm_set1_epi16(static_cast<int16_t>(0xF000));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= numWords; i += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 2 * i));
+    const __m128i isY = _mm_cmpeq_epi16(_mm_and_si128(v, typeMask), zero);
+    const uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(isY));
+    if (m != 0) {
+      return (i + __builtin_ctz(m) / 2);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint16x8_t typeMask = vdupq_n_u16(0xF000);
+  for (; i + 8 <= numWords; i += 8) {
+    uint16_t w[8];
+    memcpy(w, data + 2 * i, sizeof(w));
+    const uint16x8_t v = vld1q_u16(w);
+    if (vminvq_u16(vtstq_u16(v, typeMask)) == 0) {
+      break;  // the scalar loop below finds the exact word
+    }
+  }
+#endif
+  for (; i < numWords; i++) {
+    if (evt3::type(getWord(data, i)) == evt3::ADDR_Y) {
+      return (i);
+    }
+  }
+  return (numWords);
+}
+
+EVT3Filter::EVT3Filter(int width, int height)
+: width_(static_cast<uint32_t>(std::max(width, 0))),
+  height_(static_cast<uint32_t>(std::max(height, 0)))
+{
+  // the extra word lets a vector that starts near the end of a word
+  // read its remaining bits without a bounds check
+  wordsPerRow_ = (width_ + 63) / 64 + 1;
+  keep_.resize(wordsPerRow_ * height_, 0);
+  for (uint32_t y = 0; y < height_; y++) {
+    uint64_t * row = &keep_[y * wordsPerRow_];
+    for (uint32_t x = 0; x < width_; x += 64) {
+      const uint32_t n = std::min(width_ - x, 64U);
+      row[x / 64] = n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1);
+    }
+  }
+  updateRowModes();
+}
+
+bool EVT3Filter::setROI(const std::vector<int> & roi, std::string * error)
+{
+  if (roi.empty()) {
+    return (true);
+  }
+  if (roi.size() % 4 != 0) {
+    *error = "ROI vec must be multiple of 4, but is: " + std::to_string(roi.size());
+    return (false);
+  }
+  std::vector<uint64_t> inside(keep_.size(), 0);
+  for (size_t i = 0; i < roi.size(); i += 4) {
+    const int x0 = std::max(roi[i], 0);
+    const int y0 = std::max(roi[i + 1], 0);
+    const int x1 = std::min(roi[i] + roi[i + 2], static_cast<int>(width_));
+    const int y1 = std::min(roi[i + 1] + roi[i + 3], static_cast<int>(height_));
+    for (int y = y0; y < y1; y++) {
+      uint64_t * row = &inside[y * wordsPerRow_];
+      for (int x = x0; x < x1; x++) {
+        row[x / 64] |= uint64_t(1) << (x % 64);
+      }
+    }
+  }
+  for (size_t i = 0; i < keep_.size(); i++) {
+    numMasked_ += __builtin_popcountll(keep_[i] & ~inside[i]);
+    keep_[i] &= inside[i];
+  }
+  updateRowModes();
+  return (true);
+}
+
+bool EVT3Filter::loadPixelMask(const std::string & fileName, std::string * error)
+{
+  std::ifstream in(fileName);
+  if (!in.is_open()) {
+    *error = "cannot open pixel mask file: " + fileName;
+    return (false);
+  }
+  std::string line;
+  for (size_t lineNum = 1; std::getline(in, line); lineNum++) {
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
+    }
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream ss(line);
+    int x, y;
+    if (!(ss >> x >> y)) {
+      *error = fileName + ":" + std::to_string(lineNum) + ": expected x and y: " + line;
+      return (false);
+    }
+    if (x < 0 || y < 0 || x >= static_cast<int>(width_) || y >= static_cast<int>(height_)) {
+      *error = fileName + ":" + std::to_string(lineNum) + ": pixel outside of sensor: " + line;
+      return (false);
+    }
+    maskPixel(x, y);
+  }
+  updateRowModes();
+  return (true);
+}
+
+void EVT3Filter::maskPixel(int x, int y)
+{
+  uint64_t & w = keep_[y * wordsPerRow_ + x / 64];
+  const uint64_t bit = uint64_t(1) << (x % 64);
+  if (w & bit) {
+    w &= ~bit;
+    numMasked_++;
+  }
+}
+
+void EVT3Filter::updateRowModes()
+{
+  rowMode_.resize(height_);
+  for (uint32_t y = 0; y < height_; y++) {
+    const uint64_t * row = &keep_[y * wordsPerRow_];
+    uint32_t numKept = 0;
+    for (size_t i = 0; i < wordsPerRow_; i++) {
+      numKept += __builtin_popcountll(row[i]);
+    }
+    rowMode_[y] = numKept == width_ ? ROW_ENABLED : (numKept == 0 ? ROW_MASKED : ROW_PARTIAL);
+  }
+}
+
+inline uint32_t EVT3Filter::getKeepBits(uint32_t x, uint32_t numBits) const
+{
+  if (x >= width_) {
+    return (0);
+  }
+  const uint64_t * row = &keep_[y_ * wordsPerRow_];
+  const uint32_t shift = x % 64;
+  uint64_t bits = row[x / 64] >> shift;
+  if (shift + numBits > 64) {
+    bits |= row[x / 64 + 1] << (64 - shift);
+  }
+  return (static_cast<uint32_t>(bits) & ((1U << numBits) - 1));
+}
+
+inline void EVT3Filter::writeWord(uint8_t * out, size_t * k, uint16_t w)
+{
+  putWord(out, *k, w);
+  (*k)++;
+}
+
+inline void EVT3Filter::writePending(uint8_t * out, size_t * k)
+{
+  if (yPending_) {
+    writeWord(out, k, yWord_);
+    yPending_ = false;
+  }
+  if (basePending_) {
+    writeWord(out, k, static_cast<uint16_t>((evt3::VECT_BASE_X << 12) | polarity_ | baseX_));
+    basePending_ = false;
+  }
+}
+
+void EVT3Filter::copyRun(const uint8_t * in, size_t numWords, uint8_t * out)
+{
+  // The words pass unchanged, but the vector base must be tracked in
+  // case a later row needs it. Find the last VECT_BASE_X from the back.
+  uint32_t advance = 0;
+  for (size_t i = numWords; i > 0; i--) {
+    const uint16_t w = getWord(in, i - 1);
+    const uint8_t t = evt3::type(w);
+    if (t == evt3::VECT_12) {
+      advance += 12;
+    } else if (t == evt3::VECT_8) {
+      advance += 8;
+    } else if (t == evt3::VECT_BASE_X) {
+      baseX_ = w & 0x07FF;
+      polarity_ = w & 0x0800;
+      break;
+    }
+  }
+  baseX_ += advance;
+  if (out != in) {
+    memmove(out, in, numWords * 2);
+  }
+}
+
+size_t EVT3Filter::compactRun(const uint8_t * in, size_t numWords, uint8_t * out)
+{
+  size_t k = 0;
+  for (size_t i = 0; i < numWords; i++) {
+    const uint16_t w = getWord(in, i);
+    switch (evt3::type(w)) {
+      case evt3::ADDR_X:
+        break;
+      case evt3::VECT_BASE_X:
+        baseX_ = w & 0x07FF;
+        polarity_ = w & 0x0800;
+        basePending_ = true;
+        break;
+      case evt3::VECT_12:
+        baseX_ += 12;
+        basePending_ = true;
+        break;
+      case evt3::VECT_8:
+        baseX_ += 8;
+        basePending_ = true;
+        break;
+      default:
+        putWord(out, k++, w);
+        break;
+    }
+  }
+  return (k);
+}
+
+size_t EVT3Filter::filter(const uint8_t * in, size_t numBytes, uint8_t * out)
+{
+  // Words are only ever written to positions at or before the word being
+  // read: every ADDR_Y or VECT_BASE_X that is written late takes the
+  // place of a word that was dropped earlier.
+  const size_t numWords = numBytes / 2;
+  size_t i = 0;  // read position (words)
+  size_t k = 0;  // write position (words)
+  while (i < numWords) {
+    if (mode_ != ROW_PARTIAL) {
+      // bulk processing up to where the next row starts
+      const size_t j = findAddrY(in, i, numWords);
+      if (mode_ == ROW_ENABLED) {
+        if (j != i) {
+          writePending(out, &k);
+          copyRun(in + 2 * i, j - i, out + 2 * k);
+          k += j - i;
+        }
+      } else {
+        k += compactRun(in + 2 * i, j - i, out + 2 * k);
+      }
+      i = j;
+      if (i == numWords) {
+        break;
+      }
+    }
+    const uint16_t w = getWord(in, i++);
+    const uint8_t t = evt3::type(w);
+    switch (t) {
+      case evt3::ADDR_Y:
+        y_ = w & 0x07FF;
+        yWord_ = w;
+        mode_ = y_ < height_ ? rowMode_[y_] : static_cast<uint8_t>(ROW_MASKED);
+        yPending_ = true;
+        if (mode_ == ROW_ENABLED) {
+          writeWord(out, &k, w);
+          yPending_ = false;
+        }
+        break;
+      case evt3::ADDR_X:
+        if (getKeepBits(w & 0x07FF, 1)) {
+          if (yPending_) {
+            writeWord(out, &k, yWord_);
+            yPending_ = false;
+          }
+          writeWord(out, &k, w);
+        }
+        break;
+      case evt3::VECT_BASE_X:
+        baseX_ = w & 0x07FF;
+        polarity_ = w & 0x0800;
+        basePending_ = true;
+        break;
+      case evt3::VECT_12:
+      case evt3::VECT_8: {
+        const uint32_t n = t == evt3::VECT_12 ? 12 : 8;
+        const uint16_t valid = static_cast<uint16_t>((1U << n) - 1);
+        const uint16_t bits = static_cast<uint16_t>(w & valid & getKeepBits(baseX_, n));
+        if (bits != 0) {
+          writePending(out, &k);
+          writeWord(out, &k, static_cast<uint16_t>((w & ~valid) | bits));
+        } else {
+          basePending_ = true;  // the downstream base falls behind
+        }
+        baseX_ += n;
+        break;
+      }
+      default:
+        writeWord(out, &k, w);
+        break;
+    }
+  }
+  // Settle what is owed while there is still room for it. A pending
+  // ADDR_Y is only needed again if the row is partially enabled.
+  if (basePending_) {
+    writeWord(out, &k, static_cast<uint16_t>((evt3::VECT_BASE_X << 12) | polarity_ | baseX_));
+    basePending_ = false;
+  }
+  if (yPending_ && mode_ == ROW_PARTIAL) {
+    writeWord(out, &k, yWord_);
+    yPending_ = false;
+  }
+  size_t numOut = 2 * k;
+  if (numBytes % 2 != 0) {
+    out[numOut++] = in[numBytes - 1];
+  }
+  return (numOut);
+}
+
+void EVT3Filter::reset()
+{
+  mode_ = ROW_MASKED;  // row is unknown until the next ADDR_Y
+  y_ = 0;
+  yWord_ = 0;
+  baseX_ = 0;
+  polarity_ = 0;
+  yPending_ = false;
+  basePending_ = false;
+}
+}  // namespace metavision_driver
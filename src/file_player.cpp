@@ -0,0 +1,164 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/file_player.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "metavision_driver/evt3_scanner.h"
+
+namespace metavision_driver
+{
+FilePlayer::~FilePlayer()
+{
+  stop();
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+bool FilePlayer::open(const std::string & fileName)
+{
+  const int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error_ = "cannot open file " + fileName + ": " + strerror(errno);
+    return (false);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    error_ = "cannot stat or empty file: " + fileName;
+    close(fd);
+    return (false);
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  void * p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // mapping stays valid
+  if (p == MAP_FAILED) {
+    error_ = "cannot mmap file " + fileName + ": " + strerror(errno);
+    size_ = 0;
+    return (false);
+  }
+  data_ = static_cast<uint8_t *>(p);
+  madvise(data_, size_, MADV_SEQUENTIAL);
+  return (parseHeader());
+}
+
+bool FilePlayer::parseHeader()
+{
+  // the header consists of lines starting with '%', ending with "% end"
+  bool isEVT3 = false;
+  size_t pos = 0;
+  while (pos < size_ && data_[pos] == '%') {
+    const uint8_t * eol = static_cast<const uint8_t *>(memchr(data_ + pos, '\n', size_ - pos));
+    const size_t lineEnd = eol ? static_cast<size_t>(eol - data_) : size_;
+    const std::string line(reinterpret_cast<const char *>(data_ + pos), lineEnd - pos);
+    pos = std::min(lineEnd + 1, size_);
+    int w, h;
+    char buf[256];
+    if (sscanf(line.c_str(), "%% geometry %dx%d", &w, &h) == 2) {
+      width_ = w;
+      height_ = h;
+    } else if (sscanf(line.c_str(), "%% format EVT3;height=%d;width=%d", &h, &w) == 2) {
+      width_ = w;
+      height_ = h;
+      isEVT3 = true;
+    } else if (line.rfind("% evt 3.0", 0) == 0) {
+      isEVT3 = true;
+    } else if (sscanf(line.c_str(), "%% serial_number %255s", buf) == 1) {
+      serialNumber_ = buf;
+    } else if (line.rfind("% end", 0) == 0) {
+      break;
+    }
+  }
+  dataOffset_ = pos;
+  if (!isEVT3) {
+    error_ = "file is not in EVT3 format!";
+    return (false);
+  }
+  if (width_ <= 0 || height_ <= 0) {
+    error_ = "file header has no sensor geometry!";
+    return (false);
+  }
+  return (true);
+}
+
+void FilePlayer::start(const Callback & callback, const std::function<void()> & onEnd)
+{
+  callback_ = callback;
+  onEnd_ = onEnd;
+  keepRunning_ = true;
+  thread_ = std::make_shared<std::thread>(&FilePlayer::playbackThread, this);
+}
+
+void FilePlayer::stop()
+{
+  if (thread_) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      keepRunning_ = false;
+      cv_.notify_all();
+    }
+    thread_->join();
+    thread_.reset();
+  }
+}
+
+void FilePlayer::playbackThread()
+{
+  EVT3Scanner scanner;
+  const uint8_t * p = data_ + dataOffset_;
+  const uint8_t * end = p + ((size_ - dataOffset_) & ~size_t(1));
+  bool hasStartTime = false;
+  uint64_t t0Sensor = 0;
+  std::chrono::steady_clock::time_point t0Wall;
+  while (p < end) {
+    const size_t n = std::min(packetSize_, static_cast<size_t>(end - p));
+    if (playbackRate_ > 0) {
+      // deliver the packet once the sensor time of its last event has come
+      scanner.scan(p, n);
+      if (scanner.hasValidTime()) {
+        if (!hasStartTime) {
+          t0Sensor = scanner.getTime();
+          t0Wall = std::chrono::steady_clock::now();
+          hasStartTime = true;
+        }
+        const auto due = t0Wall + std::chrono::microseconds(static_cast<int64_t>(
+                                    (scanner.getTime() - t0Sensor) / playbackRate_));
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_until(lock, due, [this] { return (!keepRunning_); });
+      }
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!keepRunning_) {
+        return;
+      }
+    }
+    callback_(p, n);
+    p += n;
+  }
+  if (onEnd_) {
+    onEnd_();
+  }
+}
+}  // namespace metavision_driver
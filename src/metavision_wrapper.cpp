@@ -28,9 +28,13 @@
 #include <metavision/hal/facilities/i_plugin_software_info.h>
 #include <metavision/hal/facilities/i_trigger_in.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdarg>
+#include <cstdio>
 #include <filesystem>
 #include <map>
+#include <mutex>
 #include <set>
 #include <thread>
 
@@ -40,7 +44,9 @@
 #define GENERIC_ROS_OK() (rclcpp::ok())
 #endif
 
+#include "metavision_driver/evt3_time_check.h"
 #include "metavision_driver/logging.h"
+#include "metavision_driver/resize_hack.h"
 
 namespace metavision_driver
 {
@@ -63,6 +69,52 @@ static const std::map<std::string, Metavision::I_TriggerIn::Channel> channelMap
 static const std::map<std::string, uint32_t> sensorToMIPIAddress = {
   {"IMX636", 0xB028}, {"Gen3.1", 0x1508}};
 
+// Cameras opened so far by this process, keyed by the serial number
+// asked for ("" for the first available one). A wrapper that is created
+// again, e.g. when a composable node gets reloaded, opens the cached
+// serial directly instead of running the device discovery, and skips
+// the queries of the device identity.
+struct DeviceInfo
+{
+  std::string serialNumber;
+  std::string softwareInfo;
+  std::string sensorVersion;
+  std::string sensorName;
+};
+static std::mutex deviceCacheMutex;
+static std::map<std::string, DeviceInfo> deviceCache;
+
+static bool findCachedDevice(const std::string & requested, DeviceInfo * info)
+{
+  std::unique_lock<std::mutex> lock(deviceCacheMutex);
+  const auto it = deviceCache.find(requested);
+  if (it == deviceCache.end()) {
+    return (false);
+  }
+  *info = it->second;
+  return (true);
+}
+
+static void updateDeviceCache(const std::string & requested, const DeviceInfo * info)
+{
+  std::unique_lock<std::mutex> lock(deviceCacheMutex);
+  if (info) {
+    deviceCache[requested] = *info;
+  } else {
+    deviceCache.erase(requested);
+  }
+}
+
+static void append_fmt(std::string * s, const char * fmt, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  *s += buf;
+}
+
 static std::string to_lower(const std::string upper)
 {
   std::string lower(upper);
@@ -78,13 +130,36 @@ MetavisionWrapper::MetavisionWrapper(const std::string & loggerName)
 
 MetavisionWrapper::~MetavisionWrapper() { }
 
+// biases that must not be changed at runtime
+static const std::set<std::string> dontTouchBiases = {{"bias_diff"}};
+
+const std::map<std::string, int> & MetavisionWrapper::biasTable()
+{
+  // Reading the biases means register traffic over USB, and that
+  // competes with the event stream. Only read them again after a write.
+  if (!biasCacheValid_) {
+    Metavision::Biases & biases = cam_.biases();
+    Metavision::I_LL_Biases * hw_biases = biases.get_facility();
+    const auto pmap = hw_biases->get_all_biases();
+    biasCache_.clear();
+    biasCache_.insert(pmap.begin(), pmap.end());
+    biasCacheValid_ = true;
+  }
+  return (biasCache_);
+}
+
+std::map<std::string, int> MetavisionWrapper::getBiases()
+{
+  std::unique_lock<std::mutex> lock(biasMutex_);
+  return (biasTable());
+}
+
 int MetavisionWrapper::getBias(const std::string & name)
 {
-  const Metavision::Biases biases = cam_.biases();
-  Metavision::I_LL_Biases * hw_biases = biases.get_facility();
-  const auto pmap = hw_biases->get_all_biases();
-  auto it = pmap.find(name);
-  if (it == pmap.end()) {
+  std::unique_lock<std::mutex> lock(biasMutex_);
+  const auto & table = biasTable();
+  auto it = table.find(name);
+  if (it == table.end()) {
     LOG_ERROR_NAMED("unknown bias parameter: " << name);
     throw(std::runtime_error("bias parameter not found!"));
   }
@@ -93,33 +168,72 @@ int MetavisionWrapper::getBias(const std::string & name)
 
 bool MetavisionWrapper::hasBias(const std::string & name)
 {
-  Metavision::Biases & biases = cam_.biases();
-  Metavision::I_LL_Biases * hw_biases = biases.get_facility();
-  const auto pmap = hw_biases->get_all_biases();
-  auto it = pmap.find(name);
-  return (it != pmap.end());
+  std::unique_lock<std::mutex> lock(biasMutex_);
+  return (biasTable().count(name) != 0);
 }
 
 int MetavisionWrapper::setBias(const std::string & name, int val)
 {
-  std::set<std::string> dont_touch_set = {{"bias_diff"}};
-  if (dont_touch_set.count(name) != 0) {
+  if (dontTouchBiases.count(name) != 0) {
     LOG_WARN_NAMED("ignoring change to parameter: " << name);
     return (val);
   }
+  std::unique_lock<std::mutex> lock(biasMutex_);
+  const auto & table = biasTable();
+  auto it = table.find(name);
   Metavision::Biases & biases = cam_.biases();
   Metavision::I_LL_Biases * hw_biases = biases.get_facility();
-  const int prev = hw_biases->get(name);
+  const int prev = it != table.end() ? it->second : hw_biases->get(name);
   if (val != prev) {
     if (!hw_biases->set(name, val)) {
       LOG_WARN_NAMED("cannot set parameter " << name << " to " << val);
     }
   }
   const int now = hw_biases->get(name);  // read back what actually took hold
+  biasCache_[name] = now;
   LOG_INFO_NAMED("changed  " << name << " from " << prev << " to " << val << " adj to: " << now);
   return (now);
 }
 
+std::map<std::string, int> MetavisionWrapper::setBiases(const std::map<std::string, int> & values)
+{
+  std::unique_lock<std::mutex> lock(biasMutex_);
+  Metavision::Biases & biases = cam_.biases();
+  Metavision::I_LL_Biases * hw_biases = biases.get_facility();
+  const std::map<std::string, int> prev = biasTable();
+  std::vector<std::string> changed;
+  for (const auto & v : values) {
+    auto it = prev.find(v.first);
+    if (it == prev.end()) {
+      LOG_WARN_NAMED("unknown bias parameter: " << v.first);
+    } else if (dontTouchBiases.count(v.first) != 0) {
+      LOG_WARN_NAMED("ignoring change to parameter: " << v.first);
+    } else if (v.second != it->second) {
+      if (!hw_biases->set(v.first, v.second)) {
+        LOG_WARN_NAMED("cannot set parameter " << v.first << " to " << v.second);
+      }
+      changed.push_back(v.first);
+    }
+  }
+  if (!changed.empty()) {
+    biasCacheValid_ = false;  // one read back for all of them
+  }
+  const auto & table = biasTable();
+  for (const auto & name : changed) {
+    LOG_INFO_NAMED(
+      "changed  " << name << " from " << prev.at(name) << " to " << values.at(name)
+                  << " adj to: " << table.at(name));
+  }
+  std::map<std::string, int> result;
+  for (const auto & v : values) {
+    auto it = table.find(v.first);
+    if (it != table.end()) {
+      result.insert(*it);
+    }
+  }
+  return (result);
+}
+
 bool MetavisionWrapper::initialize(bool useMultithreading, const std::string & biasFile, bool saveRawFile)
 {
   biasFile_ = biasFile;
@@ -133,15 +247,63 @@ bool MetavisionWrapper::initialize(bool useMultithreading, const std::string & b
   return (true);
 }
 
-bool MetavisionWrapper::stop()
+bool MetavisionWrapper::restartStreaming()
 {
-  if (!cam_.stop_recording()) {
-    LOG_ERROR_NAMED("Camera raw recording could not be stopped!");
+  std::unique_lock<std::mutex> lock(restartMutex_);
+  if (!callbackHandler_) {
+    LOG_WARN_NAMED("camera not started, cannot restart!");
+    return (false);
   }
+  try {
+    LOG_INFO_NAMED("restarting stream");
+    if (player_) {
+      player_->stop();
+    } else if (cam_.is_running()) {
+      cam_.stop();
+    }
+    // no SDK callbacks until the start, so the state is safe to touch
+    restartPending_ = true;
+    triggerScanner_.reset();
+    sdkThreadConfigured_ = false;  // the SDK may deliver from a new thread
+    if (player_) {
+      player_->start(
+        std::bind(getRawDataCallback(), this, ph::_1, ph::_2),
+        [this]() { LOG_INFO_NAMED("end of file reached"); });
+    } else {
+      cam_.start();
+    }
+  } catch (const Metavision::CameraException & e) {
+    LOG_ERROR_NAMED("restart failed: " << e.what());
+    return (false);
+  }
+  return (true);
+}
+
+void MetavisionWrapper::resetStreamState()
+{
+  if (filter_) {
+    filter_->reset();
+  }
+  callbackHandler_->resetStream();
+}
+
+bool MetavisionWrapper::stop()
+{
   bool status = false;
-  if (cam_.is_running()) {
-    cam_.stop();
-    status = true;
+  if (player_) {
+    status = player_->isRunning();
+    player_->stop();
+  } else {
+    if (!recorder_ && !cam_.stop_recording()) {
+      LOG_ERROR_NAMED("Camera raw recording could not be stopped!");
+    }
+    if (cam_.is_running()) {
+      cam_.stop();
+      status = true;
+    }
+  }
+  if (recorder_) {
+    recorder_->stop();  // no more SDK callbacks at this point
   }
   if (rawDataCallbackActive_) {
     cam_.raw_data().remove_callback(rawDataCallbackId_);
@@ -157,6 +319,10 @@ bool MetavisionWrapper::stop()
   }
 
   keepRunning_ = false;
+  if (worker_) {
+    workerPool_->remove(this);
+    worker_ = nullptr;
+  }
   if (processingThread_) {
     {
       std::unique_lock<std::mutex> lock(mutex_);
@@ -165,6 +331,16 @@ bool MetavisionWrapper::stop()
     processingThread_->join();
     processingThread_.reset();
   }
+  // return whatever the processing did not get to
+  for (const auto & qe : queue_) {
+    pool_.release(qe.buffer);
+  }
+  queue_.clear();
+  QueueElement qe;
+  while (ring_ && ring_->pop(&qe)) {
+    pool_.release(qe.buffer);
+  }
+  queueBytes_ = 0;
   if (statsThread_) {
     {
       std::unique_lock<std::mutex> lock(mutex_);
@@ -176,11 +352,12 @@ bool MetavisionWrapper::stop()
   return (status);
 }
 
-void MetavisionWrapper::applyROI(const std::vector<int> & roi)
+bool MetavisionWrapper::applyROI(const std::vector<int> & roi)
 {
   if (!roi.empty()) {
     if (roi.size() % 4 != 0) {
       LOG_ERROR_NAMED("ROI vec must be multiple of 4, but is: " << roi.size());
+      return (false);
     } else {
 #ifdef CHECK_IF_OUTSIDE_ROI
       x_min_ = std::numeric_limits<uint16_t>::max();
@@ -213,6 +390,62 @@ void MetavisionWrapper::applyROI(const std::vector<int> & roi)
     y_max_ = std::numeric_limits<uint16_t>::max();
 #endif
   }
+  return (true);
+}
+
+bool MetavisionWrapper::updateROI(const std::vector<int> & roi)
+{
+  if (!fromFile_.empty()) {
+    LOG_WARN_NAMED("cannot change ROI when playing from file!");
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock(configMutex_);
+  try {
+    if (roi.empty()) {
+      cam_.roi().unset();
+    } else if (!applyROI(roi)) {
+      return (false);
+    }
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("failed to change ROI: " << e.what());
+    return (false);
+  }
+  roi_ = roi;
+  LOG_INFO_NAMED("ROI changed to " << (roi.size() / 4) << " rectangle(s)");
+  return (true);
+}
+
+std::vector<int> MetavisionWrapper::getROI()
+{
+  std::unique_lock<std::mutex> lock(configMutex_);
+  return (roi_);
+}
+
+void MetavisionWrapper::initializeFilter()
+{
+  if (filterROI_.empty() && pixelMaskFile_.empty()) {
+    return;
+  }
+  if (encodingFormat_ != "evt3") {
+    LOG_WARN_NAMED("software filter requires evt3 encoding, but is: " << encodingFormat_);
+    return;
+  }
+  std::unique_ptr<EVT3Filter> filter(new EVT3Filter(width_, height_));
+  std::string error;
+  if (
+    !filter->setROI(filterROI_, &error) ||
+    (!pixelMaskFile_.empty() && !filter->loadPixelMask(pixelMaskFile_, &error))) {
+    LOG_ERROR_NAMED("software filter disabled: " << error);
+    return;
+  }
+  if (!filter->isActive()) {
+    LOG_INFO_NAMED("software filter masks no pixels, not using it");
+    return;
+  }
+  LOG_INFO_NAMED(
+    "software filter masks " << filter->getNumMaskedPixels() << " of " << width_ * height_
+                             << " pixels");
+  filter_ = std::move(filter);
 }
 
 void MetavisionWrapper::applySyncMode(const std::string & mode)
@@ -283,7 +516,7 @@ void MetavisionWrapper::configureExternalTriggers(
   }
 }
 
-void MetavisionWrapper::configureEventRateController(
+bool MetavisionWrapper::configureEventRateController(
   const std::string & mode, const int events_per_sec)
 {
   if (mode == "enabled" || mode == "disabled") {
@@ -293,21 +526,167 @@ void MetavisionWrapper::configureEventRateController(
       i_erc->set_cd_event_rate(events_per_sec);
     } else {
       LOG_WARN_NAMED("cannot set event rate control for this camera!");
+      return (false);
+    }
+  }
+  return (true);
+}
+
+bool MetavisionWrapper::updateEventRateController(const std::string & mode, int rate)
+{
+  if (!fromFile_.empty()) {
+    LOG_WARN_NAMED("cannot change event rate control when playing from file!");
+    return (false);
+  }
+  if (mode != "enabled" && mode != "disabled" && mode != "na") {
+    LOG_WARN_NAMED("invalid erc mode: " << mode);
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock(configMutex_);
+  // while the overload policy throttles, only apply the new setting
+  // if it is lower than the throttled rate, otherwise it just becomes
+  // the ceiling the throttle recovers to
+  const bool throttled = ercThrottledRate_ != 0;
+  const bool apply = !throttled || (mode == "enabled" && rate <= ercThrottledRate_);
+  try {
+    if (apply && !configureEventRateController(mode == "na" ? "disabled" : mode, rate)) {
+      return (false);
+    }
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("failed to change event rate control: " << e.what());
+    return (false);
+  }
+  ercMode_ = mode;
+  ercRate_ = rate;
+  if (throttled) {
+    if (apply) {
+      ercThrottledRate_ = 0;  // the new setting is below the throttle
+    } else if (mode == "enabled") {
+      ercThrottleCeiling_ = rate;
     }
   }
+  LOG_INFO_NAMED("erc mode changed to " << mode << " with rate " << rate << " ev/s");
+  return (true);
+}
+
+MetavisionWrapper::RawCallback MetavisionWrapper::getRawDataCallback() const
+{
+  if (useMultithreading_) {
+    return (
+      useDirectAggregation_ ? &MetavisionWrapper::rawDataCallbackDirect
+                            : &MetavisionWrapper::rawDataCallbackMultithreaded);
+  }
+  return (&MetavisionWrapper::rawDataCallback);
+}
+
+void MetavisionWrapper::updateErcThrottle(Statistics * stats)
+{
+  // Throttling at the sensor keeps the data from crossing USB in the
+  // first place, which is much cheaper than dropping it in the driver.
+  const int minRate = 100000;
+  std::unique_lock<std::mutex> lock(configMutex_);
+  int rate = ercThrottledRate_;
+  if (stats->overloads != 0) {
+    if (rate == 0) {
+      // start from the configured rate, or if ERC is off, from the
+      // incoming rate (one event takes up at most one 16 bit EVT3 word)
+      ercThrottleCeiling_ = ercMode_ == "enabled"
+                              ? ercRate_
+                              : static_cast<int>(std::min(stats->bytesRecvRate * 0.5, 2e9));
+      rate = ercThrottleCeiling_;
+    }
+    rate = std::max(static_cast<int>(rate * 0.75), minRate);
+  } else if (rate != 0) {
+    // recover slowly once the queue keeps up
+    rate = static_cast<int>(std::min(rate * 1.1, 2e9));
+    if (rate >= ercThrottleCeiling_) {
+      rate = 0;
+    }
+  }
+  if (rate != ercThrottledRate_) {
+    if (rate != 0) {
+      LOG_WARN_NAMED("queue overload, lowering erc rate to " << rate << " ev/s");
+      configureEventRateController("enabled", rate);
+    } else {
+      LOG_INFO_NAMED("queue keeps up again, restoring erc mode " << ercMode_);
+      configureEventRateController(ercMode_ == "na" ? "disabled" : ercMode_, ercRate_);
+    }
+    ercThrottledRate_ = rate;
+  }
+  stats->ercRate = rate != 0 ? rate : ercRate_;
+  stats->ercThrottled = rate != 0;
+}
+
+void MetavisionWrapper::createRecordingPath()
+{
+  // Create folder in recording directory with timestamp.
+  std::time_t t = std::time(nullptr);
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&t));
+  recordingPath_ = recordingDirectory_ + "/" + stamp + "/evs/";
+  if (saveRawFile_) {
+    recordingPath_ += "evs" + serialNumber_ + "/";
+    std::filesystem::remove_all(recordingPath_);
+    std::filesystem::create_directories(recordingPath_);
+  }
+}
+
+bool MetavisionWrapper::initializeFilePlayer()
+{
+  // reads the raw file directly, bypassing the SDK
+  LOG_INFO_NAMED("playing back events from memory mapped file: " << fromFile_);
+  player_.reset(new FilePlayer());
+  if (!player_->open(fromFile_)) {
+    LOG_ERROR_NAMED("cannot play back file: " << player_->getError());
+    player_.reset();
+    return (false);
+  }
+  player_->setPlaybackRate(playbackRate_);
+  player_->setPacketSize(playbackPacketSize_);
+  softwareInfo_ = "file player";
+  encodingFormat_ = "evt3";
+  sensorVersion_ = "unknown";  // no tunable biases
+  serialNumber_ = player_->getSerialNumber().empty() ? "file" : player_->getSerialNumber();
+  width_ = player_->getWidth();
+  height_ = player_->getHeight();
+  LOG_INFO_NAMED("sensor geometry: " << width_ << " x " << height_);
+  LOG_INFO_NAMED(
+    "playback rate: " << playbackRate_ << (playbackRate_ > 0 ? "" : " (as fast as possible)"));
+  if (saveRawFile_ && recorderType_ != "driver") {
+    LOG_WARN_NAMED("file playback requires the driver recorder, switching to it!");
+    recorderType_ = "driver";
+  }
+  createRecordingPath();
+  return (true);
 }
 
 bool MetavisionWrapper::initializeCamera()
 {
-  const int num_tries = 5;
+  if (!fromFile_.empty() && useMmapPlayback_) {
+    return (initializeFilePlayer());
+  }
+  // Exponential backoff: a camera that is just coming up after a USB
+  // reset is usually there within a few 100ms, so retry early, but
+  // still wait for about 5s in total before giving up.
+  const int num_tries = 8;
+  const int max_delay = 2000;  // milliseconds
+  int delay = 50;
+  const std::string requestedSerial = serialNumber_;
+  DeviceInfo device;
+  bool isCached = fromFile_.empty() && findCachedDevice(requestedSerial, &device);
   for (int i = 0; i < num_tries; i++) {
     try {
       if (!fromFile_.empty()) {
         LOG_INFO_NAMED("reading events from file: " << fromFile_);
-        const auto cfg = Metavision::FileConfigHints().real_time_playback(true);
+        if (playbackRate_ != 0 && playbackRate_ != 1.0) {
+          LOG_WARN_NAMED("playback rate other than 0 or 1 requires mmap playback, using 1!");
+        }
+        const auto cfg = Metavision::FileConfigHints().real_time_playback(playbackRate_ != 0);
         cam_ = Metavision::Camera::from_file(fromFile_, cfg);
       } else {
-        if (!serialNumber_.empty()) {
+        if (isCached) {
+          cam_ = Metavision::Camera::from_serial(device.serialNumber);
+        } else if (!serialNumber_.empty()) {
           cam_ = Metavision::Camera::from_serial(serialNumber_);
         } else {
           cam_ = Metavision::Camera::from_first_available();
@@ -315,34 +694,51 @@ bool MetavisionWrapper::initializeCamera()
       }
       break;  // were able to open the camera, exit the for loop
     } catch (const Metavision::CameraException & e) {
+      if (isCached) {
+        // the camera is gone or was replaced, discover it again
+        LOG_WARN_NAMED("cannot open cached camera " << device.serialNumber);
+        updateDeviceCache(requestedSerial, nullptr);
+        isCached = false;
+      }
       const std::string src =
         fromFile_.empty() ? (serialNumber_.empty() ? "default" : serialNumber_) : fromFile_;
       if (i < num_tries - 1) {
         LOG_WARN_NAMED(
-          "cannot open " << src << " on attempt " << i + 1 << ", retrying " << num_tries - i - 1
-                         << " more times");
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+          "cannot open " << src << " on attempt " << i + 1 << ", retrying in " << delay
+                         << "ms, " << num_tries - i - 1 << " more tries");
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+        delay = std::min(2 * delay, max_delay);
       } else {
         LOG_ERROR_NAMED("cannot open " << src << ", giving up!");
       }
     }
   }
 
+  biasCacheValid_ = false;  // different camera, or biases loaded from file
   try {
-    // Record the plugin software information about the camera.
-    using PSI = Metavision::I_PluginSoftwareInfo;
-    const PSI * psi = cam_.get_device().get_facility<PSI>();
-    softwareInfo_ = psi->get_plugin_name();
-    LOG_INFO_NAMED("plugin software name: " << softwareInfo_);
     using HWI = Metavision::I_HW_Identification;
     const HWI * hwi = cam_.get_device().get_facility<HWI>();
-    const auto sinfo = hwi->get_sensor_info();
+    if (isCached) {
+      softwareInfo_ = device.softwareInfo;
+      sensorVersion_ = device.sensorVersion;
+      sensorName_ = device.sensorName;
+      LOG_INFO_NAMED("reopened cached camera " << device.serialNumber);
+    } else {
+      // Record the plugin software information about the camera.
+      using PSI = Metavision::I_PluginSoftwareInfo;
+      const PSI * psi = cam_.get_device().get_facility<PSI>();
+      softwareInfo_ = psi->get_plugin_name();
+      const auto sinfo = hwi->get_sensor_info();
+      sensorVersion_ =
+        std::to_string(sinfo.major_version_) + "." + std::to_string(sinfo.minor_version_);
+      sensorName_ = sinfo.name_;
+    }
+    LOG_INFO_NAMED("plugin software name: " << softwareInfo_);
+    // the encoding can be changed by the application, so it is not cached
     encodingFormat_ = to_lower(hwi->get_current_data_encoding_format());
     LOG_INFO_NAMED("encoding format: " << encodingFormat_);
-    sensorVersion_ =
-      std::to_string(sinfo.major_version_) + "." + std::to_string(sinfo.minor_version_);
     LOG_INFO_NAMED("sensor version: " << sensorVersion_);
-    LOG_INFO_NAMED("sensor name: " << sinfo.name_);
+    LOG_INFO_NAMED("sensor name: " << sensorName_);
     if (!biasFile_.empty()) {
       try {
         cam_.biases().set_from_file(biasFile_);
@@ -353,28 +749,40 @@ bool MetavisionWrapper::initializeCamera()
       }
     } else if (fromFile_.empty()) {  // only load biases when not playing from file!
       LOG_INFO_NAMED("no bias file provided, using camera defaults:");
-      const Metavision::Biases biases = cam_.biases();
-      Metavision::I_LL_Biases * hw_biases = biases.get_facility();
-      const auto pmap = hw_biases->get_all_biases();
-      for (const auto & bp : pmap) {
+      std::unique_lock<std::mutex> lock(biasMutex_);
+      for (const auto & bp : biasTable()) {  // also fills the cache
         LOG_INFO_NAMED("found bias param: " << bp.first << " " << bp.second);
       }
     }
     // overwrite serial in case it was not set
     serialNumber_ = cam_.get_camera_configuration().serial_number;
     LOG_INFO_NAMED("camera serial number: " << serialNumber_);
+    if (fromFile_.empty() && !isCached) {
+      device.serialNumber = serialNumber_;
+      device.softwareInfo = softwareInfo_;
+      device.sensorVersion = sensorVersion_;
+      device.sensorName = sensorName_;
+      updateDeviceCache(requestedSerial, &device);
+    }
     const auto & g = cam_.geometry();
     width_ = g.width();
     height_ = g.height();
     LOG_INFO_NAMED("sensor geometry: " << width_ << " x " << height_);
     if (fromFile_.empty()) {
       applySyncMode(syncMode_);
+      // For Gen3 the secondary will produce data with time stamps == 0
+      // until it sees a clock signal. Those packets are dropped until
+      // the raw data shows non-zero time words.
+      waitingForSync_ = (syncMode_ == "secondary");
+      if (waitingForSync_) {
+        LOG_INFO_NAMED("secondary is waiting for sync clock...");
+      }
       applyROI(roi_);
       configureExternalTriggers(
         triggerInMode_, triggerOutMode_, triggerOutPeriod_, triggerOutDutyCycle_);
       configureEventRateController(ercMode_, ercRate_);
       if (mipiFramePeriod_ > 0) {
-        configureMIPIFramePeriod(mipiFramePeriod_, sinfo.name_);
+        configureMIPIFramePeriod(mipiFramePeriod_, sensorName_);
       }
     }
     statusChangeCallbackId_ = cam_.add_status_change_callback(
@@ -383,46 +791,51 @@ bool MetavisionWrapper::initializeCamera()
     runtimeErrorCallbackId_ = cam_.add_runtime_error_callback(
       std::bind(&MetavisionWrapper::runtimeErrorCallback, this, ph::_1));
     runtimeErrorCallbackActive_ = true;
-    rawDataCallbackId_ = cam_.raw_data().add_callback(std::bind(
-      useMultithreading_ ? &MetavisionWrapper::rawDataCallbackMultithreaded
-                         : &MetavisionWrapper::rawDataCallback,
-      this, ph::_1, ph::_2));
+    rawDataCallbackId_ =
+      cam_.raw_data().add_callback(std::bind(getRawDataCallback(), this, ph::_1, ph::_2));
     rawDataCallbackActive_ = true;
   } catch (const Metavision::CameraException & e) {
     LOG_ERROR_NAMED("unexpected sdk error: " << e.what());
     return (false);
   }
 
-  // Create folder in /tmp/recordings with timestamp.
-  std::time_t t = std::time(nullptr);
-  std::tm* now = std::localtime(&t);
-  char path[250];
-  std::sprintf(path, "/tmp/recordings/%04d%02d%02d_%02d%02d%02d", now->tm_year + 1900, now->tm_mon + 1, now->tm_mday,
-               now->tm_hour, now->tm_min, now->tm_sec);
-  recordingPath_ = std::string(path);
-  recordingPath_ += "/evs/";
-  if (saveRawFile_) {
-    recordingPath_ += "evs" + serialNumber_ + "/";
-    std::filesystem::remove_all(recordingPath_);
-    std::filesystem::create_directories(recordingPath_);
-  }
-
+  createRecordingPath();
   return (true);
 }
 
-void MetavisionWrapper::configureMIPIFramePeriod(int usec, const std::string & sensorName)
+int MetavisionWrapper::configureMIPIFramePeriod(int usec, const std::string & sensorName)
 {
   const auto it = sensorToMIPIAddress.find(sensorName);
   if (it == sensorToMIPIAddress.end()) {
     LOG_WARN_NAMED("cannot configure mipi frame period for sensor " << sensorName);
-  } else {
-    const uint32_t mfpa = it->second;
-    auto hwrf = cam_.get_device().get_facility<Metavision::I_HW_Register>();
-    const int prev_mfp = hwrf->read_register(mfpa);
-    hwrf->write_register(mfpa, usec);
-    const int new_mfp = hwrf->read_register(mfpa);
-    LOG_INFO_NAMED("mipi frame period changed from " << prev_mfp << " to " << new_mfp << "us");
+    return (-1);
+  }
+  const uint32_t mfpa = it->second;
+  auto hwrf = cam_.get_device().get_facility<Metavision::I_HW_Register>();
+  const int prev_mfp = hwrf->read_register(mfpa);
+  hwrf->write_register(mfpa, usec);
+  const int new_mfp = hwrf->read_register(mfpa);
+  LOG_INFO_NAMED("mipi frame period changed from " << prev_mfp << " to " << new_mfp << "us");
+  return (new_mfp);
+}
+
+int MetavisionWrapper::updateMIPIFramePeriod(int usec)
+{
+  if (!fromFile_.empty()) {
+    LOG_WARN_NAMED("cannot change mipi frame period when playing from file!");
+    return (-1);
   }
+  std::unique_lock<std::mutex> lock(configMutex_);
+  try {
+    const int p = configureMIPIFramePeriod(usec, sensorName_);
+    if (p > 0) {
+      mipiFramePeriod_ = p;
+    }
+    return (p);
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("failed to change mipi frame period: " << e.what());
+  }
+  return (-1);
 }
 
 void MetavisionWrapper::setDecodingEvents(bool decodeEvents)
@@ -448,19 +861,131 @@ void MetavisionWrapper::setDecodingEvents(bool decodeEvents)
   }
 }
 
+bool MetavisionWrapper::startRecorder()
+{
+  recorder_.reset(new RawRecorder());
+  recorder_->setBuffers(recordingBufferSize_, recordingNumBuffers_);
+  recorder_->setRotation(recordingRotateBytes_, recordingRotateTime_);
+  recorder_->setDirectIO(recordingDirectIO_);
+  recorder_->setIndexInterval(recordingIndexInterval_);
+  std::time_t t = std::time(nullptr);
+  char date[32];
+  std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+  std::string header;
+  header += std::string("% date ") + date + "\n";
+  header += "% evt 3.0\n";
+  header += "% format EVT3;height=" + std::to_string(height_) + ";width=" +
+            std::to_string(width_) + "\n";
+  header += "% geometry " + std::to_string(width_) + "x" + std::to_string(height_) + "\n";
+  header += "% serial_number " + serialNumber_ + "\n";
+  header += "% end\n";
+  if (!recorder_->start(recordingPath_, "evs" + serialNumber_, header)) {
+    LOG_ERROR_NAMED("cannot start raw recorder in " << recordingPath_);
+    recorder_.reset();
+    return (false);
+  }
+  configureThread("recorder", recorder_->getNativeHandle());
+  LOG_INFO_NAMED("driver recording raw data to " << recordingPath_);
+  return (true);
+}
+
+void MetavisionWrapper::initializeQueuePool(size_t blockSize)
+{
+  std::string error;
+  // with the ring queue, the SDK thread must not wait for the consumer
+  pool_.initialize(poolNumBlocks_, blockSize, memoryConfig_, ring_ != nullptr, &error);
+  LOG_INFO_NAMED(
+    "allocated queue pool with " << poolNumBlocks_ << " blocks of " << blockSize << " bytes");
+  if (!error.empty()) {
+    LOG_WARN_NAMED("queue pool: " << error);
+  }
+}
+
+void MetavisionWrapper::configureThread(const std::string & name, pthread_t thread)
+{
+  auto it = threadConfig_.find(name);
+  if (it == threadConfig_.end() || it->second.isDefault()) {
+    return;
+  }
+  const ThreadConfig & c = it->second;
+  std::string error;
+  if (applyThreadConfig(thread, c, &error)) {
+    LOG_INFO_NAMED(
+      name << " thread: policy " << c.policy << " priority " << c.priority << " on "
+           << c.cpus.size() << " cpus");
+  } else {
+    LOG_WARN_NAMED("cannot configure " << name << " thread: " << error);
+  }
+}
+
 bool MetavisionWrapper::startCamera(CallbackHandler * h)
 {
   try {
     callbackHandler_ = h;
+    initializeFilter();
     if (useMultithreading_) {
-      processingThread_ = std::make_shared<std::thread>(&MetavisionWrapper::processingThread, this);
+      if (
+        overloadPolicy_ != "drop_newest" && overloadPolicy_ != "drop_oldest" &&
+        overloadPolicy_ != "erc") {
+        LOG_WARN_NAMED("invalid overload policy " << overloadPolicy_ << ", using drop_newest!");
+        overloadPolicy_ = "drop_newest";
+      }
+      if (
+        overloadPolicy_ == "erc" &&
+        (!fromFile_.empty() || !cam_.get_device().get_facility<ErcModule>())) {
+        LOG_WARN_NAMED("overload policy erc needs a camera with ERC, using drop_newest!");
+        overloadPolicy_ = "drop_newest";
+      }
+      if (overloadPolicy_ == "drop_oldest" && queueType_ == "ring") {
+        LOG_WARN_NAMED("drop_oldest is not supported by the ring, using drop_newest!");
+      }
+      void (MetavisionWrapper::*loop)() = &MetavisionWrapper::processingThread;
+      if (useDirectAggregation_) {
+        LOG_INFO_NAMED("using direct aggregation into messages");
+        loop = &MetavisionWrapper::processingThreadDirect;
+      } else if (queueType_ == "ring") {
+        ring_.reset(new SPSCRing<QueueElement>(ringSize_));
+        LOG_INFO_NAMED("using lock free ring with capacity " << ring_->capacity());
+        loop = &MetavisionWrapper::processingThreadRing;
+      } else if (queueType_ != "deque") {
+        LOG_WARN_NAMED("invalid queue type " << queueType_ << ", using deque!");
+      }
+      if (!useDirectAggregation_ && poolNumBlocks_ != 0 && poolBlockSize_ != 0) {
+        // block size is known, so allocate (and pre-fault) before the data flows
+        initializeQueuePool(poolBlockSize_);
+      }
+      if (!workerPool_) {
+        processingThread_ = std::make_shared<std::thread>(loop, this);
+        configureThread("processing", processingThread_->native_handle());
+      }
+    }
+    if (workerPool_) {
+      worker_ = workerPool_->add(this);
+      LOG_INFO_NAMED("using worker pool with " << workerPool_->getNumWorkers() << " threads");
+    } else {
+      statsThread_ = std::make_shared<std::thread>(&MetavisionWrapper::statsThread, this);
+      configureThread("statistics", statsThread_->native_handle());
     }
-    statsThread_ = std::make_shared<std::thread>(&MetavisionWrapper::statsThread, this);
     // this will actually start the camera
     if (saveRawFile_) {
-      cam_.start_recording(recordingPath_ + "evs" + serialNumber_ + ".raw");
+      if (recorderType_ == "driver") {
+        if (!startRecorder()) {
+          return (false);
+        }
+      } else {
+        if (recorderType_ != "sdk") {
+          LOG_WARN_NAMED("invalid recorder type " << recorderType_ << ", using sdk!");
+        }
+        cam_.start_recording(recordingPath_ + "evs" + serialNumber_ + ".raw");
+      }
+    }
+    if (player_) {
+      player_->start(
+        std::bind(getRawDataCallback(), this, ph::_1, ph::_2),
+        [this]() { LOG_INFO_NAMED("end of file reached"); });
+    } else {
+      cam_.start();
     }
-    cam_.start();
   } catch (const Metavision::CameraException & e) {
     LOG_ERROR_NAMED("unexpected sdk error: " << e.what());
     return (false);
@@ -501,12 +1026,29 @@ void MetavisionWrapper::rawDataCallback(const uint8_t * data, size_t size)
     const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
                          std::chrono::system_clock::now().time_since_epoch())
                          .count();
-    callbackHandler_->rawDataCallback(t, data, data + size);
-    {
-      std::unique_lock<std::mutex> lock(statsMutex_);
-      stats_.msgsRecv++;
-      stats_.bytesRecv += size;
+    configureSdkThread();
+    if (waitingForSync_ && !skipUntilSynced(&data, &size)) {
+      return;
     }
+    if (recorder_) {
+      recorder_->write(data, size, t);
+    }
+    extractTriggers(data, size, t);
+    if (takeRestart()) {
+      resetStreamState();
+    }
+    if (filter_) {
+      // the SDK buffer is read only
+      resize_hack(filterBuffer_, size);
+      const size_t n = filter_->filter(data, size, filterBuffer_.data());
+      monitorActivity(filterBuffer_.data(), n);
+      callbackHandler_->rawDataCallback(t, filterBuffer_.data(), filterBuffer_.data() + n);
+    } else {
+      monitorActivity(data, size);
+      callbackHandler_->rawDataCallback(t, data, data + size);
+    }
+    increment(&counters_.msgsRecv, 1);
+    increment(&counters_.bytesRecv, size);
   }
 }
 
@@ -518,21 +1060,171 @@ void MetavisionWrapper::rawDataCallbackMultithreaded(const uint8_t * data, size_
     const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
                          std::chrono::system_clock::now().time_since_epoch())
                          .count();
-    {
-      void * memblock = malloc(size);
-      memcpy(memblock, data, size);
+    configureSdkThread();
+    if (waitingForSync_ && !skipUntilSynced(&data, &size)) {
+      return;
+    }
+    if (recorder_) {
+      recorder_->write(data, size, t);
+    }
+    extractTriggers(data, size, t);
+    if (poolNumBlocks_ != 0 && !pool_.isInitialized()) {
+      // size the blocks from the first packet the SDK delivers,
+      // leaving head room for packets that come in larger
+      const size_t blockSize =
+        poolBlockSize_ != 0 ? poolBlockSize_ : ((2 * size + 4095) / 4096) * 4096;
+      initializeQueuePool(blockSize);
+    }
+    if (
+      queueByteBudget_ != 0 &&
+      queueBytes_.load(std::memory_order_relaxed) + size > queueByteBudget_ &&
+      !makeRoomInQueue(size)) {
+      increment(&counters_.msgsRecv, 1);
+      increment(&counters_.bytesRecv, size);
+      increment(&counters_.msgsDropped, 1);
+      increment(&counters_.bytesDropped, size);
+      return;
+    }
+    const BufferPool::Handle buffer = pool_.acquire(size);
+    memcpy(buffer.data, data, size);
+    if (queueByteBudget_ != 0) {
+      // account before the push so the consumer never subtracts first
+      queueBytes_.fetch_add(size, std::memory_order_relaxed);
+    }
+    bool dropped(false);
+    // the processing thread resets the state once it gets to this packet
+    const bool restarted = takeRestart();
+    if (ring_) {
+      if (ring_->push(QueueElement(buffer, size, t, restarted))) {
+        // the consumer only sleeps after having checked the ring, so
+        // the wakeup never needs the lock
+        if (worker_) {
+          worker_->notify();
+        } else if (consumerParked_.load()) {
+          cv_.notify_one();
+        }
+      } else {
+        // ring is full: drop the newest packet, the consumer
+        // is busy with the older ones
+        pool_.releaseByProducer(buffer);
+        if (queueByteBudget_ != 0) {
+          queueBytes_.fetch_sub(size, std::memory_order_relaxed);
+        }
+        if (restarted) {
+          restartPending_ = true;  // hand it on to the next packet
+        }
+        dropped = true;
+      }
+    } else {
       std::unique_lock<std::mutex> lock(mutex_);
-      queue_.push_front(QueueElement(memblock, size, t));
-      cv_.notify_all();
+      queue_.push_front(QueueElement(buffer, size, t, restarted));
+      notifyConsumer();
     }
-    {
-      std::unique_lock<std::mutex> lock(statsMutex_);
-      stats_.msgsRecv++;
-      stats_.bytesRecv += size;
+    increment(&counters_.msgsRecv, 1);
+    increment(&counters_.bytesRecv, size);
+    if (dropped) {
+      // a full ring is an overload, too, e.g. for the ERC throttle
+      increment(&counters_.overloads, 1);
+      increment(&counters_.msgsDropped, 1);
+      increment(&counters_.bytesDropped, size);
     }
   }
 }
 
+void MetavisionWrapper::rawDataCallbackDirect(const uint8_t * data, size_t size)
+{
+  // copy straight into the message, leave the publishing to the
+  // processing thread
+  if (size != 0) {
+    const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    configureSdkThread();
+    if (waitingForSync_ && !skipUntilSynced(&data, &size)) {
+      return;
+    }
+    if (recorder_) {
+      recorder_->write(data, size, t);
+    }
+    extractTriggers(data, size, t);
+    if (takeRestart()) {
+      resetStreamState();
+    }
+    size_t n = size;
+    if (filter_) {
+      // filter first so the message only grows by what is left
+      resize_hack(filterBuffer_, size);
+      n = filter_->filter(data, size, filterBuffer_.data());
+      data = filterBuffer_.data();
+    }
+    monitorActivity(data, n);
+    uint8_t * buffer = callbackHandler_->getWritableBuffer(t, n);
+    if (buffer) {
+      memcpy(buffer, data, n);
+      if (callbackHandler_->commitBuffer(t)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        messageReady_ = true;
+        notifyConsumer();
+      }
+    }
+    increment(&counters_.msgsRecv, 1);
+    increment(&counters_.bytesRecv, size);
+  }
+}
+
+bool MetavisionWrapper::makeRoomInQueue(size_t size)
+{
+  increment(&counters_.overloads, 1);
+  if (overloadPolicy_ != "drop_oldest" || ring_) {
+    return (false);  // drop the packet that just came in
+  }
+  // The ring cannot be popped from the producer side, so only the
+  // deque can make room by throwing away the packets queued first.
+  size_t numDropped = 0;
+  size_t bytesDropped = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (
+      !queue_.empty() && queueBytes_.load(std::memory_order_relaxed) + size > queueByteBudget_) {
+      const QueueElement & qe = queue_.back();
+      if (qe.restarted) {
+        // the next packet in line must still reset the stream state
+        if (queue_.size() > 1) {
+          queue_[queue_.size() - 2].restarted = true;
+        } else {
+          restartPending_ = true;
+        }
+      }
+      pool_.release(qe.buffer);
+      queueBytes_.fetch_sub(qe.numBytes, std::memory_order_relaxed);
+      bytesDropped += qe.numBytes;
+      numDropped++;
+      queue_.pop_back();
+    }
+  }
+  increment(&counters_.msgsDropped, numDropped);
+  increment(&counters_.bytesDropped, bytesDropped);
+  // a single packet larger than the budget is let through
+  return (true);
+}
+
+bool MetavisionWrapper::skipUntilSynced(const uint8_t ** data, size_t * size)
+{
+  // scanning the raw words is much cheaper than decoding the events
+  const size_t offset = evt3::findNonZeroTime(*data, *size);
+  increment(&counters_.bytesRecv, std::min(offset, *size));
+  if (offset >= (*size & ~size_t(1))) {
+    increment(&counters_.msgsRecv, 1);
+    return (false);  // no clock yet, drop the whole packet
+  }
+  // finally the primary is up, forward from the first good time word on
+  LOG_INFO_NAMED("secondary sees primary up!");
+  waitingForSync_ = false;
+  *data += offset;
+  *size -= offset;
+  return (true);
+}
+
 void MetavisionWrapper::cdCallback(
   const Metavision::EventCD * start, const Metavision::EventCD * end)
 {
@@ -568,18 +1260,119 @@ void MetavisionWrapper::processingThread()
       }
     }
     if (qe.numBytes != 0) {
-      const uint8_t * data = static_cast<const uint8_t *>(qe.start);
-      callbackHandler_->rawDataCallback(qe.timeStamp, data, data + qe.numBytes);
-      free(const_cast<void *>(qe.start));
-      {
-        std::unique_lock<std::mutex> lock(statsMutex_);
-        stats_.maxQueueSize = std::max(stats_.maxQueueSize, qs);
+      processQueueElement(qe, qs);
+    }
+  }
+  LOG_INFO_NAMED("processing thread exited!");
+}
+
+void MetavisionWrapper::processingThreadRing()
+{
+  // spin for a short while before parking on the condition variable
+  // to avoid the cost of a context switch when packets arrive quickly.
+  const int maxSpin = 1000;
+  const std::chrono::microseconds timeout(1000);
+  while (GENERIC_ROS_OK() && keepRunning_) {
+    QueueElement qe;
+    bool havePacket = ring_->pop(&qe);
+    for (int i = 0; !havePacket && i < maxSpin; i++) {
+      std::this_thread::yield();
+      havePacket = ring_->pop(&qe);
+    }
+    if (!havePacket) {
+      consumerParked_.store(true);
+      if (ring_->empty()) {
+        // the producer notifies without holding the lock, so a wakeup
+        // can be missed. The timeout bounds the resulting delay.
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, timeout);
       }
+      consumerParked_.store(false);
+      continue;
     }
+    processQueueElement(qe, ring_->size() + 1);
   }
   LOG_INFO_NAMED("processing thread exited!");
 }
 
+void MetavisionWrapper::processingThreadDirect()
+{
+  const std::chrono::microseconds timeout((int64_t)(1000000LL));
+  while (GENERIC_ROS_OK() && keepRunning_) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (GENERIC_ROS_OK() && keepRunning_ && !messageReady_) {
+        cv_.wait_for(lock, timeout);
+      }
+      messageReady_ = false;
+    }
+    callbackHandler_->publishReadyBuffers();
+  }
+  LOG_INFO_NAMED("processing thread exited!");
+}
+
+bool MetavisionWrapper::processPending()
+{
+  // same as one round of the processing thread loops, but never blocks
+  if (!useMultithreading_) {
+    return (false);
+  }
+  if (useDirectAggregation_) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!messageReady_) {
+        return (false);
+      }
+      messageReady_ = false;
+    }
+    callbackHandler_->publishReadyBuffers();
+    return (true);
+  }
+  const int maxBatch = 16;  // then give the other cameras a turn
+  int n = 0;
+  QueueElement qe;
+  if (ring_) {
+    for (; n < maxBatch && ring_->pop(&qe); n++) {
+      processQueueElement(qe, ring_->size() + 1);
+    }
+  } else {
+    for (; n < maxBatch; n++) {
+      size_t qs;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+          break;
+        }
+        qs = queue_.size();
+        qe = queue_.back();
+        queue_.pop_back();
+      }
+      processQueueElement(qe, qs);
+    }
+  }
+  return (n != 0);
+}
+
+void MetavisionWrapper::processQueueElement(const QueueElement & qe, size_t queueSize)
+{
+  if (latencyStatistics_) {
+    recordLatency(QUEUE_LATENCY, getTimeNs() - qe.timeStamp);
+  }
+  if (qe.restarted) {
+    resetStreamState();
+  }
+  uint8_t * data = qe.buffer.data;
+  // filtering here, in place, keeps the cost off the SDK thread
+  const size_t n = filter_ ? filter_->filter(data, qe.numBytes, data) : qe.numBytes;
+  monitorActivity(data, n);
+  callbackHandler_->rawDataCallback(qe.timeStamp, data, data + n);
+  pool_.release(qe.buffer);
+  if (queueByteBudget_ != 0) {
+    queueBytes_.fetch_sub(qe.numBytes, std::memory_order_relaxed);
+  }
+  updateMax(&counters_.maxQueueSize, queueSize);
+}
+
 void MetavisionWrapper::setExternalTriggerOutMode(
   const std::string & mode, const int period, const double duty_cycle)
 {
@@ -592,51 +1385,176 @@ void MetavisionWrapper::statsThread()
 {
   while (GENERIC_ROS_OK() && keepRunning_) {
     std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(statsInterval_ * 1000)));
-    printStatistics();
+    statisticsStep();
   }
   LOG_INFO_NAMED("statistics thread exited!");
 }
 
-void MetavisionWrapper::printStatistics()
+void MetavisionWrapper::statisticsStep()
 {
-  Stats stats;
-  {
-    std::unique_lock<std::mutex> lock(statsMutex_);
-    stats = stats_;
-    stats_ = Stats();  // reset statistics
+  Statistics stats = computeStatistics();
+  if (overloadPolicy_ == "erc") {
+    updateErcThrottle(&stats);
+  }
+  if (logStatistics_) {
+    printStatistics(stats);
   }
+  callbackHandler_->statisticsCallback(stats);
+}
+
+MetavisionWrapper::Stats MetavisionWrapper::getCounterIncrements()
+{
+  // returns the counter increments since the last call
+  const auto load = [](const std::atomic<size_t> & c) {
+    return (c.load(std::memory_order_relaxed));
+  };
+  Stats now;
+  now.msgsSent = load(counters_.msgsSent);
+  now.msgsRecv = load(counters_.msgsRecv);
+  now.bytesSent = load(counters_.bytesSent);
+  now.bytesRecv = load(counters_.bytesRecv);
+  now.msgsDropped = load(counters_.msgsDropped);
+  now.bytesDropped = load(counters_.bytesDropped);
+  now.overloads = load(counters_.overloads);
+  Stats delta;
+  delta.msgsSent = now.msgsSent - lastStats_.msgsSent;
+  delta.msgsRecv = now.msgsRecv - lastStats_.msgsRecv;
+  delta.bytesSent = now.bytesSent - lastStats_.bytesSent;
+  delta.bytesRecv = now.bytesRecv - lastStats_.bytesRecv;
+  delta.msgsDropped = now.msgsDropped - lastStats_.msgsDropped;
+  delta.bytesDropped = now.bytesDropped - lastStats_.bytesDropped;
+  delta.overloads = now.overloads - lastStats_.overloads;
+  lastStats_ = now;
+  // gauges are not differenced
+  delta.maxQueueSize = counters_.maxQueueSize.exchange(0, std::memory_order_relaxed);
+  delta.msgPoolInUse = load(counters_.msgPoolInUse);
+  delta.msgPoolFree = load(counters_.msgPoolFree);
+  return (delta);
+}
+
+Statistics MetavisionWrapper::computeStatistics()
+{
+  const Stats inc = getCounterIncrements();
   std::chrono::time_point<std::chrono::system_clock> t_now = std::chrono::system_clock::now();
   const double dt = std::chrono::duration<double>(t_now - lastPrintTime_).count();
   lastPrintTime_ = t_now;
   const double invT = dt > 0 ? 1.0 / dt : 0;
-  const double recvByteRate = 1e-6 * stats.bytesRecv * invT;
+  Statistics stats;
+  stats.interval = dt;
+  stats.bytesRecvRate = inc.bytesRecv * invT;
+  stats.bytesSentRate = inc.bytesSent * invT;
+  stats.msgsRecvRate = inc.msgsRecv * invT;
+  stats.msgsSentRate = inc.msgsSent * invT;
+  stats.hasQueue = useMultithreading_ && !useDirectAggregation_;
+  stats.maxQueueSize = inc.maxQueueSize;
+  stats.msgsDropped = inc.msgsDropped;
+  stats.bytesDropped = inc.bytesDropped;
+  stats.overloads = inc.overloads;
+  pool_.getAndResetStatistics(&stats.poolExhausted, &stats.poolHighWater);
+  stats.msgPoolInUse = inc.msgPoolInUse;
+  stats.msgPoolFree = inc.msgPoolFree;
+  updatePageFaults(&stats);
+  if (recorder_) {
+    RawRecorder::Statistics rs;
+    recorder_->getAndResetStatistics(&rs);
+    stats.hasRecorder = true;
+    stats.recordedBytesRate = rs.bytesWritten * invT;
+    stats.recordingDropped = rs.bytesDropped;
+    stats.recordingMaxPending = rs.maxPending;
+    stats.recordingMaxWriteTime = rs.maxWriteTime;
+    stats.recordingErrors = rs.writeErrors;
+  }
+  {
+    std::unique_lock<std::mutex> lock(configMutex_);
+    stats.ercMode = ercMode_;
+    stats.ercRate = ercThrottledRate_ != 0 ? ercThrottledRate_ : ercRate_;
+    stats.ercThrottled = ercThrottledRate_ != 0;
+  }
+  stats.hasLatency = latencyStatistics_;
+  if (latencyStatistics_) {
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++) {
+      stats.latency[i] = latency_[i].getAndReset();
+    }
+  }
+  return (stats);
+}
 
-  const int recvMsgRate = static_cast<int>(stats.msgsRecv * invT);
-  const int sendMsgRate = static_cast<int>(stats.msgsSent * invT);
+void MetavisionWrapper::updatePageFaults(Statistics * stats)
+{
+  // called by the statistics thread only
+  const PageFaults pf = getProcessPageFaults();
+  stats->pageFaultsMinor = pf.minor - lastFaults_.minor;
+  stats->pageFaultsMajor = pf.major - lastFaults_.major;
+  lastFaults_ = pf;
+  const pid_t tid = sdkThreadId_.load(std::memory_order_relaxed);
+  PageFaults sdk;
+  if (tid != 0 && getThreadPageFaults(tid, &sdk)) {
+    if (tid != lastSdkThreadId_) {
+      lastSdkFaults_ = PageFaults();  // new SDK thread, count all of its faults
+      lastSdkThreadId_ = tid;
+    }
+    stats->sdkPageFaults = (sdk.minor - lastSdkFaults_.minor) + (sdk.major - lastSdkFaults_.major);
+    lastSdkFaults_ = sdk;
+  }
+}
 
-#ifndef USING_ROS_1
-  if (useMultithreading_) {
-    LOG_INFO_NAMED_FMT(
-      "bw in: %9.5f MB/s, msgs/s in: %7d, "
-      "out: %7d, maxq: %4zu",
-      recvByteRate, recvMsgRate, sendMsgRate, stats.maxQueueSize);
-  } else {
-    LOG_INFO_NAMED_FMT(
-      "bw in: %9.5f MB/s, msgs/s in: %7d, "
-      "out: %7d",
-      recvByteRate, recvMsgRate, sendMsgRate);
+void MetavisionWrapper::printStatistics(const Statistics & stats)
+{
+  std::string line;
+  append_fmt(
+    &line, "bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d", 1e-6 * stats.bytesRecvRate,
+    static_cast<int>(stats.msgsRecvRate), static_cast<int>(stats.msgsSentRate));
+  if (stats.hasQueue) {
+    append_fmt(
+      &line, ", maxq: %4zu, pool hwm: %4zu, pool exh: %4zu, drop: %4zu", stats.maxQueueSize,
+      stats.poolHighWater, stats.poolExhausted, stats.msgsDropped);
   }
-#else
-  if (useMultithreading_) {
-    LOG_INFO_NAMED_FMT(
-      "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d, maxq: %4zu", loggerName_.c_str(),
-      recvByteRate, recvMsgRate, sendMsgRate, stats.maxQueueSize);
-  } else {
-    LOG_INFO_NAMED_FMT(
-      "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d", loggerName_.c_str(), recvByteRate,
-      recvMsgRate, sendMsgRate);
+  if (stats.overloads != 0) {
+    append_fmt(&line, ", overload: %zu", stats.overloads);
+  }
+  if (stats.ercThrottled) {
+    append_fmt(&line, ", erc: %d ev/s", stats.ercRate);
+  }
+  if (stats.msgPoolInUse + stats.msgPoolFree != 0) {
+    append_fmt(&line, ", msg pool: %3zu/%3zu", stats.msgPoolInUse, stats.msgPoolFree);
+  }
+  if (stats.pageFaultsMajor != 0 || stats.sdkPageFaults != 0) {
+    append_fmt(
+      &line, ", faults: %zu/%zu (sdk: %zu)", stats.pageFaultsMinor, stats.pageFaultsMajor,
+      stats.sdkPageFaults);
   }
+  if (stats.hasRecorder) {
+    append_fmt(
+      &line, ", rec: %9.5f MB/s, drop: %zu B, pend: %zu, wmax: %.1f ms",
+      1e-6 * stats.recordedBytesRate, stats.recordingDropped, stats.recordingMaxPending,
+      stats.recordingMaxWriteTime * 1e-6);
+    if (stats.recordingErrors != 0) {
+      append_fmt(&line, ", write errors: %zu", stats.recordingErrors);
+    }
+  }
+#ifndef USING_ROS_1
+  LOG_INFO_NAMED_FMT("%s", line.c_str());
+#else
+  LOG_INFO_NAMED_FMT("%s: %s", loggerName_.c_str(), line.c_str());
+#endif
+  if (stats.hasLatency) {
+    const char * names[NUM_LATENCY_STAGES] = {"queue", "msg", "pub", "total"};
+    line = "latency [us] p50/p99/p99.9/max";
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++) {
+      if (i == QUEUE_LATENCY && !stats.hasQueue) {
+        continue;
+      }
+      const auto & l = stats.latency[i];
+      append_fmt(
+        &line, " %s: %.0f/%.0f/%.0f/%.0f", names[i], l.p50 * 1e-3, l.p99 * 1e-3, l.p999 * 1e-3,
+        l.max * 1e-3);
+    }
+#ifndef USING_ROS_1
+    LOG_INFO_NAMED_FMT("%s", line.c_str());
+#else
+    LOG_INFO_NAMED_FMT("%s: %s", loggerName_.c_str(), line.c_str());
 #endif
+  }
 }
 
 }  // namespace metavision_driver
@@ -0,0 +1,230 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/packet_codec.h"
+
+#ifdef USING_LZ4
+#include <lz4.h>
+#endif
+#ifdef USING_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+static void putSize(uint8_t * p, uint64_t n)
+{
+  for (size_t i = 0; i < PacketCodec::HEADER_SIZE; i++) {
+    p[i] = static_cast<uint8_t>(n >> (8 * i));
+  }
+}
+
+static uint64_t getSize(const uint8_t * p)
+{
+  uint64_t n = 0;
+  for (size_t i = 0; i < PacketCodec::HEADER_SIZE; i++) {
+    n |= static_cast<uint64_t>(p[i]) << (8 * i);
+  }
+  return (n);
+}
+
+bool PacketCodec::parse(const std::string & spec, Type * type, int * level, std::string * error)
+{
+  const size_t colon = spec.find(':');
+  const std::string name = spec.substr(0, colon);
+  *level = colon == std::string::npos ? 0 : std::atoi(spec.c_str() + colon + 1);
+  if (name == "evt3") {
+    *type = NONE;
+  } else if (name == "evt3_lz4") {
+    *type = LZ4;
+  } else if (name == "evt3_zstd") {
+    *type = ZSTD;
+  } else {
+    *error = "invalid encoding: " + spec;
+    return (false);
+  }
+  if (!isAvailable(*type)) {
+    *error = "encoding " + name + " is not supported by this build";
+    return (false);
+  }
+  return (true);
+}
+
+PacketCodec::Type PacketCodec::fromEncoding(const std::string & encoding)
+{
+  if (encoding == "evt3_lz4") {
+    return (LZ4);
+  }
+  if (encoding == "evt3_zstd") {
+    return (ZSTD);
+  }
+  return (NONE);
+}
+
+const char * PacketCodec::getEncoding(Type type)
+{
+  switch (type) {
+    case LZ4:
+      return ("evt3_lz4");
+    case ZSTD:
+      return ("evt3_zstd");
+    default:
+      break;
+  }
+  return ("evt3");
+}
+
+bool PacketCodec::isAvailable(Type type)
+{
+  switch (type) {
+    case NONE:
+      return (true);
+    case LZ4:
+#ifdef USING_LZ4
+      return (true);
+#else
+      return (false);
+#endif
+    case ZSTD:
+#ifdef USING_ZSTD
+      return (true);
+#else
+      return (false);
+#endif
+  }
+  return (false);
+}
+
+PacketCodec::PacketCodec(Type type, int level) : type_(type), level_(level)
+{
+#ifdef USING_ZSTD
+  if (type_ == ZSTD) {
+    compressContext_ = ZSTD_createCCtx();
+    decompressContext_ = ZSTD_createDCtx();
+  }
+#endif
+}
+
+PacketCodec::~PacketCodec()
+{
+#ifdef USING_ZSTD
+  ZSTD_freeCCtx(static_cast<ZSTD_CCtx *>(compressContext_));
+  ZSTD_freeDCtx(static_cast<ZSTD_DCtx *>(decompressContext_));
+#endif
+}
+
+bool PacketCodec::compress(const uint8_t * in, size_t n, std::vector<uint8_t> * out)
+{
+  switch (type_) {
+#ifdef USING_LZ4
+    case LZ4: {
+      if (n > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+        return (false);
+      }
+      const int bound = LZ4_compressBound(static_cast<int>(n));
+      resize_hack(*out, HEADER_SIZE + bound);
+      const int len = LZ4_compress_fast(
+        reinterpret_cast<const char *>(in), reinterpret_cast<char *>(out->data() + HEADER_SIZE),
+        static_cast<int>(n), bound, std::max(level_, 1));
+      if (len <= 0) {
+        return (false);
+      }
+      out->resize(HEADER_SIZE + len);
+      break;
+    }
+#endif
+#ifdef USING_ZSTD
+    case ZSTD: {
+      const size_t bound = ZSTD_compressBound(n);
+      resize_hack(*out, HEADER_SIZE + bound);
+      const size_t len = ZSTD_compressCCtx(
+        static_cast<ZSTD_CCtx *>(compressContext_), out->data() + HEADER_SIZE, bound, in, n,
+        level_ != 0 ? level_ : 1);
+      if (ZSTD_isError(len)) {
+        return (false);
+      }
+      out->resize(HEADER_SIZE + len);
+      break;
+    }
+#endif
+    default:
+      (void)in;  // unused in builds without LZ4 and zstd
+      return (false);
+  }
+  putSize(out->data(), n);
+  return (true);
+}
+
+bool PacketCodec::decompress(const uint8_t * in, size_t n, std::vector<uint8_t> * out)
+{
+  if (n < HEADER_SIZE) {
+    return (false);
+  }
+  const uint64_t size = getSize(in);
+  if (size > (uint64_t(1) << 30)) {
+    return (false);  // corrupt header, do not try to allocate that much
+  }
+  switch (type_) {
+#ifdef USING_LZ4
+    case LZ4: {
+      if (size > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        return (false);
+      }
+      resize_hack(*out, size);
+      const int len = LZ4_decompress_safe(
+        reinterpret_cast<const char *>(in + HEADER_SIZE), reinterpret_cast<char *>(out->data()),
+        static_cast<int>(n - HEADER_SIZE), static_cast<int>(size));
+      return (len >= 0 && static_cast<uint64_t>(len) == size);
+    }
+#endif
+#ifdef USING_ZSTD
+    case ZSTD: {
+      resize_hack(*out, size);
+      const size_t len = ZSTD_decompressDCtx(
+        static_cast<ZSTD_DCtx *>(decompressContext_), out->data(), size, in + HEADER_SIZE,
+        n - HEADER_SIZE);
+      return (!ZSTD_isError(len) && len == size);
+    }
+#endif
+    default:
+      (void)out;  // unused in builds without LZ4 and zstd
+      break;
+  }
+  return (false);
+}
+
+bool decompressPayload(
+  const std::string & encoding, const uint8_t * in, size_t n, std::vector<uint8_t> * out)
+{
+  // one codec per thread and type, so consumers can call this from anywhere
+  thread_local PacketCodec lz4(PacketCodec::LZ4);
+  thread_local PacketCodec zstd(PacketCodec::ZSTD);
+  switch (PacketCodec::fromEncoding(encoding)) {
+    case PacketCodec::LZ4:
+      return (lz4.decompress(in, n, out));
+    case PacketCodec::ZSTD:
+      return (zstd.decompress(in, n, out));
+    default:
+      break;
+  }
+  return (false);
+}
+}  // namespace metavision_driver
@@ -0,0 +1,334 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/packet_stream_analyzer.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "metavision_driver/packet_codec.h"
+
+namespace metavision_driver
+{
+// sensor time covered by one TIME_HIGH increment (usec)
+static constexpr uint64_t TIME_HIGH_PERIOD = 1 << 12;
+// a time_base further off the scanned sensor time (usec) is inconsistent
+static constexpr int64_t MAX_TIME_BASE_ERROR = TIME_HIGH_PERIOD;
+
+static double toMs(uint64_t t) { return (t * 1e-6); }
+
+PacketStreamAnalyzer::PacketStreamAnalyzer(const Config & config) : config_(config) {}
+
+void PacketStreamAnalyzer::process(const Message & msg)
+{
+  if (!hasMessage_) {
+    firstRecordTime_ = msg.recordTime;
+    intervalStart_ = msg.recordTime;
+  }
+  const uint64_t intervalLength = static_cast<uint64_t>(config_.interval * 1e9);
+  if (intervalLength != 0 && msg.recordTime >= intervalStart_ + intervalLength) {
+    printInterval(config_.interval);
+    // skip over intervals without any messages
+    intervalStart_ += ((msg.recordTime - intervalStart_) / intervalLength) * intervalLength;
+  }
+  checkHeader(msg);
+  numMessages_++;
+  numBytes_ += msg.size;
+  interval_.numMessages++;
+  interval_.numBytes += msg.size;
+  const uint8_t * payload = getPayload(msg);
+  if (payload) {
+    scanPayload(payload, payload == msg.data ? msg.size : decompressed_.size(), msg);
+  }
+}
+
+const uint8_t * PacketStreamAnalyzer::getPayload(const Message & msg)
+{
+  if (!msg.encoding || PacketCodec::fromEncoding(*msg.encoding) == PacketCodec::NONE) {
+    return (msg.data);
+  }
+  if (!decompressPayload(*msg.encoding, msg.data, msg.size, &decompressed_)) {
+    if (numDecompressFailed_++ == 0) {
+      printf("%10.3f: cannot decompress %s payload!\n", now(), msg.encoding->c_str());
+    }
+    // the time words of this message are lost
+    restartSensorTime();
+    return (nullptr);
+  }
+  return (decompressed_.data());
+}
+
+void PacketStreamAnalyzer::checkHeader(const Message & msg)
+{
+  lastRecordTime_ = msg.recordTime;
+  if (hasMessage_) {
+    if (msg.seq > lastSeq_ + 1) {
+      const uint64_t n = msg.seq - lastSeq_ - 1;
+      numSeqJumps_++;
+      numSeqMissing_ += n;
+      interval_.numMissing += n;
+      messagesMissing_ = true;
+      if (config_.verbose) {
+        printf(
+          "%10.3f: seq jumps from %" PRIu64 " to %" PRIu64 ", %" PRIu64 " messages missing\n",
+          now(), lastSeq_, msg.seq, n);
+      }
+    } else if (msg.seq <= lastSeq_) {
+      // driver restart (starts from seq 0) or messages out of order
+      numSeqBackward_++;
+      if (config_.verbose) {
+        printf(
+          "%10.3f: seq goes back from %" PRIu64 " to %" PRIu64 "\n", now(), lastSeq_, msg.seq);
+      }
+      restartSensorTime();
+    }
+    if (msg.stamp < lastStamp_) {
+      numStampBackward_++;
+      if (config_.verbose) {
+        printf("%10.3f: header stamp goes back by %.3fms\n", now(), toMs(lastStamp_ - msg.stamp));
+      }
+    } else {
+      const uint64_t gap = msg.stamp - lastStamp_;
+      stampGaps_.record(gap);
+      interval_.maxGap = std::max(interval_.maxGap, gap);
+      if (gap > static_cast<uint64_t>(config_.maxGap * 1e9)) {
+        numLargeGaps_++;
+        if (config_.verbose) {
+          printf("%10.3f: %.3fms gap between header stamps\n", now(), toMs(gap));
+        }
+      }
+    }
+  }
+  if (msg.recordTime >= msg.stamp) {
+    recordDelay_.record(msg.recordTime - msg.stamp);
+  } else {
+    numFutureStamps_++;  // can happen, the stamp is taken on another clock or thread
+  }
+  hasMessage_ = true;
+  lastStamp_ = msg.stamp;
+  lastSeq_ = msg.seq;
+}
+
+void PacketStreamAnalyzer::scanPayload(const uint8_t * data, size_t numBytes, const Message & msg)
+{
+  numPayloadBytes_ += numBytes;
+  // the driver's time_base is the sensor time before the message
+  const bool connected = scanner_.hasValidTime() && !messagesMissing_;
+  const uint64_t baseTime = connected ? scanner_.getTime() : 0;
+  // the first full time of the message is closest to the header stamp
+  bool hasTimeWord = false, hasFirstTime = false;
+  uint64_t firstTime = 0;
+  size_t numEvents = 0;
+  const size_t numWords = numBytes / 2;
+  for (size_t i = 0; i < numWords; i++) {
+    uint16_t w;
+    memcpy(&w, data + 2 * i, sizeof(w));  // EVT3 is little endian
+    switch (evt3::type(w)) {
+      case evt3::TIME_HIGH:
+        checkTimeHigh(evt3::payload(w));
+        messagesMissing_ = false;  // time is connected again
+        scanner_.scan(data + 2 * i, 2);
+        break;
+      case evt3::TIME_LOW:
+        scanner_.scan(data + 2 * i, 2);
+        if (!hasTimeWord) {
+          hasTimeWord = true;
+          // after missing messages, the TIME_HIGH may be stale
+          hasFirstTime = scanner_.hasValidTime() && !messagesMissing_;
+          firstTime = scanner_.getTime();
+        }
+        break;
+      case evt3::ADDR_X:
+        numEvents++;
+        break;
+      case evt3::VECT_12:
+        numEvents += __builtin_popcount(w & 0x0FFF);
+        break;
+      case evt3::VECT_8:
+        numEvents += __builtin_popcount(w & 0x00FF);
+        break;
+      case evt3::EXT_TRIGGER:
+        numTriggers_++;
+        break;
+      default:
+        break;
+    }
+  }
+  numEvents_ += numEvents;
+  interval_.numEvents += numEvents;
+  if (msg.timeBase != 0 && connected) {
+    const int64_t err = static_cast<int64_t>(msg.timeBase / 1000) - static_cast<int64_t>(baseTime);
+    if (std::abs(err) > MAX_TIME_BASE_ERROR && numTimeBaseMismatch_++ == 0) {
+      printf("%10.3f: time_base is %" PRId64 "us off the sensor time\n", now(), err);
+    }
+  }
+  if (!hasFirstTime) {
+    numWithoutTime_++;
+    return;
+  }
+  updateDrift(msg.stamp, firstTime);
+}
+
+inline void PacketStreamAnalyzer::checkTimeHigh(uint16_t th)
+{
+  if (hasTimeHigh_ && th != lastTimeHigh_) {
+    const uint16_t d = (th - lastTimeHigh_) & 0x0FFF;  // 12 bit, wraps around
+    if (d >= 2048) {
+      numTimeBackward_++;
+      if (config_.verbose) {
+        printf("%10.3f: sensor time goes back by %.3fms\n", now(), (4096 - d) * 4.096);
+      }
+    } else if (d > 1 && !messagesMissing_) {
+      const uint64_t lost = (d - 1) * TIME_HIGH_PERIOD;
+      numDrops_++;
+      droppedTime_ += lost;
+      interval_.numDrops++;
+      if (config_.verbose) {
+        printf("%10.3f: sensor time skips %.3fms, likely SDK/USB drop\n", now(), lost * 1e-3);
+      }
+    }
+  }
+  lastTimeHigh_ = th;
+  hasTimeHigh_ = true;
+}
+
+void PacketStreamAnalyzer::updateDrift(uint64_t stamp, uint64_t sensorTime)
+{
+  const int64_t offset = static_cast<int64_t>(stamp) - static_cast<int64_t>(sensorTime * 1000);
+  if (!hasDrift_) {
+    hasDrift_ = true;
+    offset0_ = offset;
+    sensor0_ = sensorTime;
+    stamp0_ = stamp;
+    numFit_ = 0;
+    meanX_ = meanY_ = covXY_ = varX_ = 0;
+  }
+  drift_ = offset - offset0_;
+  if (!hasAnyDrift_) {
+    hasAnyDrift_ = true;
+    minDrift_ = maxDrift_ = drift_;
+  }
+  minDrift_ = std::min(minDrift_, drift_);
+  maxDrift_ = std::max(maxDrift_, drift_);
+  if (!interval_.hasDrift) {
+    interval_.hasDrift = true;
+    interval_.minDrift = interval_.maxDrift = drift_;
+  }
+  interval_.minDrift = std::min(interval_.minDrift, drift_);
+  interval_.maxDrift = std::max(interval_.maxDrift, drift_);
+  // running least squares fit of stamp vs sensor time for the drift rate
+  const double x = (sensorTime - sensor0_) * 1e-6;
+  const double y = (static_cast<int64_t>(stamp - stamp0_)) * 1e-9;
+  numFit_++;
+  const double dx = x - meanX_;
+  meanX_ += dx / numFit_;
+  meanY_ += (y - meanY_) / numFit_;
+  covXY_ += dx * (y - meanY_);
+  varX_ += dx * (x - meanX_);
+}
+
+void PacketStreamAnalyzer::restartSensorTime()
+{
+  // the time words that connect to the following data are unknown
+  scanner_.reset();
+  hasTimeHigh_ = false;
+  hasDrift_ = false;
+}
+
+void PacketStreamAnalyzer::printInterval(double duration)
+{
+  const Interval & iv = interval_;
+  if (iv.numMessages != 0 && duration > 0) {
+    const double bw = iv.numBytes * 1e-6 / duration;
+    maxBandwidth_ = std::max(maxBandwidth_, bw);
+    printf(
+      "%10.3f: %6zu msgs %8.2fMB/s %7.2fMev/s max gap %7.2fms",
+      (intervalStart_ - firstRecordTime_) * 1e-9, iv.numMessages, bw,
+      iv.numEvents * 1e-6 / duration, toMs(iv.maxGap));
+    if (iv.hasDrift) {
+      printf(" drift %+9.1fus..%+9.1fus", iv.minDrift * 1e-3, iv.maxDrift * 1e-3);
+    }
+    if (iv.numDrops != 0 || iv.numMissing != 0) {
+      printf(" drops: %zu missing msgs: %zu", iv.numDrops, iv.numMissing);
+    }
+    printf("\n");
+  }
+  interval_ = Interval();
+}
+
+void PacketStreamAnalyzer::finish()
+{
+  if (numMessages_ == 0) {
+    printf("no messages found!\n");
+    return;
+  }
+  if (config_.interval > 0) {
+    printInterval(
+      std::max(std::min((lastRecordTime_ - intervalStart_) * 1e-9, config_.interval), 1e-3));
+  }
+  const double duration = (lastRecordTime_ - firstRecordTime_) * 1e-9;
+  const double dt = std::max(duration, 1e-9);
+  printf("------------ summary\n");
+  printf("messages:       %zu over %.3fs of recording time\n", numMessages_, duration);
+  printf(
+    "data:           %.1fMB (%.1fMB uncompressed), avg %.2fMB/s", numBytes_ * 1e-6,
+    numPayloadBytes_ * 1e-6, numBytes_ * 1e-6 / dt);
+  if (maxBandwidth_ > 0) {
+    printf(", peak %.2fMB/s", maxBandwidth_);
+  }
+  printf("\n");
+  printf(
+    "events:         %zu, avg %.2fMev/s, triggers: %zu\n", numEvents_, numEvents_ * 1e-6 / dt,
+    numTriggers_);
+  const auto gaps = stampGaps_.getAndReset();
+  printf(
+    "stamp gaps:     median %.3fms p99 %.3fms p99.9 %.3fms max %.3fms\n", toMs(gaps.p50),
+    toMs(gaps.p99), toMs(gaps.p999), toMs(gaps.max));
+  printf(
+    "                %zu larger than %.3fms, stamp went back %zu times\n", numLargeGaps_,
+    config_.maxGap * 1e3, numStampBackward_);
+  const auto delay = recordDelay_.getAndReset();
+  printf(
+    "record delay:   median %.3fms p99 %.3fms max %.3fms, %zu stamps later than recording\n",
+    toMs(delay.p50), toMs(delay.p99), toMs(delay.max), numFutureStamps_);
+  printf(
+    "seq:            %zu jumps, %zu messages missing, went back %zu times\n", numSeqJumps_,
+    numSeqMissing_, numSeqBackward_);
+  printf(
+    "sensor time:    %zu likely SDK/USB drops losing %.3fms, went back %zu times\n", numDrops_,
+    droppedTime_ * 1e-3, numTimeBackward_);
+  if (numWithoutTime_ != 0) {
+    printf("                %zu messages without usable sensor time\n", numWithoutTime_);
+  }
+  if (hasAnyDrift_) {
+    printf(
+      "stamp drift:    %+.1fus..%+.1fus, final %+.1fus", minDrift_ * 1e-3, maxDrift_ * 1e-3,
+      drift_ * 1e-3);
+    if (numFit_ > 1 && varX_ > 0) {
+      printf(", rate %+.2fppm", (covXY_ / varX_ - 1.0) * 1e6);
+    }
+    printf("\n");
+  }
+  if (numTimeBaseMismatch_ != 0) {
+    printf("time_base:      %zu messages inconsistent with sensor time\n", numTimeBaseMismatch_);
+  }
+  if (numDecompressFailed_ != 0) {
+    printf("decompression:  %zu messages failed\n", numDecompressFailed_);
+  }
+}
+}  // namespace metavision_driver
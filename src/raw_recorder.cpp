@@ -0,0 +1,378 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/raw_recorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "metavision_driver/evt3_scanner.h"
+
+namespace metavision_driver
+{
+static constexpr size_t ALIGNMENT = 4096;  // O_DIRECT alignment for size, offset and memory
+
+RawRecorder::~RawRecorder()
+{
+  stop();
+  for (auto b : allBuffers_) {
+    free(b);
+  }
+}
+
+void RawRecorder::setBuffers(size_t bufferSize, size_t numBuffers)
+{
+  bufferSize_ = std::max(((bufferSize + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT, ALIGNMENT);
+  numBuffers_ = std::max(numBuffers, size_t(2));
+}
+
+void RawRecorder::setRotation(size_t maxBytes, double maxSeconds)
+{
+  rotateBytes_ = maxBytes;
+  rotateSeconds_ = maxSeconds;
+}
+
+bool RawRecorder::start(
+  const std::string & directory, const std::string & prefix, const std::string & header)
+{
+  directory_ = directory;
+  prefix_ = prefix;
+  header_ = header;
+  if (header_.size() >= bufferSize_) {
+    return (false);
+  }
+  for (size_t i = 0; i < numBuffers_; i++) {
+    void * p{nullptr};
+    if (posix_memalign(&p, ALIGNMENT, bufferSize_) != 0) {
+      return (false);
+    }
+    allBuffers_.push_back(static_cast<uint8_t *>(p));
+  }
+  freeBuffers_ = allBuffers_;
+  if (!nextBuffer(true)) {
+    return (false);
+  }
+  keepRunning_ = true;
+  thread_ = std::make_shared<std::thread>(&RawRecorder::ioThread, this);
+  return (true);
+}
+
+void RawRecorder::stop()
+{
+  if (!thread_) {
+    return;
+  }
+  if (current_.data) {
+    submit(true);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+    cv_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+}
+
+void RawRecorder::getAndResetStatistics(Statistics * s)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  *s = stats_;
+  stats_ = Statistics();
+  stats_.maxPending = fullBuffers_.size();
+}
+
+// ------------------- producer side -------------------------
+
+bool RawRecorder::nextBuffer(bool newFile)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (freeBuffers_.empty()) {
+      return (false);
+    }
+    current_.data = freeBuffers_.back();
+    freeBuffers_.pop_back();
+  }
+  current_.size = 0;
+  current_.newFile = newFile;
+  current_.lastInFile = false;
+  if (newFile) {
+    memcpy(current_.data, header_.data(), header_.size());
+    current_.size = header_.size();
+    bytesInFile_ = current_.size;
+    fileStartTime_ = std::chrono::steady_clock::now();
+    producerFileNumber_++;
+    nextIndexTime_ = 0;  // index the first TIME_HIGH of the file
+  }
+  return (true);
+}
+
+void RawRecorder::submit(bool lastInFile)
+{
+  current_.lastInFile = lastInFile;
+  std::unique_lock<std::mutex> lock(mutex_);
+  fullBuffers_.push_back(current_);
+  stats_.maxPending = std::max(stats_.maxPending, fullBuffers_.size());
+  current_ = Buffer();
+  cv_.notify_all();
+}
+
+void RawRecorder::append(const uint8_t * data, size_t n)
+{
+  while (n != 0) {
+    if (!current_.data && !nextBuffer(false)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stats_.bytesDropped += n;  // I/O thread cannot keep up
+      return;
+    }
+    const size_t k = std::min(n, bufferSize_ - current_.size);
+    memcpy(current_.data + current_.size, data, k);
+    current_.size += k;
+    bytesInFile_ += k;
+    data += k;
+    n -= k;
+    if (current_.size == bufferSize_) {
+      submit(false);
+    }
+  }
+}
+
+bool RawRecorder::rotationDue() const
+{
+  if (rotateBytes_ != 0 && bytesInFile_ >= rotateBytes_) {
+    return (true);
+  }
+  if (rotateSeconds_ > 0) {
+    const double dt =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - fileStartTime_).count();
+    return (dt >= rotateSeconds_);
+  }
+  return (false);
+}
+
+void RawRecorder::appendIndexed(const uint8_t * data, size_t n, uint64_t t)
+{
+  if (indexInterval_ == 0) {
+    append(data, n);
+    return;
+  }
+  while (n != 0) {
+    const size_t k = scanner_.scanUntilTimeHigh(data, n, nextIndexTime_);
+    append(data, k);
+    if (k == n) {
+      return;
+    }
+    // bytesInFile_ is now the file offset of the TIME_HIGH word
+    const uint64_t tSensor = scanner_.getTime();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      indexEntries_.push_back({producerFileNumber_, {tSensor, t, bytesInFile_}});
+    }
+    nextIndexTime_ = tSensor + indexInterval_;
+    data += k;  // the TIME_HIGH word will be rescanned, which is harmless
+    n -= k;
+  }
+}
+
+void RawRecorder::write(const uint8_t * data, size_t n, uint64_t t)
+{
+  if (!rotatePending_ && !needNewFile_ && rotationDue()) {
+    rotatePending_ = true;
+  }
+  if (rotatePending_ || needNewFile_) {
+    // cut in front of a TIME_HIGH word so the new file is self-contained
+    const size_t k = EVT3Scanner::findTimeHigh(data, n);
+    if (needNewFile_) {
+      drop(data, k);  // previous file is closed already
+    } else {
+      appendIndexed(data, k, t);
+    }
+    if (k == n) {
+      return;
+    }
+    if (rotatePending_) {
+      if (current_.data) {
+        submit(true);
+      }
+      rotatePending_ = false;
+      needNewFile_ = true;
+    }
+    data += k;
+    n -= k;
+    if (!nextBuffer(true)) {
+      drop(data, n);  // will try again at the next TIME_HIGH
+      return;
+    }
+    needNewFile_ = false;
+  }
+  appendIndexed(data, n, t);
+}
+
+void RawRecorder::drop(const uint8_t * data, size_t n)
+{
+  if (indexInterval_ != 0) {
+    scanner_.scan(data, n);  // keep track of time
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  stats_.bytesDropped += n;
+}
+
+// ------------------- I/O thread side -------------------------
+
+void RawRecorder::ioThread()
+{
+  while (true) {
+    Buffer b;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (keepRunning_ && fullBuffers_.empty()) {
+        cv_.wait(lock);
+      }
+      if (fullBuffers_.empty()) {
+        break;  // no more data and asked to stop
+      }
+      b = fullBuffers_.front();
+      fullBuffers_.pop_front();
+    }
+    if (b.newFile) {
+      closeFile();
+      openFile();
+    }
+    writeBuffer(b);
+    writeIndexEntries();
+    if (b.lastInFile) {
+      closeFile();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    freeBuffers_.push_back(b.data);
+  }
+  closeFile();
+}
+
+bool RawRecorder::openFile()
+{
+  char num[32];
+  snprintf(num, sizeof(num), "_%04d.raw", ++fileNumber_);
+  fileName_ = directory_ + "/" + prefix_ + num;
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  fdIsDirect_ = false;
+  fd_ = -1;
+  if (useDirectIO_) {
+    fd_ = open(fileName_.c_str(), flags | O_DIRECT, 0644);
+    fdIsDirect_ = (fd_ >= 0);
+  }
+  if (fd_ < 0) {  // file system may not support O_DIRECT (e.g. tmpfs)
+    fd_ = open(fileName_.c_str(), flags, 0644);
+  }
+  if (fd_ < 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.writeErrors++;
+    return (false);
+  }
+  if (indexInterval_ != 0) {
+    indexFile_ = fopen((fileName_ + ".idx").c_str(), "wb");
+    if (!indexFile_ || !RawIndex::writeHeader(indexFile_)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stats_.writeErrors++;
+    }
+  }
+  return (true);
+}
+
+void RawRecorder::writeIndexEntries()
+{
+  // picks up the entries that belong to the file currently open.
+  // Entries for later files stay until those files are opened.
+  std::vector<RawIndexEntry> entries;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (indexEntries_.empty()) {
+      return;
+    }
+    size_t numKept = 0;
+    for (const auto & e : indexEntries_) {
+      if (e.fileNumber == fileNumber_) {
+        entries.push_back(e.entry);
+      } else {
+        indexEntries_[numKept++] = e;
+      }
+    }
+    indexEntries_.resize(numKept);
+  }
+  if (indexFile_ && !RawIndex::writeEntries(indexFile_, entries.data(), entries.size())) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.writeErrors++;
+  }
+}
+
+void RawRecorder::closeFile()
+{
+  if (indexFile_) {
+    writeIndexEntries();
+    fclose(indexFile_);
+    indexFile_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    fdatasync(fd_);
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void RawRecorder::writeBuffer(const Buffer & b)
+{
+  if (fd_ < 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.bytesDropped += b.size;
+    return;
+  }
+  if (fdIsDirect_ && (b.size % ALIGNMENT) != 0) {
+    // partial buffer at the end of a file cannot go through O_DIRECT
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+    fdIsDirect_ = false;
+  }
+  const auto t0 = std::chrono::steady_clock::now();
+  size_t numWritten = 0;
+  bool error = false;
+  while (numWritten < b.size) {
+    const ssize_t r = ::write(fd_, b.data + numWritten, b.size - numWritten);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error = true;
+      break;
+    }
+    numWritten += static_cast<size_t>(r);
+  }
+  const uint64_t dt =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0)
+      .count();
+  std::unique_lock<std::mutex> lock(mutex_);
+  stats_.bytesWritten += numWritten;
+  stats_.maxWriteTime = std::max(stats_.maxWriteTime, dt);
+  if (error) {
+    stats_.writeErrors++;
+    stats_.bytesDropped += b.size - numWritten;
+  }
+}
+}  // namespace metavision_driver
@@ -0,0 +1,77 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// Minimal consumer of the driver's shared memory ring, prints the data
+// rate once per second. Serves as example for the ShmRingReader.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "metavision_driver/shm_ring.h"
+
+int main(int argc, char ** argv)
+{
+  if (argc != 2) {
+    printf("usage: %s <shm_ring_name>  (e.g. /event_cam_0)\n", argv[0]);
+    return (-1);
+  }
+  metavision_driver::ShmRingReader reader;
+  if (!reader.open(argv[1])) {
+    printf("%s\n", reader.getError().c_str());
+    return (-1);
+  }
+  printf(
+    "opened ring %s: %ux%u %s\n", argv[1], reader.getWidth(), reader.getHeight(),
+    reader.getEncoding().c_str());
+  size_t numChunks = 0, numBytes = 0, numInvalid = 0;
+  uint64_t sensorTime = 0;
+  auto lastPrint = std::chrono::steady_clock::now();
+  while (true) {
+    metavision_driver::ShmRingReader::Chunk chunk;
+    if (!reader.next(&chunk)) {
+      if (!reader.isWriterAlive()) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    } else {
+      // a real consumer would work on chunk.data here, in place
+      const size_t n = chunk.size;
+      const uint64_t t = chunk.sensorTime;
+      if (reader.isValid(chunk)) {
+        numChunks++;
+        numBytes += n;
+        sensorTime = t;
+      } else {
+        numInvalid++;  // writer overwrote the data while we were using it
+      }
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastPrint > std::chrono::seconds(1)) {
+      const double dt = std::chrono::duration<double>(now - lastPrint).count();
+      printf(
+        "chunks/s: %8.1f, MB/s: %8.3f, sensor time: %10.6fs, overruns: %zu, invalid: %zu\n",
+        numChunks / dt, numBytes * 1e-6 / dt, sensorTime * 1e-6, reader.getNumOverruns(),
+        numInvalid);
+      numChunks = numBytes = 0;
+      lastPrint = now;
+    }
+  }
+  printf("writer has closed the ring or is gone\n");
+  return (0);
+}
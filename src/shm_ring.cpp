@@ -0,0 +1,249 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/shm_ring.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+namespace metavision_driver
+{
+// ------------------------------------ writer ------------------------------------
+
+ShmRingWriter::~ShmRingWriter() { close(); }
+
+bool ShmRingWriter::open(
+  const std::string & name, size_t capacity, uint32_t width, uint32_t height,
+  const std::string & encoding)
+{
+  close();
+  uint64_t cap = 4096;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+  // readers that still have the old segment mapped keep it until they reopen
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    error_ = "cannot create shared memory " + name + ": " + strerror(errno);
+    return (false);
+  }
+  mapSize_ = sizeof(shm::RingHeader) + cap;
+  if (ftruncate(fd, static_cast<off_t>(mapSize_)) != 0) {
+    error_ = "cannot size shared memory " + name + ": " + strerror(errno);
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return (false);
+  }
+  void * p = mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);  // mapping stays valid
+  if (p == MAP_FAILED) {
+    error_ = "cannot mmap shared memory " + name + ": " + strerror(errno);
+    shm_unlink(name.c_str());
+    return (false);
+  }
+  name_ = name;
+  header_ = new (p) shm::RingHeader();  // the segment is zero filled
+  data_ = static_cast<uint8_t *>(p) + sizeof(shm::RingHeader);
+  mask_ = cap - 1;
+  pos_ = 0;
+  sequence_ = 0;
+  scanner_.reset();
+  header_->version = shm::VERSION;
+  header_->capacity = cap;
+  header_->width = width;
+  header_->height = height;
+  strncpy(header_->encoding, encoding.c_str(), sizeof(header_->encoding) - 1);
+  header_->writerPid = static_cast<int32_t>(getpid());
+  header_->writerAlive.store(1);
+  header_->reservePos.store(0);
+  header_->writePos.store(0);
+  // readers check the magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = shm::MAGIC;
+  return (true);
+}
+
+void ShmRingWriter::close()
+{
+  if (!header_) {
+    return;
+  }
+  header_->writerAlive.store(0);
+  munmap(header_, mapSize_);
+  shm_unlink(name_.c_str());
+  header_ = nullptr;
+  data_ = nullptr;
+}
+
+void ShmRingWriter::write(uint64_t hostTime, const uint8_t * data, size_t n)
+{
+  const uint64_t total = shm::chunkSize(n);
+  if (!header_ || total > (mask_ + 1) / 4) {
+    numDropped_++;
+    return;
+  }
+  const uint64_t sensorTime = scanner_.hasValidTime() ? scanner_.getTime() : 0;
+  scanner_.scan(data, n);
+  uint64_t start = pos_;
+  const uint64_t remaining = (mask_ + 1) - (start & mask_);
+  if (remaining < total) {
+    start += remaining;  // chunks never wrap, skip to the beginning
+  }
+  // Tell the readers which region is about to be overwritten before
+  // touching it. The fence keeps the data stores behind this store.
+  header_->reservePos.store(start + total, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  if (start != pos_ && remaining >= sizeof(shm::ChunkHeader)) {
+    shm::ChunkHeader skip{sequence_, shm::PADDING, 0, 0};
+    memcpy(data_ + (pos_ & mask_), &skip, sizeof(skip));
+  }
+  shm::ChunkHeader ch{sequence_++, n, hostTime, sensorTime};
+  uint8_t * p = data_ + (start & mask_);
+  memcpy(p, &ch, sizeof(ch));
+  memcpy(p + sizeof(ch), data, n);
+  pos_ = start + total;
+  header_->writePos.store(pos_, std::memory_order_release);
+}
+
+// ------------------------------------ reader ------------------------------------
+
+ShmRingReader::~ShmRingReader() { close(); }
+
+bool ShmRingReader::open(const std::string & name)
+{
+  close();
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    error_ = "cannot open shared memory " + name + ": " + strerror(errno);
+    return (false);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(shm::RingHeader)) {
+    error_ = "shared memory not initialized yet: " + name;
+    ::close(fd);
+    return (false);
+  }
+  mapSize_ = static_cast<size_t>(st.st_size);
+  void * p = mmap(nullptr, mapSize_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    error_ = "cannot mmap shared memory " + name + ": " + strerror(errno);
+    return (false);
+  }
+  header_ = static_cast<const shm::RingHeader *>(p);
+  const bool ok = header_->magic == shm::MAGIC;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!ok || header_->version != shm::VERSION) {
+    error_ = "no valid ring (or wrong version) in shared memory " + name;
+    close();
+    return (false);
+  }
+  capacity_ = header_->capacity;
+  if (sizeof(shm::RingHeader) + capacity_ > mapSize_) {
+    error_ = "shared memory " + name + " is too small";
+    close();
+    return (false);
+  }
+  data_ = static_cast<const uint8_t *>(p) + sizeof(shm::RingHeader);
+  pos_ = header_->writePos.load(std::memory_order_acquire);
+  numOverruns_ = 0;
+  return (true);
+}
+
+void ShmRingReader::close()
+{
+  if (header_) {
+    munmap(const_cast<shm::RingHeader *>(header_), mapSize_);
+    header_ = nullptr;
+    data_ = nullptr;
+  }
+}
+
+bool ShmRingReader::next(Chunk * c)
+{
+  if (!header_) {
+    return (false);
+  }
+  const uint64_t mask = capacity_ - 1;
+  while (true) {
+    const uint64_t end = header_->writePos.load(std::memory_order_acquire);
+    if (pos_ == end) {
+      return (false);
+    }
+    if (end - pos_ > capacity_) {
+      // lapped by the writer, the data at pos_ is gone
+      numOverruns_++;
+      pos_ = end;
+      return (false);
+    }
+    const uint64_t remaining = capacity_ - (pos_ & mask);
+    if (remaining < sizeof(shm::ChunkHeader)) {
+      pos_ += remaining;
+      continue;
+    }
+    shm::ChunkHeader ch;
+    memcpy(&ch, data_ + (pos_ & mask), sizeof(ch));
+    c->pos = pos_;
+    if (!isValid(*c)) {
+      // header was overwritten while copying it
+      numOverruns_++;
+      pos_ = header_->writePos.load(std::memory_order_acquire);
+      return (false);
+    }
+    if (ch.size == shm::PADDING) {
+      pos_ += remaining;
+      continue;
+    }
+    c->data = data_ + (pos_ & mask) + sizeof(ch);
+    c->size = ch.size;
+    c->sequence = ch.sequence;
+    c->hostTime = ch.hostTime;
+    c->sensorTime = ch.sensorTime;
+    pos_ += shm::chunkSize(ch.size);
+    return (true);
+  }
+}
+
+bool ShmRingReader::isValid(const Chunk & c) const
+{
+  // pairs with the fence in the writer: if any byte that was read has
+  // already been overwritten, the reservation is visible as well
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return (header_->reservePos.load(std::memory_order_relaxed) - c.pos <= capacity_);
+}
+
+bool ShmRingReader::isWriterAlive() const
+{
+  if (!header_ || header_->writerAlive.load(std::memory_order_relaxed) == 0) {
+    return (false);
+  }
+  // a crashed writer never clears the flag, but its process is gone
+  // (EPERM means the process exists but belongs to another user)
+  return (kill(static_cast<pid_t>(header_->writerPid), 0) == 0 || errno == EPERM);
+}
+
+std::string ShmRingReader::getEncoding() const
+{
+  return (header_ ? std::string(header_->encoding, strnlen(header_->encoding, 16)) : "");
+}
+}  // namespace metavision_driver
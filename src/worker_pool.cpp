@@ -0,0 +1,177 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/worker_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "metavision_driver/metavision_wrapper.h"
+
+namespace metavision_driver
+{
+static std::chrono::steady_clock::duration toDuration(double sec)
+{
+  return (std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(sec)));
+}
+
+WorkerPool::WorkerPool(
+  size_t numWorkers, const std::vector<int> & cpus, const ThreadConfig & sched)
+{
+  for (size_t i = 0; i < std::max(numWorkers, size_t(1)); i++) {
+    workers_.push_back(std::make_unique<Worker>());
+    Worker * w = workers_.back().get();
+    w->cpu_ = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    w->thread_ = std::make_shared<std::thread>(&WorkerPool::workerThread, this, w);
+    ThreadConfig c = sched;
+    c.cpus.clear();
+    if (w->cpu_ >= 0) {
+      c.cpus.push_back(w->cpu_);
+    }
+    std::string error;
+    if (!c.isDefault() && !applyThreadConfig(w->thread_->native_handle(), c, &error)) {
+      threadConfigError_ += "worker " + std::to_string(i) + ": " + error + " ";
+    }
+  }
+  statsThread_ = std::make_shared<std::thread>(&WorkerPool::statsThread, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+  keepRunning_ = false;
+  for (auto & w : workers_) {
+    {
+      std::unique_lock<std::mutex> lock(w->waitMutex_);
+      w->cv_.notify_all();
+    }
+    w->thread_->join();
+  }
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    statsCv_.notify_all();
+  }
+  statsThread_->join();
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::getShared(
+  size_t numWorkers, const std::vector<int> & cpus, const ThreadConfig & sched)
+{
+  static std::mutex mutex;
+  static std::weak_ptr<WorkerPool> shared;
+  std::unique_lock<std::mutex> lock(mutex);
+  std::shared_ptr<WorkerPool> pool = shared.lock();
+  if (!pool) {
+    pool = std::make_shared<WorkerPool>(numWorkers, cpus, sched);
+    shared = pool;
+  }
+  return (pool);
+}
+
+WorkerPool::Worker * WorkerPool::add(MetavisionWrapper * cam)
+{
+  Worker * best = nullptr;
+  size_t bestLoad = 0;
+  for (auto & w : workers_) {
+    std::unique_lock<std::mutex> lock(w->mutex_);
+    if (!best || w->cameras_.size() < bestLoad) {
+      best = w.get();
+      bestLoad = w->cameras_.size();
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(best->mutex_);
+    best->cameras_.push_back(cam);
+  }
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    const auto now = std::chrono::steady_clock::now();
+    statsCameras_.push_back({cam, now + toDuration(cam->getStatisticsInterval())});
+    statsCv_.notify_all();
+  }
+  return (best);
+}
+
+void WorkerPool::remove(MetavisionWrapper * cam)
+{
+  for (auto & w : workers_) {
+    // the worker holds the lock while processing, so once we have
+    // it the worker is not inside this camera
+    std::unique_lock<std::mutex> lock(w->mutex_);
+    auto & c = w->cameras_;
+    c.erase(std::remove(c.begin(), c.end(), cam), c.end());
+  }
+  std::unique_lock<std::mutex> lock(statsMutex_);
+  auto & s = statsCameras_;
+  s.erase(
+    std::remove_if(s.begin(), s.end(), [cam](const StatsEntry & e) { return (e.cam == cam); }),
+    s.end());
+}
+
+void WorkerPool::workerThread(Worker * w)
+{
+  // spin for a short while before parking, like the ring consumer does
+  const int maxSpin = 1000;
+  const std::chrono::microseconds timeout(1000);
+  int numIdle = 0;
+  while (keepRunning_) {
+    if (processAll(w)) {
+      numIdle = 0;
+      continue;
+    }
+    if (++numIdle < maxSpin) {
+      std::this_thread::yield();
+      continue;
+    }
+    w->parked_.store(true);
+    // catch data that arrived before the parked flag was visible
+    if (!processAll(w)) {
+      std::unique_lock<std::mutex> lock(w->waitMutex_);
+      w->cv_.wait_for(lock, timeout, [w, this] { return (w->wakeup_ || !keepRunning_); });
+      w->wakeup_ = false;
+    }
+    w->parked_.store(false);
+    numIdle = 0;
+  }
+}
+
+bool WorkerPool::processAll(Worker * w)
+{
+  // holding the lock keeps remove() from returning while a camera is processed
+  std::unique_lock<std::mutex> lock(w->mutex_);
+  bool didWork = false;
+  for (auto cam : w->cameras_) {
+    didWork |= cam->processPending();
+  }
+  return (didWork);
+}
+
+void WorkerPool::statsThread()
+{
+  std::unique_lock<std::mutex> lock(statsMutex_);
+  while (keepRunning_) {
+    const auto now = std::chrono::steady_clock::now();
+    auto next = now + std::chrono::seconds(1);
+    for (auto & e : statsCameras_) {
+      if (now >= e.nextTime) {
+        e.cam->statisticsStep();
+        e.nextTime = now + toDuration(e.cam->getStatisticsInterval());
+      }
+      next = std::min(next, e.nextTime);
+    }
+    statsCv_.wait_until(lock, next);
+  }
+}
+}  // namespace metavision_driver
@@ -0,0 +1,275 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2026 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "metavision_driver/evt3_filter.h"
+#include "metavision_driver/evt3_scanner.h"
+
+using metavision_driver::EVT3Filter;
+namespace evt3 = metavision_driver::evt3;
+
+static std::vector<uint8_t> toBytes(const std::vector<uint16_t> & words)
+{
+  std::vector<uint8_t> b(words.size() * 2);
+  memcpy(b.data(), words.data(), b.size());  // EVT3 is little endian
+  return (b);
+}
+
+// number of CD events in the EVT3 data
+static size_t countEvents(const uint8_t * data, size_t numBytes)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < numBytes / 2; i++) {
+    uint16_t w;
+    memcpy(&w, data + 2 * i, sizeof(w));
+    switch (evt3::type(w)) {
+      case evt3::ADDR_X:
+        n++;
+        break;
+      case evt3::VECT_12:
+        n += __builtin_popcount(w & 0x0FFF);
+        break;
+      case evt3::VECT_8:
+        n += __builtin_popcount(w & 0x00FF);
+        break;
+      default:
+        break;
+    }
+  }
+  return (n);
+}
+
+// filters into a buffer of exactly the input size, so an overrun shows
+static std::vector<uint16_t> filterWords(EVT3Filter * filter, const std::vector<uint16_t> & words)
+{
+  std::vector<uint8_t> in = toBytes(words);
+  std::vector<uint8_t> out(in.size());
+  const size_t n = filter->filter(in.data(), in.size(), out.data());
+  EXPECT_LE(n, in.size());
+  std::vector<uint16_t> result(n / 2);
+  memcpy(result.data(), out.data(), 2 * result.size());
+  return (result);
+}
+
+static size_t filterAndCount(EVT3Filter * filter, const std::vector<uint16_t> & words)
+{
+  const auto out = filterWords(filter, words);
+  return (countEvents(toBytes(out).data(), 2 * out.size()));
+}
+
+using Event = std::tuple<uint32_t, uint32_t, uint32_t>;  // x, y, polarity
+
+// reference decoder for the CD events, ignores events before the first row
+static std::vector<Event> decode(const std::vector<uint16_t> & words)
+{
+  std::vector<Event> events;
+  bool hasY = false;
+  uint32_t y = 0, base = 0, p = 0;
+  for (const uint16_t w : words) {
+    switch (evt3::type(w)) {
+      case evt3::ADDR_Y:
+        y = w & 0x07FF;
+        hasY = true;
+        break;
+      case evt3::ADDR_X:
+        if (hasY) {
+          events.emplace_back(w & 0x07FF, y, (w >> 11) & 1);
+        }
+        break;
+      case evt3::VECT_BASE_X:
+        base = w & 0x07FF;
+        p = (w >> 11) & 1;
+        break;
+      case evt3::VECT_12:
+      case evt3::VECT_8: {
+        const uint32_t n = evt3::type(w) == evt3::VECT_12 ? 12 : 8;
+        for (uint32_t i = 0; i < n && hasY; i++) {
+          if (w & (1U << i)) {
+            events.emplace_back(base + i, y, p);
+          }
+        }
+        base += n;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return (events);
+}
+
+// random EVT3 stream with rows inside and outside of the test ROI
+static std::vector<uint16_t> makeStream(size_t numRows)
+{
+  std::mt19937 rng(42);
+  std::vector<uint16_t> w;
+  w.push_back(0x8000);  // TIME_HIGH
+  for (size_t r = 0; r < numRows; r++) {
+    w.push_back(static_cast<uint16_t>(rng() % 720));  // ADDR_Y
+    w.push_back(static_cast<uint16_t>(0x6000 | (rng() & 0x0FFF)));  // TIME_LOW
+    const int numGroups = 1 + static_cast<int>(rng() % 4);
+    for (int g = 0; g < numGroups; g++) {
+      const uint16_t p = static_cast<uint16_t>((rng() & 1) << 11);
+      if (rng() % 3 == 0) {
+        w.push_back(static_cast<uint16_t>(0x2000 | p | (rng() % 1280)));  // ADDR_X
+        continue;
+      }
+      w.push_back(static_cast<uint16_t>(0x3000 | p | (rng() % 1240)));  // VECT_BASE_X
+      const int numVectors = 1 + static_cast<int>(rng() % 3);
+      for (int v = 0; v < numVectors; v++) {
+        if (rng() % 2 == 0) {
+          w.push_back(static_cast<uint16_t>(0x4000 | (rng() & 0x0FFF)));  // VECT_12
+        } else {
+          w.push_back(static_cast<uint16_t>(0x5000 | (rng() & 0x00FF)));  // VECT_8
+        }
+      }
+    }
+  }
+  return (w);
+}
+
+static EVT3Filter makeROIFilter()
+{
+  EVT3Filter filter(1280, 720);
+  std::string error;
+  EXPECT_TRUE(filter.setROI({100, 50, 600, 400}, &error)) << error;
+  return (filter);
+}
+
+// events of the ROI set by makeROIFilter()
+static std::vector<Event> insideROI(const std::vector<Event> & events)
+{
+  std::vector<Event> result;
+  for (const auto & e : events) {
+    const uint32_t x = std::get<0>(e), y = std::get<1>(e);
+    if (x >= 100 && x < 700 && y >= 50 && y < 450) {
+      result.push_back(e);
+    }
+  }
+  return (result);
+}
+
+TEST(EVT3Filter, eventsBeforeFirstRowAreMasked)
+{
+  EVT3Filter filter = makeROIFilter();
+  // VECT_BASE_X (x = 200), VECT_12, VECT_8, then ADDR_Y of a masked row
+  EXPECT_EQ(filterAndCount(&filter, {0x30c8, 0x4fff, 0x50ff, 0x000a}), 0U);
+  filter.reset();
+  // TIME_LOW followed by a vector without any row
+  EXPECT_EQ(filterAndCount(&filter, {0x6001, 0x4fff}), 0U);
+  filter.reset();
+  // single event without any row
+  EXPECT_EQ(filterAndCount(&filter, {0x20c8}), 0U);
+}
+
+TEST(EVT3Filter, eventsInsideROIPass)
+{
+  EVT3Filter filter = makeROIFilter();
+  // ADDR_Y (y = 100), VECT_BASE_X (x = 200), VECT_12, ADDR_X (x = 300)
+  EXPECT_EQ(filterAndCount(&filter, {0x0064, 0x30c8, 0x4fff, 0x212c}), 13U);
+  // ADDR_Y (y = 100), events left of the ROI (x = 10) are removed
+  EXPECT_EQ(filterAndCount(&filter, {0x0064, 0x300a, 0x4fff, 0x200a}), 0U);
+}
+
+TEST(EVT3Filter, vectorsStraddlingTheROIEdges)
+{
+  EVT3Filter filter = makeROIFilter();
+  // left edge: VECT_12 at x = 80 is dropped, the one at x = 92 keeps
+  // x = 100..103 and needs a new VECT_BASE_X (x = 92)
+  EXPECT_EQ(
+    filterWords(&filter, {0x0064, 0x3050, 0x4fff, 0x4fff}),
+    std::vector<uint16_t>({0x0064, 0x305c, 0x4f00}));
+  // left edge with polarity: x = 96..107 keeps bits 4..11, the VECT_8 is all inside
+  EXPECT_EQ(
+    filterWords(&filter, {0x0064, 0x3860, 0x4fff, 0x50ff}),
+    std::vector<uint16_t>({0x0064, 0x3860, 0x4ff0, 0x50ff}));
+  // right edge: x = 694..699 survive, the VECT_8 at x = 706 is dropped,
+  // so the base (x = 714) is written for what follows
+  EXPECT_EQ(
+    filterWords(&filter, {0x0064, 0x32b6, 0x4fff, 0x50ff}),
+    std::vector<uint16_t>({0x0064, 0x32b6, 0x403f, 0x32ca}));
+}
+
+TEST(EVT3Filter, filterInPlace)
+{
+  const std::vector<uint16_t> words = makeStream(2000);
+  const std::vector<uint8_t> in = toBytes(words);
+  EVT3Filter filter = makeROIFilter();
+  std::vector<uint8_t> out(in.size());
+  const size_t n = filter.filter(in.data(), in.size(), out.data());
+  EVT3Filter inPlaceFilter = makeROIFilter();
+  std::vector<uint8_t> buf(in);
+  const size_t m = inPlaceFilter.filter(buf.data(), buf.size(), buf.data());
+  ASSERT_EQ(n, m);
+  EXPECT_EQ(0, memcmp(out.data(), buf.data(), n));
+  // and the result has exactly the events inside the ROI
+  std::vector<uint16_t> result(m / 2);
+  memcpy(result.data(), buf.data(), 2 * result.size());
+  const auto expected = insideROI(decode(words));
+  EXPECT_FALSE(expected.empty());
+  EXPECT_EQ(decode(result), expected);
+}
+
+TEST(EVT3Filter, partialRowFromPixelMask)
+{
+  const std::string fileName = "/tmp/evt3_filter_test_mask_" + std::to_string(getpid()) + ".txt";
+  FILE * f = fopen(fileName.c_str(), "w");
+  ASSERT_NE(f, nullptr);
+  fprintf(f, "# masked pixels\n5 10\n\n6, 10\n");
+  fclose(f);
+  EVT3Filter filter(1280, 720);
+  std::string error;
+  EXPECT_TRUE(filter.loadPixelMask(fileName, &error)) << error;
+  remove(fileName.c_str());
+  EXPECT_EQ(filter.getNumMaskedPixels(), 2U);
+  // row 10 is partially masked, row 11 is enabled and passes unchanged
+  EXPECT_EQ(
+    filterWords(&filter, {0x000a, 0x3000, 0x4fff, 0x2005, 0x2007, 0x000b, 0x2005}),
+    std::vector<uint16_t>({0x000a, 0x3000, 0x4f9f, 0x2007, 0x000b, 0x2005}));
+}
+
+TEST(EVT3Filter, stateCarriesAcrossCalls)
+{
+  EVT3Filter filter = makeROIFilter();
+  // row (y = 100) at the end of one packet, its events in the next
+  EXPECT_EQ(filterWords(&filter, {0x0064}), std::vector<uint16_t>({0x0064}));
+  EXPECT_EQ(filterWords(&filter, {0x3064, 0x4fff}), std::vector<uint16_t>({0x3064, 0x4fff}));
+  // vector base in one packet, the vectors in the next
+  EXPECT_EQ(filterWords(&filter, {0x0064, 0x3050}), std::vector<uint16_t>({0x3050, 0x0064}));
+  EXPECT_EQ(filterWords(&filter, {0x4fff, 0x4fff}), std::vector<uint16_t>({0x305c, 0x4f00}));
+  // the stream split into random pieces gives the same events
+  const std::vector<uint16_t> words = makeStream(500);
+  std::vector<uint16_t> result;
+  EVT3Filter pieceFilter = makeROIFilter();
+  std::mt19937 rng(7);
+  for (size_t i = 0; i < words.size();) {
+    const size_t n = std::min(words.size() - i, size_t(1 + rng() % 40));
+    const auto out = filterWords(
+      &pieceFilter, std::vector<uint16_t>(words.begin() + i, words.begin() + i + n));
+    result.insert(result.end(), out.begin(), out.end());
+    i += n;
+  }
+  EXPECT_EQ(decode(result), insideROI(decode(words)));
+}